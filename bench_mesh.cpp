@@ -0,0 +1,116 @@
+// Meshing throughput benchmark: triangulates an M24 bolt with 1..N threads
+// and reports triangles per second for each thread count. With "periodic"
+// as the second argument it instead compares the periodic mesh
+// (PeriodicTriMesh()) with meshing the whole part, at download quality.
+#include "bolt.h"
+#include "mesh.h"
+#include "parameters.h"
+#include <BRepBndLib.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
+#include <BRepTools.hxx>
+#include <Bnd_Box.hxx>
+#include <OSD_Parallel.hxx>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+double MsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Download quality as the STL export sets it: relative, 0.1% of the
+// bounding box diagonal, feature-adaptive
+int ComparePeriodic(Bolt &bolt) {
+  const TopoDS_Solid solid = bolt.Solid();
+  Bnd_Box box;
+  BRepBndLib::Add(solid, box);
+  const double diagonal = std::sqrt(box.SquareExtent());
+  const MeshQuality quality = {0.001 * diagonal, 0.25, true, true};
+
+  TopoDS_Shape whole =
+      BRepBuilderAPI_Copy(solid, Standard_False, Standard_False).Shape();
+  auto start = std::chrono::steady_clock::now();
+  MeshShape(whole, quality);
+  const double wholeMs = MsSince(start);
+  const std::size_t wholeTriangles = TriangleCount(whole);
+
+  start = std::chrono::steady_clock::now();
+  TriMesh periodic =
+      PeriodicTriMesh(solid, quality, bolt.Periodicity(), 1e-3f,
+                      static_cast<float>(2.0 * quality.deflection));
+  const double periodicMs = MsSince(start);
+
+  std::cout << std::setw(10) << "mesh" << std::setw(12) << "ms"
+            << std::setw(12) << "triangles" << std::endl;
+  std::cout << std::fixed << std::setprecision(1) << std::setw(10) << "whole"
+            << std::setw(12) << wholeMs << std::setw(12) << wholeTriangles
+            << std::endl;
+  std::cout << std::setw(10) << "periodic" << std::setw(12) << periodicMs
+            << std::setw(12) << periodic.TriangleCount() << std::endl;
+  return periodic.TriangleCount() > 0 ? 0 : 1;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  // Optional: deflection in mm (default 0.01, i.e. a fine-quality mesh)
+  double deflection = (argc > 1) ? atof(argv[1]) : 0.01;
+  const bool periodic = (argc > 2) && std::string(argv[2]) == "periodic";
+
+  BoltParameters p{};
+  p.head.type = HeadType::HEX;
+  p.head.widthAcrossFlats = 36.0;
+  p.head.height = 15.0;
+  p.shank.nominalDiameter = 24.0;
+  p.shank.totalLength = 100.0;
+  p.shank.gripLength = 40.0;
+  p.thread.majorDiameter = 24.0;
+  p.thread.pitch = 3.0;
+
+  std::cerr << "Building M24x3 bolt..." << std::endl;
+  Bolt bolt(p);
+  if (periodic) {
+    return ComparePeriodic(bolt);
+  }
+  TopoDS_Solid solid = bolt.Solid();
+
+  std::vector<int> threadCounts;
+  for (int n = 1; n < OSD_Parallel::NbLogicalProcessors(); n *= 2) {
+    threadCounts.push_back(n);
+  }
+  threadCounts.push_back(OSD_Parallel::NbLogicalProcessors());
+
+  std::cout << std::setw(8) << "threads" << std::setw(12) << "ms"
+            << std::setw(12) << "triangles" << std::setw(14) << "tri/s"
+            << std::setw(10) << "speedup" << std::endl;
+
+  double baseMs = 0.0;
+  for (int threads : threadCounts) {
+    BRepTools::Clean(solid);
+    SetMeshThreads(threads);
+
+    auto start = std::chrono::steady_clock::now();
+    MeshShape(solid, {deflection, 0.25, false});
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+
+    std::size_t triangles = TriangleCount(solid);
+    if (baseMs == 0.0) {
+      baseMs = ms;
+    }
+    std::cout << std::setw(8) << threads << std::setw(12) << std::fixed
+              << std::setprecision(1) << ms << std::setw(12) << triangles
+              << std::setw(14) << std::setprecision(0)
+              << (ms > 0 ? triangles / (ms / 1000.0) : 0.0) << std::setw(10)
+              << std::setprecision(2) << (ms > 0 ? baseMs / ms : 0.0)
+              << std::endl;
+  }
+  return 0;
+}
@@ -1,8 +1,13 @@
 #define _USE_MATH_DEFINES
 #include "bolt.h"
+#include "budget.h"
+#include "fillet.h"
+#include "manifest.h"
+#include "preflight.h"
+#include "progress.h"
+#include "simplify.h"
 #include <BRepAlgoAPI_Fuse.hxx>
-#include <BRepBuilderAPI_Transform.hxx>
-#include <BRepFilletAPI_MakeFillet.hxx>
+#include <BRepCheck_Analyzer.hxx>
 #include <BRepGProp.hxx>
 #include <BRepPrimAPI_MakeCylinder.hxx>
 #include <GProp_GProps.hxx>
@@ -10,8 +15,10 @@
 #include <TopExp_Explorer.hxx>
 #include <TopoDS.hxx>
 #include <TopoDS_Edge.hxx>
+#include <algorithm>
 #include <cmath>
 #include <gp_Ax1.hxx>
+#include <gp_Ax2.hxx>
 #include <gp_Dir.hxx>
 #include <gp_Pnt.hxx>
 #include <gp_Trsf.hxx>
@@ -23,13 +30,15 @@
 Bolt::Bolt(const BoltParameters &p) : params(p) {
   TopoDS_Solid shank = Shank();
 
-  // Rotate shank 180 degrees around X axis to point chamfered end down
+  // Rotate shank 180 degrees around X axis to point chamfered end down.
+  // Rigid placements only set the shape's location: the geometry is shared,
+  // not copied, and the booleans see the original surfaces.
   gp_Trsf rotateShank;
   rotateShank.SetRotation(
       gp_Ax1(gp_Pnt(0.0, 0.0, 0.5 * params.shank.totalLength),
              gp_Dir(1.0, 0.0, 0.0)),
       M_PI);
-  shank = TopoDS::Solid(BRepBuilderAPI_Transform(shank, rotateShank).Shape());
+  shank = TopoDS::Solid(shank.Moved(TopLoc_Location(rotateShank)));
 
   TopoDS_Solid head = Head();
 
@@ -41,10 +50,11 @@ Bolt::Bolt(const BoltParameters &p) : params(p) {
   headPlacement.SetTranslation(
       gp_Vec(0.0, 0.0, params.shank.totalLength - fuseOverlap));
   TopoDS_Solid placedHead =
-      TopoDS::Solid(BRepBuilderAPI_Transform(head, headPlacement).Shape());
+      TopoDS::Solid(head.Moved(TopLoc_Location(headPlacement)));
 
-  BRepAlgoAPI_Fuse fuseOp(shank, placedHead);
-  fuseOp.Build();
+  Handle(CancelIndicator) fuseProgress = new CancelIndicator();
+  BRepAlgoAPI_Fuse fuseOp(shank, placedHead, fuseProgress->Start());
+  ThrowIfCancelled("head fuse");
 
   std::vector<TopoDS_Solid> fusedSolids;
   for (TopExp_Explorer map(fuseOp.Shape(), TopAbs_SOLID); map.More();
@@ -69,92 +79,92 @@ Bolt::Bolt(const BoltParameters &p) : params(p) {
     }
   }
 
+  // Merge what the head and washer face fuses split before any fillet has
+  // to walk those faces
+  selected = Simplify("bolt cleanup", selected);
+
   // Apply underhead fillet if radius > 0
   if (params.head.underheadFilletRadius > 0) {
-    try {
-      BRepFilletAPI_MakeFillet filler(selected);
-      // We need to find the edge at the intersection of head and shank
-      // For a cylinder, it's roughly at z = length - fuseOverlap
-      const double targetZ = params.shank.totalLength - fuseOverlap;
-      for (TopExp_Explorer ex(selected, TopAbs_EDGE); ex.More(); ex.Next()) {
-        TopoDS_Edge edge = TopoDS::Edge(ex.Current());
-        GProp_GProps edgeProps;
-        BRepGProp::LinearProperties(edge, edgeProps);
-        gp_Pnt center = edgeProps.CentreOfMass();
-        if (std::abs(center.Z() - targetZ) < 0.2) {
-          filler.Add(params.head.underheadFilletRadius, edge);
-        }
-      }
-      if (filler.IsDone()) {
-        selected = TopoDS::Solid(filler.Shape());
-      }
-    } catch (...) {
-      // Fillet might fail if radius is too large for geometry
-    }
+    // We need to find the edge at the intersection of head and shank
+    // For a cylinder, it's roughly at z = length - fuseOverlap
+    const double targetZ = params.shank.totalLength - fuseOverlap;
+    selected = Fillet("underhead fillet", selected,
+                      params.head.underheadFilletRadius,
+                      [targetZ](const TopoDS_Edge &edge, double) {
+                        GProp_GProps edgeProps;
+                        BRepGProp::LinearProperties(edge, edgeProps);
+                        gp_Pnt center = edgeProps.CentreOfMass();
+                        return std::abs(center.Z() - targetZ) < 0.2;
+                      });
   }
 
   // Apply global edge fillet if radius > 0
   // SAFE FILLET ALGORITHM: Validate radius against geometry to prevent
   // corruption
   double filletRadius = params.shank.edgeFilletRadius;
-  if (filletRadius > 0.01) {
-    // Clamp fillet radius to safe maximum (10% of nominal diameter)
-    double maxSafeRadius = params.thread.majorDiameter * 0.1;
+  if (filletRadius > 0.01 && !BudgetAllows(kFilletBudgetShare)) {
+    // The global fillet is cosmetic; it is the first thing to go when the
+    // job is already behind schedule
+    std::cout << "Fillet: Job over budget, skipping edge fillet" << std::endl;
+    ManifestAddEntry("degradations", "fillet",
+                     "edge fillet skipped; job already over budget");
+  } else if (filletRadius > 0.01) {
+    StageBudget stage(kFilletBudgetShare);
+
+    // Clamp fillet radius to the same safe maximum the pre-flight uses
+    double maxSafeRadius = MaxEdgeFilletRadius(params);
     if (filletRadius > maxSafeRadius) {
       std::cout << "Fillet: Clamping radius from " << filletRadius
                 << " to safe max " << maxSafeRadius << std::endl;
       filletRadius = maxSafeRadius;
     }
 
-    try {
-      std::cout << "Applying safe edge fillet radius: " << filletRadius
-                << std::endl;
-      BRepFilletAPI_MakeFillet fillet(selected);
-      int edgesAdded = 0;
-
-      for (TopExp_Explorer ex(selected, TopAbs_EDGE); ex.More(); ex.Next()) {
-        TopoDS_Edge edge = TopoDS::Edge(ex.Current());
-
-        // Calculate edge length to validate if fillet is safe
-        GProp_GProps edgeProps;
-        BRepGProp::LinearProperties(edge, edgeProps);
-        double edgeLength = edgeProps.Mass(); // Length of edge
-
-        // Only apply fillet if edge is long enough (at least 4x the radius)
-        if (edgeLength > filletRadius * 4.0) {
-          fillet.Add(filletRadius, edge);
-          edgesAdded++;
-        }
-      }
-
-      std::cout << "Fillet: Added to " << edgesAdded << " edges" << std::endl;
-
-      if (edgesAdded > 0) {
-        fillet.Build();
-        if (fillet.IsDone()) {
-          selected = TopoDS::Solid(fillet.Shape());
-          std::cout << "Edge fillet applied successfully" << std::endl;
-        } else {
-          std::cerr << "Fillet: Build incomplete, keeping original geometry"
-                    << std::endl;
-        }
-      } else {
-        std::cout << "Fillet: No suitable edges found, skipping" << std::endl;
-      }
-    } catch (const std::exception &e) {
-      std::cerr << "Fillet failed (" << e.what()
-                << "), keeping original geometry" << std::endl;
-    } catch (...) {
-      std::cerr << "Fillet failed (unknown), keeping original geometry"
-                << std::endl;
-    }
+    // Only round edges that are long enough (at least 4x the radius)
+    selected =
+        Fillet("fillet", selected, filletRadius,
+               [](const TopoDS_Edge &edge, double radius) {
+                 GProp_GProps edgeProps;
+                 BRepGProp::LinearProperties(edge, edgeProps);
+                 return edgeProps.Mass() > radius * 4.0;
+               });
   }
 
   body = selected;
 }
 
+Bolt::Bolt(const BoltParameters &p, const TopoDS_Solid &body)
+    : params(p), body(body) {}
+
 TopoDS_Solid Bolt::Solid() { return body; }
 
+PeriodicLayout Bolt::Periodicity() const {
+  const double p = params.thread.pitch;
+  const double L = params.shank.totalLength;
+  const double ls = ClampedGripLength(params);
+  const double fuseOverlap = (L > 0.2) ? 0.1 : 0.5 * L;
+  const double zHead = L - fuseOverlap;
+
+  PeriodicLayout layout;
+  // One pitch clear of the tip chamfer and of the thread runout
+  layout.threadStart = (p - 0.5 * params.shank.bodyTolerance) + p;
+  layout.pitch = p;
+  const double threadEnd = std::min((ls > 0.1) ? L - ls : L, zHead) - p;
+  // A thread that is not modelled meshes in one piece
+  const bool plain = (params.thread.lod == ThreadLod::NONE ||
+                      params.thread.lod == ThreadLod::COSMETIC);
+  layout.turns = (L - ls < p || p <= 0.0 || plain)
+                     ? 0
+                     : static_cast<int>(
+                           std::floor((threadEnd - layout.threadStart) / p));
+  if (layout.turns < 2) {
+    layout.turns = 0;
+  }
+  layout.headStart = zHead + std::max(0.25 * params.head.height,
+                                      params.head.washerFaceThickness + 0.1);
+  layout.sectors = (layout.headStart < zHead + params.head.height) ? 6 : 0;
+  return layout;
+}
+
 TopoDS_Solid Bolt::Shank() {
   double d = params.thread.majorDiameter;
   double p = params.thread.pitch;
@@ -162,7 +172,7 @@ TopoDS_Solid Bolt::Shank() {
   double shankCap = d - params.shank.bodyTolerance;
 
   // Clamp grip length safely
-  double ls = std::max(0.0, std::min(params.shank.gripLength, L - 3.0 * p));
+  double ls = ClampedGripLength(params);
   double threadedLength = L - ls;
 
   std::cout << "Shank: L=" << L << " ls=" << ls
@@ -178,9 +188,15 @@ TopoDS_Solid Bolt::Shank() {
     return result;
   }
 
-  // 1. Create the unthreaded grip section (if any)
+  // 1. Create the unthreaded grip section (if any). Without a thread the
+  // shank is one blank cylinder, so there is nothing to fuse.
   TopoDS_Solid gripPart;
   bool hasGrip = (ls > 0.1);
+  if (params.thread.lod == ThreadLod::NONE) {
+    std::cout << "Shank: Thread LOD none, making plain cylinder" << std::endl;
+    hasGrip = false;
+    threadedLength = L;
+  }
 
   if (hasGrip) {
     std::cout << "Shank: Creating grip section of length " << ls << std::endl;
@@ -191,37 +207,21 @@ TopoDS_Solid Bolt::Shank() {
   std::cout << "Shank: Creating threaded section of length " << threadedLength
             << std::endl;
 
-  // Build threaded section longer than needed, then trim
-  double buildLen = threadedLength + 4.0 * p;
-  TopoDS_Solid threadedPart =
-      BRepPrimAPI_MakeCylinder(0.5 * shankCap, buildLen).Solid();
-
-  // Apply thread profile
-  double minorD = (params.thread.minorDiameter > 0)
-                      ? params.thread.minorDiameter
-                      : (d - 1.0825 * p);
-  TopoDS_Solid threadCutter = Thread(minorD, p, buildLen);
-  threadedPart = Cut(threadedPart, threadCutter);
-
-  // Trim to exact threaded length
-  gp_Trsf trimTrans;
-  trimTrans.SetTranslation(gp_Vec(0, 0, threadedLength));
-  TopoDS_Solid trimMask =
-      BRepPrimAPI_MakeCylinder(d * 2.0, buildLen + 10.0).Solid();
-  threadedPart =
-      Cut(threadedPart, BRepBuilderAPI_Transform(trimMask, trimTrans).Shape());
+  double minorD = MinorDiameter(params);
+  TopoDS_Solid threadedPart = ThreadedSection(minorD, threadedLength);
 
   // 3. Position threaded section after grip
   if (hasGrip) {
     gp_Trsf threadOffset;
     threadOffset.SetTranslation(gp_Vec(0, 0, ls));
-    threadedPart = TopoDS::Solid(
-        BRepBuilderAPI_Transform(threadedPart, threadOffset).Shape());
+    threadedPart =
+        TopoDS::Solid(threadedPart.Moved(TopLoc_Location(threadOffset)));
 
     // Fuse grip and threaded sections
     std::cout << "Shank: Fusing grip and threaded sections" << std::endl;
-    BRepAlgoAPI_Fuse fuseOp(gripPart, threadedPart);
-    fuseOp.Build();
+    Handle(CancelIndicator) progress = new CancelIndicator();
+    BRepAlgoAPI_Fuse fuseOp(gripPart, threadedPart, progress->Start());
+    ThrowIfCancelled("shank fuse");
     if (!fuseOp.IsDone()) {
       std::cerr << "Shank: Fuse failed, returning threaded part only"
                 << std::endl;
@@ -247,10 +247,118 @@ TopoDS_Solid Bolt::Shank() {
                                     gp_Pnt(cx[1], 0.0, cz[1])};
   result = Cut(result, Chamfer(chamferPts));
 
+  // The grip/thread interface and the trim and chamfer planes leave split
+  // faces behind
+  result = Simplify("shank cleanup", result);
+
   std::cout << "Shank: Generation complete" << std::endl;
   return result;
 }
 
+TopoDS_Solid Bolt::ThreadedSection(double minorD, double threadedLength) {
+  double p = params.thread.pitch;
+  double shankCap = params.thread.majorDiameter - params.shank.bodyTolerance;
+
+  // Requested levels of detail below the helix are not recorded as
+  // degradations
+  if (params.thread.lod == ThreadLod::NONE) {
+    return BRepPrimAPI_MakeCylinder(0.5 * shankCap, threadedLength).Solid();
+  }
+  if (params.thread.lod == ThreadLod::COSMETIC) {
+    return BRepPrimAPI_MakeCylinder(0.5 * PitchDiameter(params), threadedLength)
+        .Solid();
+  }
+
+  // Fallback ladder: helical thread, then revolved grooves with the same
+  // pitch, then a cosmetic plain cylinder. Every step down is recorded so a
+  // single job always returns a usable part.
+  std::string failure;
+  if (params.thread.lod == ThreadLod::FULL) {
+    // The helical sweep and cut dominate job time; stopped at its budget
+    // share, the thread degrades to revolved grooves instead of running
+    // unbounded. A helix that finished late is kept.
+    StageBudget stage(kThreadBudgetShare);
+    try {
+      TopoDS_Solid helical = HelicalThread(minorD, threadedLength);
+      if (BRepCheck_Analyzer(helical).IsValid()) {
+        return helical;
+      }
+      failure = "helical thread is not a valid solid";
+    } catch (const JobCancelled &) {
+      throw;
+    } catch (const std::exception &e) {
+      failure = e.what();
+    }
+    if (stage.Interrupted()) {
+      std::cout << "Shank: Thread over budget, using simplified thread"
+                << std::endl;
+      ManifestAddEntry("degradations", "thread",
+                       "helical thread exceeded its time budget; replaced by "
+                       "revolved grooves");
+      failure.clear();
+    }
+  }
+  if (!failure.empty()) {
+    std::cerr << "Shank: Helical thread failed (" << failure
+              << "), using revolved grooves" << std::endl;
+    ManifestAddEntry("fallbacks", "thread",
+                     "helical thread failed (" + failure +
+                         "); replaced by revolved grooves");
+  }
+
+  try {
+    TopoDS_Solid grooved = SimplifiedThread(minorD, shankCap, p, threadedLength);
+    if (BRepCheck_Analyzer(grooved).IsValid()) {
+      return grooved;
+    }
+    failure = "revolved grooves are not a valid solid";
+  } catch (const JobCancelled &) {
+    throw;
+  } catch (const std::exception &e) {
+    failure = e.what();
+  }
+
+  std::cerr << "Shank: Revolved grooves failed (" << failure
+            << "), using cosmetic thread" << std::endl;
+  ManifestAddEntry("fallbacks", "thread",
+                   "revolved grooves failed (" + failure +
+                       "); cosmetic thread (plain cylinder) used");
+  return BRepPrimAPI_MakeCylinder(0.5 * shankCap, threadedLength).Solid();
+}
+
+TopoDS_Solid Bolt::HelicalThread(double minorD, double threadedLength) {
+  double d = params.thread.majorDiameter;
+  double p = params.thread.pitch;
+  double shankCap = d - params.shank.bodyTolerance;
+
+  // Build threaded section longer than needed, then trim
+  double buildLen = threadedLength + 4.0 * p;
+  TopoDS_Solid threadedPart =
+      BRepPrimAPI_MakeCylinder(0.5 * shankCap, buildLen).Solid();
+
+  // Apply thread profile, with the root and crest radii in the swept profile
+  ThreadRounding rounding;
+  rounding.root = params.thread.rootRadius;
+  rounding.crest = params.thread.crestRadius;
+  rounding.blankDiameter = shankCap;
+  TopoDS_Solid threadCutter = Thread(minorD, p, buildLen, rounding);
+  if (!TryCut(threadedPart, threadCutter, threadedPart)) {
+    throw std::runtime_error("thread groove cut failed");
+  }
+
+  // Trim to exact threaded length; the mask is built where it cuts
+  TopoDS_Solid trimMask =
+      BRepPrimAPI_MakeCylinder(gp_Ax2(gp_Pnt(0.0, 0.0, threadedLength),
+                                      gp_Dir(0.0, 0.0, 1.0)),
+                               d * 2.0, buildLen + 10.0)
+          .Solid();
+  TopoDS_Solid trimmed;
+  if (!TryCut(threadedPart, trimMask, trimmed)) {
+    throw std::runtime_error("thread trim cut failed");
+  }
+  return trimmed;
+}
+
 TopoDS_Solid Bolt::Head() {
   TopoDS_Solid head;
   double s = params.head.widthAcrossFlats;
@@ -265,7 +373,7 @@ TopoDS_Solid Bolt::Head() {
         Hexagon(params.head.socketSize, params.head.socketDepth);
     gp_Trsf socketOffset;
     socketOffset.SetTranslation(gp_Vec(0.0, 0.0, k - params.head.socketDepth));
-    head = Cut(head, BRepBuilderAPI_Transform(socket, socketOffset).Shape());
+    head = Cut(head, socket.Moved(TopLoc_Location(socketOffset)));
   } else if (params.head.type == HeadType::FLAT ||
              params.head.type == HeadType::COUNTERSUNK) {
     head = BRepPrimAPI_MakeCylinder(0.5 * s, k).Solid();
@@ -281,8 +389,9 @@ TopoDS_Solid Bolt::Head() {
                                  params.head.washerFaceThickness)
             .Solid();
     // Washer face is usually at the bottom of the head
-    BRepAlgoAPI_Fuse washerFuse(head, washer);
-    washerFuse.Build();
+    Handle(CancelIndicator) progress = new CancelIndicator();
+    BRepAlgoAPI_Fuse washerFuse(head, washer, progress->Start());
+    ThrowIfCancelled("washer face fuse");
     head = TopoDS::Solid(washerFuse.Shape());
   }
 
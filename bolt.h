@@ -21,7 +21,7 @@
 #define BOLT_H
 
 #include <BRepAlgoAPI_Fuse.hxx>
-#include <BRepBuilderAPI_Transform.hxx>
+#include <TopLoc_Location.hxx>
 #include <BRepPrimAPI_MakeCylinder.hxx>
 #include <TopoDS_Solid.hxx>
 #include <gp_Trsf.hxx>
@@ -29,6 +29,7 @@
 #include "chamfer.h"
 #include "cut.h"
 #include "hexagon.h"
+#include "mesh.h"
 #include "thread.h"
 
 #include "parameters.h"
@@ -36,11 +37,18 @@
 class Bolt {
 public:
   Bolt(const BoltParameters &);
+  // Wraps a body built earlier from the same parameters (result cache)
+  Bolt(const BoltParameters &, const TopoDS_Solid &body);
   TopoDS_Solid Solid();
+  // Where the solid repeats: whole thread turns clear of the tip chamfer and
+  // the grip, and the head above its fillet and washer face
+  PeriodicLayout Periodicity() const;
 
 private:
   BoltParameters params;
   TopoDS_Solid Shank();
+  TopoDS_Solid ThreadedSection(double minorD, double threadedLength);
+  TopoDS_Solid HelicalThread(double minorD, double threadedLength);
   TopoDS_Solid Head();
   TopoDS_Solid body;
 };
@@ -0,0 +1,61 @@
+#include "budget.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+Clock::time_point jobStart = Clock::now();
+double budgetMs = 0.0;
+
+// Deadline of the active stage in clock ticks; zero when no stage is active.
+// Atomic because racing boolean threads poll it concurrently.
+std::atomic<Clock::rep> stageDeadline(0);
+
+// Set when an operation of the active stage was stopped at its deadline
+std::atomic<bool> stageInterrupted(false);
+} // namespace
+
+void SetJobBudget(double milliseconds) {
+  jobStart = Clock::now();
+  budgetMs = std::max(0.0, milliseconds);
+}
+
+bool BudgetEnabled() { return budgetMs > 0.0; }
+
+double BudgetMs() { return budgetMs; }
+
+double ElapsedMs() {
+  return std::chrono::duration<double, std::milli>(Clock::now() - jobStart)
+      .count();
+}
+
+bool BudgetAllows(double share) {
+  return !BudgetEnabled() || budgetMs - ElapsedMs() >= share * budgetMs;
+}
+
+bool StageDeadlinePassed() {
+  Clock::rep deadline = stageDeadline.load(std::memory_order_relaxed);
+  return deadline != 0 && Clock::now().time_since_epoch().count() > deadline;
+}
+
+void NoteStageInterrupted() { stageInterrupted.store(true); }
+
+StageBudget::StageBudget(double share) {
+  stageInterrupted.store(false);
+  if (!BudgetEnabled()) {
+    return;
+  }
+  double remaining = std::max(0.0, budgetMs - ElapsedMs());
+  double stageMs = std::min(share * budgetMs, remaining);
+  Clock::time_point deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double, std::milli>(stageMs));
+  stageDeadline.store(deadline.time_since_epoch().count());
+}
+
+StageBudget::~StageBudget() { stageDeadline.store(0); }
+
+bool StageBudget::Interrupted() const { return stageInterrupted.load(); }
@@ -0,0 +1,44 @@
+/*
+    BoltGenerator - Per-job latency budget
+    Copyright (C) 2025
+*/
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+// Share of the total job budget each expensive stage may consume before the
+// pipeline degrades it (simplified thread, skipped fillet, coarser mesh).
+constexpr double kThreadBudgetShare = 0.45;
+constexpr double kFilletBudgetShare = 0.20;
+constexpr double kMeshBudgetShare = 0.25;
+
+// Starts the job clock. A budget of zero or less disables all degradation.
+void SetJobBudget(double milliseconds);
+bool BudgetEnabled();
+double BudgetMs();
+double ElapsedMs();
+
+// True when enough of the budget remains to give a stage its full share.
+bool BudgetAllows(double share);
+
+// True once the active stage (if any) has run past its deadline. Polled by
+// CancelIndicator so that long OCCT calls give up at the deadline; it calls
+// NoteStageInterrupted() when it stops one for that reason.
+bool StageDeadlinePassed();
+void NoteStageInterrupted();
+
+// Scoped deadline for one stage: now + share of the budget, never later than
+// the job deadline. Stages do not nest. Interrupted() is true once an
+// operation of the stage was stopped at the deadline; one that finished late
+// does not count, so its result can be kept.
+class StageBudget {
+public:
+  explicit StageBudget(double share);
+  ~StageBudget();
+  bool Interrupted() const;
+
+  StageBudget(const StageBudget &) = delete;
+  StageBudget &operator=(const StageBudget &) = delete;
+};
+
+#endif // BUDGET_H
@@ -0,0 +1,133 @@
+#include "cache.h"
+#include "export.h"
+#include "manifest.h"
+#include "progress.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include <TopoDS.hxx>
+
+namespace {
+// Part of every key: bump it whenever the construction of a part changes,
+// so solids built by older code are not served
+constexpr int kConstructionVersion = 3;
+
+std::string cacheDirectory;
+
+std::string CachePath(const BoltParameters &p, const char *part) {
+  return cacheDirectory + "/" + ResultCacheKey(p, part) + ".bbrep";
+}
+} // namespace
+
+void SetResultCacheDir(const std::string &directory) {
+  cacheDirectory = directory;
+}
+
+bool ResultCacheEnabled() { return !cacheDirectory.empty(); }
+
+std::string ResultCacheKey(const BoltParameters &p, const char *part) {
+  // Every field the part is built from, at full precision
+  std::ostringstream fields;
+  fields << std::setprecision(17) << kConstructionVersion << ' ' << part;
+  auto add = [&](double value) { fields << ' ' << value; };
+  add(p.thread.majorDiameter);
+  add(p.thread.pitch);
+  add(p.thread.angle);
+  add(p.thread.minorDiameter);
+  add(p.thread.pitchDiameter);
+  add(p.thread.rootRadius);
+  add(p.thread.crestRadius);
+  add(p.thread.runout);
+  add(static_cast<int>(p.thread.lod));
+  if (std::string(part) == "nut") {
+    add(p.nut.widthAcrossFlats);
+    add(p.nut.height);
+    add(p.nut.washerFaceDiameter);
+    add(p.nut.countersinkAngle);
+    add(p.nut.chamferAngle);
+    add(p.nut.tolerance);
+    add(p.nut.threadClearance);
+    add(p.nut.edgeFilletRadius);
+  } else {
+    add(static_cast<int>(p.head.type));
+    add(p.head.widthAcrossFlats);
+    add(p.head.widthAcrossCorners);
+    add(p.head.height);
+    add(p.head.washerFaceDiameter);
+    add(p.head.washerFaceThickness);
+    add(p.head.underheadFilletRadius);
+    add(p.head.topFilletRadius);
+    add(p.head.verticalChamfer);
+    add(p.head.socketSize);
+    add(p.head.socketDepth);
+    add(p.shank.nominalDiameter);
+    add(p.shank.totalLength);
+    add(p.shank.gripLength);
+    add(p.shank.bodyTolerance);
+    add(p.shank.edgeFilletRadius);
+    add(p.shank.transitionFilletRadius);
+  }
+
+  // 64-bit FNV-1a
+  std::uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : fields.str()) {
+    hash = (hash ^ c) * 1099511628211ull;
+  }
+  std::ostringstream hex;
+  hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return hex.str();
+}
+
+bool ResultCacheLoad(const BoltParameters &p, const char *part,
+                     TopoDS_Solid &solid) {
+  if (!ResultCacheEnabled()) {
+    return false;
+  }
+  const std::string path = CachePath(p, part);
+  if (access(path.c_str(), R_OK) != 0) {
+    return false;
+  }
+  TopoDS_Shape shape;
+  if (!ImportBinBRep(path.c_str(), shape) ||
+      shape.ShapeType() != TopAbs_SOLID) {
+    std::cerr << "Cache: Ignoring unreadable " << path << std::endl;
+    return false;
+  }
+  std::cout << "Cache: Read " << part << " from " << path << std::endl;
+  solid = TopoDS::Solid(shape);
+  ManifestAddRecord("cache", {{"part", ManifestString(part)},
+                              {"hit", "true"}});
+  return true;
+}
+
+void ResultCacheStore(const BoltParameters &p, const char *part,
+                      const TopoDS_Solid &solid) {
+  if (!ResultCacheEnabled()) {
+    return;
+  }
+  ManifestAddRecord("cache", {{"part", ManifestString(part)},
+                              {"hit", "false"}});
+  // Written aside and renamed into place, so concurrent jobs only ever see
+  // complete files
+  const std::string path = CachePath(p, part);
+  const std::string staging = path + "." + std::to_string(getpid());
+  try {
+    ExportBinBRep(solid, staging.c_str());
+  } catch (const JobCancelled &) {
+    throw;
+  } catch (const std::exception &e) {
+    std::cerr << "Cache: Could not store " << part << ": " << e.what()
+              << std::endl;
+    std::remove(staging.c_str());
+    return;
+  }
+  if (std::rename(staging.c_str(), path.c_str()) != 0) {
+    std::cerr << "Cache: Could not store " << path << std::endl;
+    std::remove(staging.c_str());
+  }
+}
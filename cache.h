@@ -0,0 +1,34 @@
+/*
+    BoltGenerator - Result cache
+    Copyright (C) 2025
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <TopoDS_Solid.hxx>
+
+#include <string>
+
+#include "parameters.h"
+
+// Finished part solids kept as binary B-reps (see ExportBinBRep()) in a
+// directory shared by all jobs, keyed by a hash of every parameter they were
+// built from. A job, or a restarted session, with the same parameters reads
+// the part back instead of rebuilding it. Parameters are keyed after the
+// pre-flight clamps. An empty directory disables the cache.
+void SetResultCacheDir(const std::string &directory);
+bool ResultCacheEnabled();
+
+// Hash, as hex, of the construction version and the parameters `part`
+// ("bolt" or "nut") is built from
+std::string ResultCacheKey(const BoltParameters &p, const char *part);
+
+// Loading fails quietly on a miss or an unreadable file; storing only
+// throws when the job is cancelled.
+bool ResultCacheLoad(const BoltParameters &p, const char *part,
+                     TopoDS_Solid &solid);
+void ResultCacheStore(const BoltParameters &p, const char *part,
+                      const TopoDS_Solid &solid);
+
+#endif // CACHE_H
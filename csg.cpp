@@ -0,0 +1,748 @@
+#include "csg.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+// Broad phase cells per axis, at most
+constexpr int kMaxGridCells = 64;
+
+// Flips allowed per triangle of a split triangle while its intersection
+// segments are recovered; running out means the segments cross
+constexpr int kMaxFlipsPerTriangle = 64;
+
+struct Vec3 {
+  double x, y, z;
+};
+
+Vec3 operator+(const Vec3 &a, const Vec3 &b) {
+  return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+Vec3 operator-(const Vec3 &a, const Vec3 &b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+Vec3 operator*(double s, const Vec3 &a) { return {s * a.x, s * a.y, s * a.z}; }
+double Dot(const Vec3 &a, const Vec3 &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+Vec3 Cross(const Vec3 &a, const Vec3 &b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+double Length(const Vec3 &a) { return std::sqrt(Dot(a, a)); }
+
+// Six times the signed volume of (a, b, c, d); positive when d lies on the
+// side the normal of triangle (a, b, c) points to
+double Orient3d(const Vec3 &a, const Vec3 &b, const Vec3 &c, const Vec3 &d) {
+  return Dot(Cross(b - a, c - a), d - a);
+}
+
+using Triangle = std::array<std::uint32_t, 3>;
+
+std::uint64_t EdgeKey(std::uint32_t a, std::uint32_t b) {
+  return (a < b) ? (std::uint64_t(a) << 32 | b) : (std::uint64_t(b) << 32 | a);
+}
+
+// Both operands in one index space, a's vertices and triangles first. The
+// intersection points are appended to the points.
+struct Operands {
+  std::vector<Vec3> points;
+  std::vector<Triangle> triangles;
+  std::vector<std::uint32_t> faces; // result face of each triangle
+  std::uint32_t firstB;             // first triangle of b
+};
+
+void AddOperand(Operands &ops, const TriMesh &mesh, std::uint32_t firstFace) {
+  const std::uint32_t base = static_cast<std::uint32_t>(ops.points.size());
+  for (std::size_t v = 0; v < mesh.VertexCount(); ++v) {
+    const float *p = &mesh.positions[3 * v];
+    ops.points.push_back({p[0], p[1], p[2]});
+  }
+  std::size_t face = 0;
+  for (std::size_t t = 0; t < mesh.TriangleCount(); ++t) {
+    while (face + 1 < mesh.FaceCount() && mesh.faceTriangles[face + 1] <= t) {
+      ++face;
+    }
+    ops.triangles.push_back({base + mesh.indices[3 * t],
+                             base + mesh.indices[3 * t + 1],
+                             base + mesh.indices[3 * t + 2]});
+    ops.faces.push_back(firstFace + static_cast<std::uint32_t>(face));
+  }
+}
+
+struct Box {
+  Vec3 lo, hi;
+};
+
+Box TriangleBox(const Operands &ops, const Triangle &t) {
+  const Vec3 &a = ops.points[t[0]], &b = ops.points[t[1]],
+             &c = ops.points[t[2]];
+  return {{std::min({a.x, b.x, c.x}), std::min({a.y, b.y, c.y}),
+           std::min({a.z, b.z, c.z})},
+          {std::max({a.x, b.x, c.x}), std::max({a.y, b.y, c.y}),
+           std::max({a.z, b.z, c.z})}};
+}
+
+bool Overlap(const Box &a, const Box &b) {
+  return a.lo.x <= b.hi.x && b.lo.x <= a.hi.x && a.lo.y <= b.hi.y &&
+         b.lo.y <= a.hi.y && a.lo.z <= b.hi.z && b.lo.z <= a.hi.z;
+}
+
+// Pairs (triangle of a, triangle of b) with overlapping boxes, through a
+// uniform grid over the region the operands share
+std::vector<std::pair<std::uint32_t, std::uint32_t>>
+CandidatePairs(const Operands &ops) {
+  const std::uint32_t count = static_cast<std::uint32_t>(ops.triangles.size());
+  std::vector<Box> boxes(count);
+  const double inf = std::numeric_limits<double>::infinity();
+  Box boundsA = {{inf, inf, inf}, {-inf, -inf, -inf}}, boundsB = boundsA;
+  double sizeB = 0.0;
+  for (std::uint32_t t = 0; t < count; ++t) {
+    boxes[t] = TriangleBox(ops, ops.triangles[t]);
+    Box &bounds = (t < ops.firstB) ? boundsA : boundsB;
+    bounds.lo = {std::min(bounds.lo.x, boxes[t].lo.x),
+                 std::min(bounds.lo.y, boxes[t].lo.y),
+                 std::min(bounds.lo.z, boxes[t].lo.z)};
+    bounds.hi = {std::max(bounds.hi.x, boxes[t].hi.x),
+                 std::max(bounds.hi.y, boxes[t].hi.y),
+                 std::max(bounds.hi.z, boxes[t].hi.z)};
+    if (t >= ops.firstB) {
+      const Vec3 size = boxes[t].hi - boxes[t].lo;
+      sizeB += std::max({size.x, size.y, size.z});
+    }
+  }
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+  if (ops.firstB == 0 || ops.firstB == count || !Overlap(boundsA, boundsB)) {
+    return pairs;
+  }
+  const Box region = {{std::max(boundsA.lo.x, boundsB.lo.x),
+                       std::max(boundsA.lo.y, boundsB.lo.y),
+                       std::max(boundsA.lo.z, boundsB.lo.z)},
+                      {std::min(boundsA.hi.x, boundsB.hi.x),
+                       std::min(boundsA.hi.y, boundsB.hi.y),
+                       std::min(boundsA.hi.z, boundsB.hi.z)}};
+  const Vec3 extent = region.hi - region.lo;
+
+  // Cells about the size of b's triangles
+  double cell = std::max(sizeB / (count - ops.firstB),
+                         std::max({extent.x, extent.y, extent.z}) /
+                             kMaxGridCells);
+  if (!(cell > 0.0)) {
+    cell = 1.0;
+  }
+  const double extents[3] = {extent.x, extent.y, extent.z};
+  int cells[3];
+  for (int k = 0; k < 3; ++k) {
+    cells[k] = std::max(
+        1, std::min(kMaxGridCells,
+                    static_cast<int>(std::ceil(extents[k] / cell))));
+  }
+  auto cellRange = [&](const Box &box, int lo[3], int hi[3]) {
+    const double boxLo[3] = {box.lo.x - region.lo.x, box.lo.y - region.lo.y,
+                             box.lo.z - region.lo.z};
+    const double boxHi[3] = {box.hi.x - region.lo.x, box.hi.y - region.lo.y,
+                             box.hi.z - region.lo.z};
+    for (int k = 0; k < 3; ++k) {
+      lo[k] = std::max(0, std::min(cells[k] - 1,
+                                   static_cast<int>(std::floor(boxLo[k] / cell))));
+      hi[k] = std::max(0, std::min(cells[k] - 1,
+                                   static_cast<int>(std::floor(boxHi[k] / cell))));
+    }
+  };
+  auto forEachCell = [&](const Box &box, auto fn) {
+    int lo[3], hi[3];
+    cellRange(box, lo, hi);
+    for (int x = lo[0]; x <= hi[0]; ++x) {
+      for (int y = lo[1]; y <= hi[1]; ++y) {
+        for (int z = lo[2]; z <= hi[2]; ++z) {
+          fn((static_cast<std::size_t>(x) * cells[1] + y) * cells[2] + z);
+        }
+      }
+    }
+  };
+
+  // b's triangles per cell, counted first and then filled in place
+  const std::size_t cellCount =
+      static_cast<std::size_t>(cells[0]) * cells[1] * cells[2];
+  std::vector<std::uint32_t> start(cellCount + 1, 0);
+  for (std::uint32_t t = ops.firstB; t < count; ++t) {
+    if (Overlap(boxes[t], region)) {
+      forEachCell(boxes[t], [&](std::size_t c) { ++start[c + 1]; });
+    }
+  }
+  std::partial_sum(start.begin(), start.end(), start.begin());
+  std::vector<std::uint32_t> binned(start.back()), fill(start.begin(),
+                                                          start.end() - 1);
+  for (std::uint32_t t = ops.firstB; t < count; ++t) {
+    if (Overlap(boxes[t], region)) {
+      forEachCell(boxes[t], [&](std::size_t c) { binned[fill[c]++] = t; });
+    }
+  }
+
+  std::vector<std::uint32_t> seen(count, kNone);
+  for (std::uint32_t s = 0; s < ops.firstB; ++s) {
+    if (!Overlap(boxes[s], region)) {
+      continue;
+    }
+    forEachCell(boxes[s], [&](std::size_t c) {
+      for (std::uint32_t i = start[c]; i < start[c + 1]; ++i) {
+        const std::uint32_t t = binned[i];
+        if (seen[t] != s && Overlap(boxes[s], boxes[t])) {
+          seen[t] = s;
+          pairs.emplace_back(s, t);
+        }
+      }
+    });
+  }
+  return pairs;
+}
+
+// Whether edge (p, q) passes through triangle (t0, t1, t2), and where, as a
+// fraction of the way from p to q. Points on a plane count as above it, and
+// the edge's side of each triangle edge is decided the same way, so every
+// pair sharing the edge agrees.
+bool Pierces(const Vec3 &p, const Vec3 &q, const Vec3 &t0, const Vec3 &t1,
+             const Vec3 &t2, double &along) {
+  const double dp = Orient3d(t0, t1, t2, p), dq = Orient3d(t0, t1, t2, q);
+  if ((dp >= 0.0) == (dq >= 0.0)) {
+    return false;
+  }
+  const bool side = Orient3d(p, q, t0, t1) >= 0.0;
+  if ((Orient3d(p, q, t1, t2) >= 0.0) != side ||
+      (Orient3d(p, q, t2, t0) >= 0.0) != side) {
+    return false;
+  }
+  along = dp / (dp - dq);
+  return true;
+}
+
+// An intersection point: where edge (lo, hi) of one operand passes through a
+// triangle of the other
+struct Crossing {
+  std::uint32_t lo, hi, triangle;
+  bool operator==(const Crossing &o) const {
+    return lo == o.lo && hi == o.hi && triangle == o.triangle;
+  }
+};
+
+struct CrossingHash {
+  std::size_t operator()(const Crossing &c) const {
+    return static_cast<std::size_t>(
+        (c.lo * 0x9E3779B97F4A7C15ull) ^ (c.hi * 0xC2B2AE3D27D4EB4Full) ^
+        (c.triangle * 0x165667B19E3779F9ull));
+  }
+};
+
+struct Intersection {
+  std::uint32_t firstPoint; // intersection points follow the operands'
+  std::vector<Crossing> crossings; // per intersection point
+  // Crossings at an end of their edge are that vertex; the curve runs
+  // through it
+  std::unordered_map<Crossing, std::uint32_t, CrossingHash> pointOf;
+  // Intersection segments on each triangle
+  std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> segments;
+  std::unordered_set<std::uint64_t> curve; // the segments as edges
+};
+
+// Segment where triangles s (of a) and t (of b) cross. In general position
+// exactly two edges pass through the other triangle, or none; anything else
+// means the operands touch degenerately there. Vertices on the other
+// triangle's plane are common on meshes stored in floats: the curve passes
+// through them, and a triangle that only touches the plane there is not cut.
+bool IntersectPair(Operands &ops, Intersection &cut, std::uint32_t s,
+                   std::uint32_t t) {
+  std::uint32_t found[6];
+  int count = 0;
+  const std::uint32_t sides[2][2] = {{s, t}, {t, s}};
+  for (const auto &side : sides) {
+    const Triangle edges = ops.triangles[side[0]];
+    const Triangle other = ops.triangles[side[1]];
+    for (int k = 0; k < 3; ++k) {
+      const Crossing crossing = {std::min(edges[k], edges[(k + 1) % 3]),
+                                 std::max(edges[k], edges[(k + 1) % 3]),
+                                 side[1]};
+      double along;
+      if (!Pierces(ops.points[crossing.lo], ops.points[crossing.hi],
+                   ops.points[other[0]], ops.points[other[1]],
+                   ops.points[other[2]], along)) {
+        continue;
+      }
+      if (along == 0.0 || along == 1.0) {
+        found[count++] = (along == 0.0) ? crossing.lo : crossing.hi;
+        continue;
+      }
+      auto inserted = cut.pointOf.emplace(
+          crossing, static_cast<std::uint32_t>(ops.points.size()));
+      if (inserted.second) {
+        const Vec3 &lo = ops.points[crossing.lo], &hi = ops.points[crossing.hi];
+        ops.points.push_back(lo + along * (hi - lo));
+        cut.crossings.push_back(crossing);
+      }
+      found[count++] = inserted.first->second;
+    }
+  }
+  if (count == 0 || (count == 2 && found[0] == found[1])) {
+    return true;
+  }
+  if (count != 2) {
+    return false;
+  }
+  cut.segments[s].emplace_back(found[0], found[1]);
+  cut.segments[t].emplace_back(found[0], found[1]);
+  cut.curve.insert(EdgeKey(found[0], found[1]));
+  return true;
+}
+
+// Constrained triangulation of one triangle with the intersection points on
+// it, in the triangle's own plane. Points are inserted with Delaunay flips,
+// then the intersection segments are flipped into the triangulation.
+class SplitTriangle {
+public:
+  SplitTriangle(const Operands &ops, const Triangle &corners) : ops(ops) {
+    origin = ops.points[corners[0]];
+    const Vec3 e1 = ops.points[corners[1]] - origin;
+    const Vec3 normal = Cross(e1, ops.points[corners[2]] - origin);
+    degenerate = !(Length(normal) > 0.0);
+    if (!degenerate) {
+      u = (1.0 / Length(e1)) * e1;
+      const Vec3 w = Cross(normal, u);
+      v = (1.0 / Length(w)) * w;
+    }
+    for (std::uint32_t c : corners) {
+      Add(c);
+    }
+    triangles.push_back({0, 1, 2});
+  }
+
+  bool Degenerate() const { return degenerate; }
+
+  // Inserts a point on side k (corner k to corner k + 1). Points on a side
+  // must come in order along it.
+  void InsertOnSide(std::uint32_t global, int k) {
+    const int p = Add(global);
+    const int a = lastOnSide[k] >= 0 ? lastOnSide[k] : k;
+    const int b = (k + 1) % 3;
+    lastOnSide[k] = p;
+    const int t = Find(a, b);
+    const int c = Third(triangles[t], a, b);
+    triangles[t] = {a, p, c};
+    triangles.push_back({p, b, c});
+    Legalize(p, {{c, a}, {b, c}});
+  }
+
+  void InsertInside(std::uint32_t global) {
+    const int p = Add(global);
+    // The triangle the point is deepest inside
+    int best = 0;
+    double depth = -std::numeric_limits<double>::infinity();
+    for (std::size_t t = 0; t < triangles.size(); ++t) {
+      double inside = std::numeric_limits<double>::infinity();
+      for (int k = 0; k < 3; ++k) {
+        const int a = triangles[t][k], b = triangles[t][(k + 1) % 3];
+        const double len = std::hypot(x[b] - x[a], y[b] - y[a]);
+        inside = std::min(inside, Orient(a, b, p) / len);
+      }
+      if (inside > depth) {
+        depth = inside;
+        best = static_cast<int>(t);
+      }
+    }
+    const std::array<int, 3> old = triangles[best];
+    triangles[best] = {old[0], old[1], p};
+    triangles.push_back({old[1], old[2], p});
+    triangles.push_back({old[2], old[0], p});
+    Legalize(p, {{old[0], old[1]}, {old[1], old[2]}, {old[2], old[0]}});
+  }
+
+  // Flips edges until the segment between two inserted points is an edge
+  bool Constrain(std::uint32_t globalA, std::uint32_t globalB) {
+    const int a = Local(globalA), b = Local(globalB);
+    if (a == b) {
+      return false;
+    }
+    if (Find(a, b) < 0 && Find(b, a) < 0) {
+      std::deque<std::pair<int, int>> crossing;
+      for (const std::array<int, 3> &t : triangles) {
+        for (int k = 0; k < 3; ++k) {
+          const int c = t[k], d = t[(k + 1) % 3];
+          if (c < d && Cross2d(a, b, c, d)) {
+            crossing.emplace_back(c, d);
+          }
+        }
+      }
+      long budget = kMaxFlipsPerTriangle * static_cast<long>(triangles.size());
+      while (!crossing.empty()) {
+        if (--budget < 0) {
+          return false;
+        }
+        const std::pair<int, int> edge = crossing.front();
+        crossing.pop_front();
+        const int t1 = Find(edge.first, edge.second);
+        const int t2 = Find(edge.second, edge.first);
+        if (t1 < 0 || t2 < 0 || constrained.count(Key(edge.first, edge.second))) {
+          return false;
+        }
+        const int c = Third(triangles[t1], edge.first, edge.second);
+        const int d = Third(triangles[t2], edge.second, edge.first);
+        if (!Cross2d(edge.first, edge.second, c, d)) {
+          // Not convex yet; another flip will make it so
+          crossing.push_back(edge);
+          continue;
+        }
+        triangles[t1] = {edge.first, d, c};
+        triangles[t2] = {d, edge.second, c};
+        if (Cross2d(a, b, c, d)) {
+          crossing.emplace_back(c, d);
+        }
+      }
+    }
+    constrained.insert(Key(a, b));
+    return true;
+  }
+
+  void Emit(std::vector<Triangle> &out) const {
+    for (const std::array<int, 3> &t : triangles) {
+      out.push_back({global[t[0]], global[t[1]], global[t[2]]});
+    }
+  }
+
+private:
+  const Operands &ops;
+  Vec3 origin, u, v;
+  bool degenerate;
+  std::vector<double> x, y;
+  std::vector<std::uint32_t> global;
+  std::unordered_map<std::uint32_t, int> local;
+  std::vector<std::array<int, 3>> triangles; // counter-clockwise
+  std::unordered_set<std::uint64_t> constrained;
+  int lastOnSide[3] = {-1, -1, -1};
+
+  int Add(std::uint32_t g) {
+    const Vec3 d = ops.points[g] - origin;
+    x.push_back(Dot(d, u));
+    y.push_back(Dot(d, v));
+    global.push_back(g);
+    local.emplace(g, static_cast<int>(global.size()) - 1);
+    return static_cast<int>(global.size()) - 1;
+  }
+
+  int Local(std::uint32_t g) const {
+    auto it = local.find(g);
+    return (it == local.end()) ? -1 : it->second;
+  }
+
+  static std::uint64_t Key(int a, int b) {
+    return EdgeKey(static_cast<std::uint32_t>(a), static_cast<std::uint32_t>(b));
+  }
+
+  static int Third(const std::array<int, 3> &t, int a, int b) {
+    for (int k : t) {
+      if (k != a && k != b) {
+        return k;
+      }
+    }
+    return -1;
+  }
+
+  // Triangle with the directed edge a -> b, or -1
+  int Find(int a, int b) const {
+    for (std::size_t t = 0; t < triangles.size(); ++t) {
+      for (int k = 0; k < 3; ++k) {
+        if (triangles[t][k] == a && triangles[t][(k + 1) % 3] == b) {
+          return static_cast<int>(t);
+        }
+      }
+    }
+    return -1;
+  }
+
+  double Orient(int a, int b, int c) const {
+    return (x[b] - x[a]) * (y[c] - y[a]) - (y[b] - y[a]) * (x[c] - x[a]);
+  }
+
+  // Whether segments (a, b) and (c, d) cross at a point inside both
+  bool Cross2d(int a, int b, int c, int d) const {
+    const double c1 = Orient(a, b, c), d1 = Orient(a, b, d);
+    const double a1 = Orient(c, d, a), b1 = Orient(c, d, b);
+    return ((c1 > 0.0 && d1 < 0.0) || (c1 < 0.0 && d1 > 0.0)) &&
+           ((a1 > 0.0 && b1 < 0.0) || (a1 < 0.0 && b1 > 0.0));
+  }
+
+  // Whether d lies inside the circumcircle of counter-clockwise (a, b, c)
+  bool InCircle(int a, int b, int c, int d) const {
+    const double adx = x[a] - x[d], ady = y[a] - y[d];
+    const double bdx = x[b] - x[d], bdy = y[b] - y[d];
+    const double cdx = x[c] - x[d], cdy = y[c] - y[d];
+    return (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy) +
+               (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy) +
+               (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady) >
+           0.0;
+  }
+
+  // Lawson flips around a new point p; each edge (a, b) is opposite p in
+  // triangle (a, b, p)
+  void Legalize(int p, std::vector<std::pair<int, int>> edges) {
+    while (!edges.empty()) {
+      const std::pair<int, int> edge = edges.back();
+      edges.pop_back();
+      const int t1 = Find(edge.first, edge.second);
+      const int t2 = Find(edge.second, edge.first);
+      if (t1 < 0 || t2 < 0) {
+        continue; // the triangle's own sides stay
+      }
+      const int d = Third(triangles[t2], edge.second, edge.first);
+      if (!InCircle(edge.first, edge.second, p, d)) {
+        continue;
+      }
+      triangles[t1] = {edge.first, d, p};
+      triangles[t2] = {d, edge.second, p};
+      edges.emplace_back(edge.first, d);
+      edges.emplace_back(d, edge.second);
+    }
+  }
+};
+
+// Splits triangle t along its intersection segments
+bool SplitAlongCurve(const Operands &ops, const Intersection &cut,
+                     std::uint32_t t, std::vector<Triangle> &out) {
+  const Triangle &corners = ops.triangles[t];
+  SplitTriangle split(ops, corners);
+  if (split.Degenerate()) {
+    return false;
+  }
+
+  // Points on the triangle's sides are where its own edges cross the other
+  // operand; the rest are where the other operand's edges cross it
+  std::vector<std::uint32_t> inside;
+  std::vector<std::pair<double, std::uint32_t>> onSide[3];
+  std::unordered_set<std::uint32_t> seen;
+  for (const auto &segment : cut.segments[t]) {
+    for (std::uint32_t point : {segment.first, segment.second}) {
+      if (!seen.insert(point).second ||
+          std::find(corners.begin(), corners.end(), point) != corners.end()) {
+        continue;
+      }
+      // A vertex of the other operand on this triangle's plane
+      if (point < cut.firstPoint ||
+          cut.crossings[point - cut.firstPoint].triangle == t) {
+        inside.push_back(point);
+        continue;
+      }
+      const Crossing &crossing = cut.crossings[point - cut.firstPoint];
+      int side = -1;
+      for (int k = 0; k < 3; ++k) {
+        if (EdgeKey(corners[k], corners[(k + 1) % 3]) ==
+            EdgeKey(crossing.lo, crossing.hi)) {
+          side = k;
+        }
+      }
+      if (side < 0) {
+        return false;
+      }
+      const Vec3 &a = ops.points[corners[side]];
+      const Vec3 edge = ops.points[corners[(side + 1) % 3]] - a;
+      onSide[side].emplace_back(Dot(ops.points[point] - a, edge), point);
+    }
+  }
+  for (int k = 0; k < 3; ++k) {
+    std::sort(onSide[k].begin(), onSide[k].end());
+    for (const auto &point : onSide[k]) {
+      split.InsertOnSide(point.second, k);
+    }
+  }
+  for (std::uint32_t point : inside) {
+    split.InsertInside(point);
+  }
+  for (const auto &segment : cut.segments[t]) {
+    if (!split.Constrain(segment.first, segment.second)) {
+      return false;
+    }
+  }
+  split.Emit(out);
+  return true;
+}
+
+// Generalized winding number of triangles [first, end) around p: about 1
+// inside a closed mesh, 0 outside
+double WindingNumber(const Operands &ops, std::uint32_t first,
+                     std::uint32_t end, const Vec3 &p) {
+  double solidAngle = 0.0;
+  for (std::uint32_t t = first; t < end; ++t) {
+    const Vec3 a = ops.points[ops.triangles[t][0]] - p;
+    const Vec3 b = ops.points[ops.triangles[t][1]] - p;
+    const Vec3 c = ops.points[ops.triangles[t][2]] - p;
+    const double la = Length(a), lb = Length(b), lc = Length(c);
+    const double numerator = Dot(a, Cross(b, c));
+    const double denominator =
+        la * lb * lc + Dot(a, b) * lc + Dot(b, c) * la + Dot(c, a) * lb;
+    solidAngle += 2.0 * std::atan2(numerator, denominator);
+  }
+  return solidAngle / (4.0 * M_PI);
+}
+
+struct Piece {
+  Triangle corners;
+  std::uint32_t face;
+  bool fromB;
+};
+
+std::uint32_t Root(std::vector<std::uint32_t> &parent, std::uint32_t i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+} // namespace
+
+bool MeshBoolean(const TriMesh &a, const TriMesh &b, MeshBooleanOp op,
+                 TriMesh &result) {
+  result = TriMesh();
+  Operands ops;
+  AddOperand(ops, a, 0);
+  ops.firstB = static_cast<std::uint32_t>(ops.triangles.size());
+  AddOperand(ops, b, static_cast<std::uint32_t>(std::max<std::size_t>(
+                         1, a.FaceCount())));
+  const std::uint32_t triangleCount =
+      static_cast<std::uint32_t>(ops.triangles.size());
+
+  Intersection cut;
+  cut.firstPoint = static_cast<std::uint32_t>(ops.points.size());
+  cut.segments.resize(triangleCount);
+  for (const auto &pair : CandidatePairs(ops)) {
+    if (!IntersectPair(ops, cut, pair.first, pair.second)) {
+      return false;
+    }
+  }
+
+  // Every triangle, split along the intersection curve where it crosses it
+  std::vector<Piece> pieces;
+  pieces.reserve(triangleCount + 4 * cut.crossings.size());
+  std::vector<Triangle> split;
+  for (std::uint32_t t = 0; t < triangleCount; ++t) {
+    const bool fromB = (t >= ops.firstB);
+    if (cut.segments[t].empty()) {
+      pieces.push_back({ops.triangles[t], ops.faces[t], fromB});
+      continue;
+    }
+    split.clear();
+    if (!SplitAlongCurve(ops, cut, t, split)) {
+      return false;
+    }
+    for (const Triangle &corners : split) {
+      pieces.push_back({corners, ops.faces[t], fromB});
+    }
+  }
+
+  // Pieces connected other than across the curve lie on the same side of
+  // the other operand
+  const std::uint32_t pieceCount = static_cast<std::uint32_t>(pieces.size());
+  std::vector<std::uint32_t> parent(pieceCount);
+  std::iota(parent.begin(), parent.end(), 0);
+  std::unordered_map<std::uint64_t, std::uint32_t> edgeOwner;
+  edgeOwner.reserve(3 * static_cast<std::size_t>(pieceCount));
+  for (std::uint32_t i = 0; i < pieceCount; ++i) {
+    const Triangle &c = pieces[i].corners;
+    for (int k = 0; k < 3; ++k) {
+      const std::uint64_t key = EdgeKey(c[k], c[(k + 1) % 3]);
+      if (cut.curve.count(key)) {
+        continue;
+      }
+      auto owner = edgeOwner.emplace(key, i);
+      if (!owner.second) {
+        parent[Root(parent, i)] = Root(parent, owner.first->second);
+      }
+    }
+  }
+
+  // One winding number per component, at its largest piece
+  std::vector<std::uint32_t> representative(pieceCount, kNone);
+  std::vector<double> area(pieceCount, 0.0);
+  for (std::uint32_t i = 0; i < pieceCount; ++i) {
+    const Triangle &c = pieces[i].corners;
+    area[i] = Length(Cross(ops.points[c[1]] - ops.points[c[0]],
+                           ops.points[c[2]] - ops.points[c[0]]));
+    std::uint32_t &best = representative[Root(parent, i)];
+    if (best == kNone || area[i] > area[best]) {
+      best = i;
+    }
+  }
+  std::vector<char> inside(pieceCount, 0);
+  for (std::uint32_t root = 0; root < pieceCount; ++root) {
+    const std::uint32_t i = representative[root];
+    if (i == kNone) {
+      continue;
+    }
+    const Triangle &c = pieces[i].corners;
+    const Vec3 centroid = (1.0 / 3.0) * (ops.points[c[0]] + ops.points[c[1]] +
+                                         ops.points[c[2]]);
+    const double winding =
+        pieces[i].fromB ? WindingNumber(ops, 0, ops.firstB, centroid)
+                        : WindingNumber(ops, ops.firstB, triangleCount,
+                                        centroid);
+    inside[root] = (winding > 0.5);
+  }
+
+  std::vector<Piece> kept;
+  for (std::uint32_t i = 0; i < pieceCount; ++i) {
+    const bool in = inside[Root(parent, i)];
+    Piece piece = pieces[i];
+    bool keep = false;
+    switch (op) {
+    case MeshBooleanOp::UNION:
+      keep = !in;
+      break;
+    case MeshBooleanOp::INTERSECTION:
+      keep = in;
+      break;
+    case MeshBooleanOp::DIFFERENCE:
+      // b's surface inside a becomes the wall of the cavity, facing in
+      keep = piece.fromB ? in : !in;
+      if (keep && piece.fromB) {
+        std::swap(piece.corners[1], piece.corners[2]);
+      }
+      break;
+    }
+    if (keep) {
+      kept.push_back(piece);
+    }
+  }
+  std::stable_sort(kept.begin(), kept.end(), [](const Piece &l, const Piece &r) {
+    return l.face < r.face;
+  });
+
+  std::vector<std::uint32_t> index(ops.points.size(), kNone);
+  for (std::size_t i = 0; i < kept.size(); ++i) {
+    if (i == 0 || kept[i].face != kept[i - 1].face) {
+      result.faceTriangles.push_back(static_cast<std::uint32_t>(i));
+    }
+    for (std::uint32_t v : kept[i].corners) {
+      if (index[v] == kNone) {
+        index[v] = static_cast<std::uint32_t>(result.VertexCount());
+        result.positions.insert(result.positions.end(),
+                                {static_cast<float>(ops.points[v].x),
+                                 static_cast<float>(ops.points[v].y),
+                                 static_cast<float>(ops.points[v].z)});
+      }
+      result.indices.push_back(index[v]);
+    }
+  }
+  result.faceTriangles.push_back(static_cast<std::uint32_t>(kept.size()));
+
+  if (OpenEdgeCount(result) != 0) {
+    result = TriMesh();
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,28 @@
+/*
+    BoltGenerator - Mesh booleans
+    Copyright (C) 2025
+*/
+
+#ifndef CSG_H
+#define CSG_H
+
+#include "trimesh.h"
+
+enum class MeshBooleanOp { UNION, DIFFERENCE, INTERSECTION };
+
+// Boolean of two closed, consistently oriented, shared-vertex meshes (a - b
+// for DIFFERENCE). Triangles that cross the other mesh are split along the
+// intersection curve, the pieces on either side are sorted by the winding
+// number of the other mesh, and the kept ones are stitched on the shared
+// intersection vertices, so the result is closed again. Faces of both
+// operands carry over into the result's face mapping.
+//
+// Meant for preview-sized meshes of a few thousand to a few hundred thousand
+// triangles. The predicates are plain floating point: operands must meet in
+// general position (no coplanar faces, no edge running through an edge), so
+// primitives that only touch should overlap instead. Returns false, leaving
+// `result` empty, when they do not, or when the result is not closed.
+bool MeshBoolean(const TriMesh &a, const TriMesh &b, MeshBooleanOp op,
+                 TriMesh &result);
+
+#endif // CSG_H
@@ -18,13 +18,136 @@
 */
 
 #include "cut.h"
+#include "progress.h"
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 #include <vector>
+#include <BOPAlgo_GlueEnum.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
+#include <BRepCheck_Analyzer.hxx>
 #include <GProp_GProps.hxx>
 #include <BRepGProp.hxx>
+#include <TopTools_ListOfShape.hxx>
 
-TopoDS_Solid Cut(TopoDS_Shape body, TopoDS_Shape tool)
+namespace
+{
+    struct BooleanStrategy
+    {
+        const char *name;
+        double fuzzyValue;
+        BOPAlgo_GlueEnum glue;
+    };
+
+    const BooleanStrategy defaultStrategy = {"fuzzy 1e-6", 1.0e-6, BOPAlgo_GlueOff};
+
+    // Ordered from most to least precise; the race accepts whichever of them
+    // first produces a valid solid.
+    const BooleanStrategy raceStrategies[] = {
+        {"exact", 0.0, BOPAlgo_GlueOff},
+        {"fuzzy 1e-6", 1.0e-6, BOPAlgo_GlueOff},
+        {"fuzzy 1e-4 + glue", 1.0e-4, BOPAlgo_GlueShift},
+    };
+
+    CutStrategy cutStrategy = CutStrategy::SINGLE;
+
+    double Volume(const TopoDS_Shape &shape)
+    {
+        GProp_GProps props;
+        BRepGProp::VolumeProperties(shape, props);
+        return props.Mass();
+    }
+
+    bool RunCut(const TopoDS_Shape &body, const TopoDS_Shape &tool,
+                const BooleanStrategy &strategy,
+                const Message_ProgressRange &range, TopoDS_Shape &result)
+    {
+        TopTools_ListOfShape arguments, tools;
+        arguments.Append(body);
+        tools.Append(tool);
+
+        BRepAlgoAPI_Cut cutOp;
+        cutOp.SetArguments(arguments);
+        cutOp.SetTools(tools);
+        cutOp.SetFuzzyValue(strategy.fuzzyValue);
+        cutOp.SetGlue(strategy.glue);
+        cutOp.Build(range);
+
+        if (!cutOp.IsDone() || cutOp.HasErrors())
+            return false;
+        result = cutOp.Shape();
+        return true;
+    }
+
+    // A racing result only wins if it is a valid solid that actually lost
+    // material; a fast but broken result must not cancel a slower good one.
+    bool IsValidCut(const TopoDS_Shape &result, double volumeBefore)
+    {
+        double largest = 0.0;
+        TopoDS_Shape largestSolid;
+        for (TopExp_Explorer ex(result, TopAbs_SOLID); ex.More(); ex.Next()) {
+            double vol = Volume(ex.Current());
+            if (vol > largest) {
+                largest = vol;
+                largestSolid = ex.Current();
+            }
+        }
+        if (largestSolid.IsNull() || largest >= volumeBefore)
+            return false;
+        return BRepCheck_Analyzer(largestSolid).IsValid();
+    }
+
+    bool RaceCut(const TopoDS_Shape &body, const TopoDS_Shape &tool,
+                 double volumeBefore, TopoDS_Shape &result)
+    {
+        std::atomic<bool> finished(false);
+        std::mutex resultMutex;
+        const char *winner = nullptr;
+
+        std::vector<std::thread> racers;
+        for (const BooleanStrategy &strategy : raceStrategies) {
+            racers.emplace_back([&, strategy]() {
+                try {
+                    // Booleans may update tolerances on their arguments, so
+                    // every racer works on its own copy of the inputs.
+                    TopoDS_Shape bodyCopy = BRepBuilderAPI_Copy(body).Shape();
+                    TopoDS_Shape toolCopy = BRepBuilderAPI_Copy(tool).Shape();
+
+                    Handle(CancelIndicator) progress = new CancelIndicator(&finished);
+                    TopoDS_Shape candidate;
+                    if (!RunCut(bodyCopy, toolCopy, strategy, progress->Start(), candidate))
+                        return;
+                    if (finished.load() || !IsValidCut(candidate, volumeBefore))
+                        return;
+
+                    std::lock_guard<std::mutex> lock(resultMutex);
+                    if (!finished.exchange(true)) {
+                        winner = strategy.name;
+                        result = candidate;
+                    }
+                } catch (...) {
+                    // A crashing strategy simply drops out of the race.
+                }
+            });
+        }
+        for (std::thread &racer : racers)
+            racer.join();
+
+        if (winner == nullptr)
+            return false;
+        std::cout << "Cut: Race won by " << winner << " strategy" << std::endl;
+        return true;
+    }
+}
+
+void SetCutStrategy(CutStrategy strategy)
+{
+    cutStrategy = strategy;
+}
+
+bool TryCut(const TopoDS_Shape &body, const TopoDS_Shape &tool, TopoDS_Solid &resultSolid)
 {
     /*
         BRepAlgoAPI_Cut() works well, but it returns type TopoDS_Compound. This
@@ -36,26 +159,24 @@ TopoDS_Solid Cut(TopoDS_Shape body, TopoDS_Shape tool)
     std::cout << "Cut: Performing boolean cut operation..." << std::endl;
     
     // Calculate volume before cut
-    GProp_GProps propsBody;
-    BRepGProp::VolumeProperties(body, propsBody);
-    double volumeBefore = propsBody.Mass();
+    double volumeBefore = Volume(body);
     std::cout << "Cut: Body volume before cut: " << volumeBefore << " mm³" << std::endl;
     
-    BRepAlgoAPI_Cut cutOp(body, tool);
-    cutOp.SetFuzzyValue(1.0e-6);
-    cutOp.Build();
+    TopoDS_Shape result;
+    bool done = false;
+    if (cutStrategy == CutStrategy::RACE) {
+        done = RaceCut(body, tool, volumeBefore, result);
+    } else {
+        Handle(CancelIndicator) progress = new CancelIndicator();
+        done = RunCut(body, tool, defaultStrategy, progress->Start(), result);
+    }
+    ThrowIfCancelled("boolean cut");
     
-    if (!cutOp.IsDone()) {
+    if (!done) {
         std::cerr << "ERROR: Cut operation failed!" << std::endl;
-        // Return original body if cut fails
-        if (body.ShapeType() == TopAbs_SOLID) {
-            std::cerr << "WARNING: Returning original body unchanged due to cut failure" << std::endl;
-            return TopoDS::Solid(body);
-        }
-        throw std::runtime_error("Cut operation failed and body is not a solid");
+        return false;
     }
     
-    TopoDS_Shape result = cutOp.Shape();
     std::cout << "Cut: Result shape type: " << result.ShapeType() << std::endl;
     
     // Collect all solids from result
@@ -72,23 +193,16 @@ TopoDS_Solid Cut(TopoDS_Shape body, TopoDS_Shape tool)
     
     if (solids.empty()) {
         std::cerr << "ERROR: No solid found in cut result!" << std::endl;
-        // Try to return the original body instead of failing
-        if (body.ShapeType() == TopAbs_SOLID) {
-            std::cerr << "WARNING: Returning original body unchanged (no solid in result)" << std::endl;
-            return TopoDS::Solid(body);
-        }
-        throw std::runtime_error("No solid found in cut result");
+        return false;
     }
     
     // If multiple solids, pick the one with largest volume (should be the body after cut)
-    TopoDS_Solid resultSolid = solids[0];
+    resultSolid = solids[0];
     if (solids.size() > 1) {
         std::cout << "Cut: Multiple solids found, selecting largest volume..." << std::endl;
         double maxVolume = 0;
         for (const auto& solid : solids) {
-            GProp_GProps props;
-            BRepGProp::VolumeProperties(solid, props);
-            double vol = props.Mass();
+            double vol = Volume(solid);
             std::cout << "  Solid volume: " << vol << " mm³" << std::endl;
             if (vol > maxVolume) {
                 maxVolume = vol;
@@ -99,13 +213,25 @@ TopoDS_Solid Cut(TopoDS_Shape body, TopoDS_Shape tool)
     }
     
     // Calculate volume after cut
-    GProp_GProps propsResult;
-    BRepGProp::VolumeProperties(resultSolid, propsResult);
-    double volumeAfter = propsResult.Mass();
+    double volumeAfter = Volume(resultSolid);
     double volumeRemoved = volumeBefore - volumeAfter;
     std::cout << "Cut: Result volume after cut: " << volumeAfter << " mm³" << std::endl;
     std::cout << "Cut: Volume removed: " << volumeRemoved << " mm³ (" << (volumeRemoved/volumeBefore*100) << "%)" << std::endl;
     
     std::cout << "Cut: Successfully extracted solid from result" << std::endl;
-    return resultSolid;
+    return true;
+}
+
+TopoDS_Solid Cut(TopoDS_Shape body, TopoDS_Shape tool)
+{
+    TopoDS_Solid result;
+    if (TryCut(body, tool, result))
+        return result;
+
+    // Return original body if cut fails
+    if (body.ShapeType() == TopAbs_SOLID) {
+        std::cerr << "WARNING: Returning original body unchanged due to cut failure" << std::endl;
+        return TopoDS::Solid(body);
+    }
+    throw std::runtime_error("Cut operation failed and body is not a solid");
 }
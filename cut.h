@@ -26,6 +26,19 @@
 #include <TopoDS_Shape.hxx>
 #include <TopoDS_Solid.hxx>
 
+// SINGLE runs one boolean with the default fuzzy value (1e-6). RACE runs the
+// exact, fuzzy 1e-6 and fuzzy 1e-4 + glue strategies concurrently, keeps the
+// first valid result and cancels the others.
+enum class CutStrategy { SINGLE = 0, RACE = 1 };
+
+void SetCutStrategy(CutStrategy strategy);
+
+// Returns the largest solid of body - tool, or the body unchanged (with a
+// warning) if the boolean fails.
 TopoDS_Solid Cut(TopoDS_Shape body, TopoDS_Shape tool);
 
+// Same as Cut(), but reports failure instead of hiding it, for callers that
+// have a fallback of their own.
+bool TryCut(const TopoDS_Shape &body, const TopoDS_Shape &tool, TopoDS_Solid &result);
+
 #endif
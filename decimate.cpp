@@ -0,0 +1,465 @@
+#include "decimate.h"
+#include "budget.h"
+#include "progress.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace {
+constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+// Constraint planes along outlines and creases weigh this much more than
+// surface planes of the same area
+constexpr double kFeatureWeight = 1000.0;
+
+// A collapse may not turn any surrounding triangle by more than ~78 degrees
+constexpr double kMinNormalDot = 0.2;
+
+// Collapses between polls of the cancel flag and the stage deadline
+constexpr std::size_t kCollapsesPerPoll = 4096;
+
+struct Vec3 {
+  double x, y, z;
+};
+
+Vec3 operator+(const Vec3 &a, const Vec3 &b) {
+  return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+Vec3 operator-(const Vec3 &a, const Vec3 &b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+Vec3 operator*(const Vec3 &a, double s) { return {a.x * s, a.y * s, a.z * s}; }
+double Dot(const Vec3 &a, const Vec3 &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+Vec3 Cross(const Vec3 &a, const Vec3 &b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+double Length(const Vec3 &a) { return std::sqrt(Dot(a, a)); }
+
+// Symmetric 4x4 error quadric (upper triangle): sum of w * (n.p + d)^2
+struct Quadric {
+  double m[10] = {}; // aa ab ac ad bb bc bd cc cd dd
+
+  void AddPlane(const Vec3 &n, double d, double w) {
+    m[0] += w * n.x * n.x;
+    m[1] += w * n.x * n.y;
+    m[2] += w * n.x * n.z;
+    m[3] += w * n.x * d;
+    m[4] += w * n.y * n.y;
+    m[5] += w * n.y * n.z;
+    m[6] += w * n.y * d;
+    m[7] += w * n.z * n.z;
+    m[8] += w * n.z * d;
+    m[9] += w * d * d;
+  }
+
+  Quadric &operator+=(const Quadric &o) {
+    for (int i = 0; i < 10; ++i) {
+      m[i] += o.m[i];
+    }
+    return *this;
+  }
+
+  double Error(const Vec3 &p) const {
+    return m[0] * p.x * p.x + 2 * m[1] * p.x * p.y + 2 * m[2] * p.x * p.z +
+           2 * m[3] * p.x + m[4] * p.y * p.y + 2 * m[5] * p.y * p.z +
+           2 * m[6] * p.y + m[7] * p.z * p.z + 2 * m[8] * p.z + m[9];
+  }
+
+  // Position of least error; false when the quadric is (nearly) singular,
+  // e.g. for a vertex on a flat patch
+  bool Minimum(Vec3 &p) const {
+    double c00 = m[4] * m[7] - m[5] * m[5];
+    double c01 = m[2] * m[5] - m[1] * m[7];
+    double c02 = m[1] * m[5] - m[2] * m[4];
+    double c11 = m[0] * m[7] - m[2] * m[2];
+    double c12 = m[1] * m[2] - m[0] * m[5];
+    double c22 = m[0] * m[4] - m[1] * m[1];
+    double det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+    double trace = (m[0] + m[4] + m[7]) / 3.0;
+    if (!(std::fabs(det) > 1e-9 * trace * trace * trace)) {
+      return false;
+    }
+    p = {-(c00 * m[3] + c01 * m[6] + c02 * m[8]) / det,
+         -(c01 * m[3] + c11 * m[6] + c12 * m[8]) / det,
+         -(c02 * m[3] + c12 * m[6] + c22 * m[8]) / det};
+    return true;
+  }
+};
+
+struct Candidate {
+  double cost;
+  std::uint32_t u, v; // v collapses into u
+  std::uint32_t versionU, versionV;
+  Vec3 target;
+
+  bool operator>(const Candidate &o) const { return cost > o.cost; }
+};
+
+class Decimator {
+public:
+  explicit Decimator(const TriMesh &mesh);
+
+  // Collapses the cheapest valid edges until at most `budget` triangles are
+  // left (or nothing can collapse, or the stage deadline passes) and returns
+  // the current mesh
+  TriMesh Reduce(std::size_t budget);
+  bool Stopped() const { return stopped; }
+
+private:
+  bool HasVertex(std::uint32_t t, std::uint32_t v) const {
+    return tris[t][0] == v || tris[t][1] == v || tris[t][2] == v;
+  }
+  Vec3 Corner(std::uint32_t t, int k, std::uint32_t u, std::uint32_t v,
+              const Vec3 &target) const {
+    std::uint32_t w = tris[t][k];
+    return (w == u || w == v) ? target : positions[w];
+  }
+  std::uint32_t NextStamp() { return ++stamp; }
+
+  void AddConstraint(std::uint32_t a, std::uint32_t b, std::uint32_t t);
+  Candidate Evaluate(std::uint32_t u, std::uint32_t v) const;
+  bool IsValid(const Candidate &c);
+  void Collapse(const Candidate &c);
+  TriMesh Snapshot() const;
+
+  std::size_t faceCount;
+  std::vector<Vec3> positions;
+  std::vector<Quadric> quadrics;
+  std::vector<std::uint32_t> versions;
+  std::vector<char> deadVertices;
+  std::vector<std::array<std::uint32_t, 3>> tris;
+  std::vector<std::uint32_t> triFaces;
+  std::vector<char> deadTris;
+  std::vector<std::vector<std::uint32_t>> vertexTris;
+  std::size_t liveTris = 0;
+  bool stopped = false; // at the stage deadline
+
+  // Scratch marks for neighbourhood queries
+  std::vector<std::uint32_t> marks;
+  std::uint32_t stamp = 0;
+
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>>
+      heap;
+};
+
+Decimator::Decimator(const TriMesh &mesh)
+    : faceCount(std::max<std::size_t>(1, mesh.FaceCount())) {
+  const std::size_t vertexCount = mesh.VertexCount();
+  positions.resize(vertexCount);
+  for (std::size_t v = 0; v < vertexCount; ++v) {
+    positions[v] = {mesh.positions[3 * v], mesh.positions[3 * v + 1],
+                    mesh.positions[3 * v + 2]};
+  }
+  quadrics.resize(vertexCount);
+  versions.assign(vertexCount, 0);
+  deadVertices.assign(vertexCount, 0);
+  marks.assign(vertexCount, 0);
+  vertexTris.resize(vertexCount);
+
+  const std::size_t triangleCount = mesh.TriangleCount();
+  tris.resize(triangleCount);
+  triFaces.assign(triangleCount, 0);
+  deadTris.assign(triangleCount, 0);
+  for (std::size_t f = 0; f + 1 < mesh.faceTriangles.size(); ++f) {
+    std::fill(triFaces.begin() + mesh.faceTriangles[f],
+              triFaces.begin() + mesh.faceTriangles[f + 1],
+              static_cast<std::uint32_t>(f));
+  }
+  liveTris = triangleCount;
+  std::vector<std::uint32_t> degree(vertexCount, 0);
+  for (std::uint32_t w : mesh.indices) {
+    degree[w]++;
+  }
+  for (std::size_t v = 0; v < vertexCount; ++v) {
+    vertexTris[v].reserve(degree[v]);
+  }
+
+  // Surface quadrics: each triangle's plane, weighted by its area
+  for (std::uint32_t t = 0; t < triangleCount; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      tris[t][k] = mesh.indices[3 * t + k];
+      vertexTris[tris[t][k]].push_back(t);
+    }
+    Vec3 a = positions[tris[t][0]];
+    Vec3 n = Cross(positions[tris[t][1]] - a, positions[tris[t][2]] - a);
+    double length = Length(n);
+    if (length == 0.0) {
+      continue;
+    }
+    n = n * (1.0 / length);
+    for (int k = 0; k < 3; ++k) {
+      quadrics[tris[t][k]].AddPlane(n, -Dot(n, a), 0.5 * length);
+    }
+  }
+
+  // Undirected edges with the triangles using them; each edge gets one
+  // candidate, and outline/crease edges also get constraint planes
+  std::vector<std::pair<std::uint64_t, std::uint32_t>> edges;
+  edges.reserve(3 * triangleCount);
+  for (std::uint32_t t = 0; t < triangleCount; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      std::uint32_t a = tris[t][k], b = tris[t][(k + 1) % 3];
+      if (a > b) {
+        std::swap(a, b);
+      }
+      edges.emplace_back(static_cast<std::uint64_t>(a) << 32 | b, t);
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+
+  std::vector<Candidate> initial;
+  for (std::size_t i = 0; i < edges.size();) {
+    std::size_t j = i + 1;
+    bool crease = false;
+    while (j < edges.size() && edges[j].first == edges[i].first) {
+      crease = crease || triFaces[edges[j].second] != triFaces[edges[i].second];
+      ++j;
+    }
+    std::uint32_t a = static_cast<std::uint32_t>(edges[i].first >> 32);
+    std::uint32_t b = static_cast<std::uint32_t>(edges[i].first);
+    if (j - i != 2 || crease) {
+      for (std::size_t k = i; k < j; ++k) {
+        AddConstraint(a, b, edges[k].second);
+      }
+    }
+    i = j;
+  }
+  for (std::size_t i = 0; i < edges.size(); ++i) {
+    if (i == 0 || edges[i].first != edges[i - 1].first) {
+      initial.push_back(
+          Evaluate(static_cast<std::uint32_t>(edges[i].first >> 32),
+                   static_cast<std::uint32_t>(edges[i].first)));
+    }
+  }
+  heap = decltype(heap)(std::greater<Candidate>(), std::move(initial));
+}
+
+// Plane through edge (a, b) perpendicular to triangle t: moving either end
+// off the outline or crease costs as much as moving it off a large surface
+void Decimator::AddConstraint(std::uint32_t a, std::uint32_t b,
+                              std::uint32_t t) {
+  Vec3 edge = positions[b] - positions[a];
+  Vec3 p0 = positions[tris[t][0]];
+  Vec3 normal = Cross(positions[tris[t][1]] - p0, positions[tris[t][2]] - p0);
+  Vec3 n = Cross(edge, normal);
+  double length = Length(n);
+  if (length == 0.0) {
+    return;
+  }
+  n = n * (1.0 / length);
+  double w = kFeatureWeight * Dot(edge, edge);
+  quadrics[a].AddPlane(n, -Dot(n, positions[a]), w);
+  quadrics[b].AddPlane(n, -Dot(n, positions[a]), w);
+}
+
+Candidate Decimator::Evaluate(std::uint32_t u, std::uint32_t v) const {
+  Quadric q = quadrics[u];
+  q += quadrics[v];
+  const Vec3 &pu = positions[u];
+  const Vec3 &pv = positions[v];
+  Vec3 mid = (pu + pv) * 0.5;
+
+  // The optimum of an ill-conditioned quadric can lie far off the edge;
+  // fall back to the best of the endpoints and the midpoint
+  Vec3 target;
+  if (!q.Minimum(target) || Length(target - mid) > Length(pu - pv)) {
+    target = pu;
+    for (const Vec3 &p : {pv, mid}) {
+      if (q.Error(p) < q.Error(target)) {
+        target = p;
+      }
+    }
+  }
+  return {std::max(0.0, q.Error(target)), u, v, versions[u], versions[v],
+          target};
+}
+
+bool Decimator::IsValid(const Candidate &c) {
+  const std::uint32_t u = c.u, v = c.v;
+  if (deadVertices[u] || deadVertices[v] || versions[u] != c.versionU ||
+      versions[v] != c.versionV) {
+    return false; // stale
+  }
+
+  // Link condition: the only vertices adjacent to both ends are the
+  // opposite corners of the triangles on the edge. Anything else would
+  // pinch the surface into a non-manifold fin.
+  const std::uint32_t aroundU = NextStamp();
+  std::size_t shared = 0;
+  for (std::uint32_t t : vertexTris[u]) {
+    if (deadTris[t]) {
+      continue;
+    }
+    shared += HasVertex(t, v);
+    for (std::uint32_t w : tris[t]) {
+      marks[w] = aroundU;
+    }
+  }
+  if (shared == 0) {
+    return false;
+  }
+  const std::uint32_t counted = NextStamp();
+  std::size_t common = 0;
+  for (std::uint32_t t : vertexTris[v]) {
+    if (deadTris[t]) {
+      continue;
+    }
+    for (std::uint32_t w : tris[t]) {
+      if (w != u && w != v && marks[w] == aroundU) {
+        marks[w] = counted;
+        ++common;
+      }
+    }
+  }
+  if (common != shared) {
+    return false;
+  }
+
+  // No surrounding triangle may fold over or collapse to a sliver
+  for (std::uint32_t end : {u, v}) {
+    for (std::uint32_t t : vertexTris[end]) {
+      if (deadTris[t] || (HasVertex(t, u) && HasVertex(t, v))) {
+        continue;
+      }
+      const Vec3 &a = positions[tris[t][0]];
+      Vec3 before = Cross(positions[tris[t][1]] - a, positions[tris[t][2]] - a);
+      Vec3 na = Corner(t, 0, u, v, c.target);
+      Vec3 after =
+          Cross(Corner(t, 1, u, v, c.target) - na, Corner(t, 2, u, v, c.target) - na);
+      double scale = Length(before) * Length(after);
+      if (scale == 0.0 || Dot(before, after) < kMinNormalDot * scale) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void Decimator::Collapse(const Candidate &c) {
+  const std::uint32_t u = c.u, v = c.v;
+  positions[u] = c.target;
+  quadrics[u] += quadrics[v];
+  ++versions[u];
+  ++versions[v];
+  deadVertices[v] = 1;
+
+  for (std::uint32_t t : vertexTris[v]) {
+    if (deadTris[t]) {
+      continue;
+    }
+    if (HasVertex(t, u)) {
+      deadTris[t] = 1;
+      --liveTris;
+      continue;
+    }
+    for (std::uint32_t &w : tris[t]) {
+      if (w == v) {
+        w = u;
+      }
+    }
+    vertexTris[u].push_back(t);
+  }
+  vertexTris[v].clear();
+  vertexTris[v].shrink_to_fit();
+
+  std::vector<std::uint32_t> &around = vertexTris[u];
+  around.erase(std::remove_if(around.begin(), around.end(),
+                              [&](std::uint32_t t) { return deadTris[t] != 0; }),
+               around.end());
+
+  // Every edge at u changed cost; older candidates are now stale
+  const std::uint32_t seen = NextStamp();
+  marks[u] = seen;
+  for (std::uint32_t t : around) {
+    for (std::uint32_t w : tris[t]) {
+      if (marks[w] != seen) {
+        marks[w] = seen;
+        heap.push(Evaluate(u, w));
+      }
+    }
+  }
+}
+
+TriMesh Decimator::Reduce(std::size_t budget) {
+  std::size_t collapses = 0;
+  while (liveTris > budget && !heap.empty()) {
+    Candidate c = heap.top();
+    heap.pop();
+    if (!IsValid(c)) {
+      continue;
+    }
+    Collapse(c);
+    if (++collapses % kCollapsesPerPoll == 0) {
+      ThrowIfCancelled("decimation");
+      if (StageDeadlinePassed()) {
+        NoteStageInterrupted();
+        stopped = true;
+        break;
+      }
+    }
+  }
+  return Snapshot();
+}
+
+TriMesh Decimator::Snapshot() const {
+  // Live triangles grouped by face (counting sort keeps their order)
+  std::vector<std::uint32_t> offsets(faceCount + 1, 0);
+  for (std::size_t t = 0; t < tris.size(); ++t) {
+    if (!deadTris[t]) {
+      offsets[triFaces[t] + 1]++;
+    }
+  }
+  for (std::size_t f = 0; f < faceCount; ++f) {
+    offsets[f + 1] += offsets[f];
+  }
+  std::vector<std::uint32_t> order(offsets.back());
+  std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (std::size_t t = 0; t < tris.size(); ++t) {
+    if (!deadTris[t]) {
+      order[fill[triFaces[t]]++] = static_cast<std::uint32_t>(t);
+    }
+  }
+
+  TriMesh out;
+  out.faceTriangles = offsets;
+  out.indices.reserve(3 * order.size());
+  std::vector<std::uint32_t> newIndex(positions.size(), kNone);
+  for (std::uint32_t t : order) {
+    for (std::uint32_t w : tris[t]) {
+      if (newIndex[w] == kNone) {
+        newIndex[w] = static_cast<std::uint32_t>(out.VertexCount());
+        out.positions.insert(out.positions.end(),
+                             {static_cast<float>(positions[w].x),
+                              static_cast<float>(positions[w].y),
+                              static_cast<float>(positions[w].z)});
+      }
+      out.indices.push_back(newIndex[w]);
+    }
+  }
+  return out;
+}
+} // namespace
+
+std::vector<TriMesh> DecimateToBudgets(const TriMesh &welded,
+                                       const std::vector<std::size_t> &budgets) {
+  std::vector<TriMesh> levels;
+  if (budgets.empty()) {
+    return levels;
+  }
+  Decimator decimator(welded);
+  for (std::size_t budget : budgets) {
+    levels.push_back(decimator.Reduce(budget));
+    if (decimator.Stopped()) {
+      break;
+    }
+  }
+  return levels;
+}
@@ -0,0 +1,29 @@
+/*
+    BoltGenerator - Mesh decimation
+    Copyright (C) 2025
+*/
+
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include "trimesh.h"
+
+#include <cstddef>
+#include <vector>
+
+// Simplifies a welded mesh (see WeldVertices()) by quadric-error edge
+// collapse (Garland-Heckbert) and returns one mesh per triangle budget, in
+// the order given. Budgets must be descending: the levels are snapshots of a
+// single collapse sequence, so the whole LOD chain costs one decimation.
+//
+// Open edges and the edges between B-rep faces carry heavily weighted
+// constraint quadrics, so outlines and creases survive. Triangles keep their
+// face, and every level has a faceTriangles mapping over the input faces.
+// A level stops early, above its budget, if no valid collapse is left. Once
+// the active stage deadline has passed (see StageBudget) the level in
+// progress is returned as it is and the finer ones are kept without
+// computing the rest; a cancelled job throws JobCancelled.
+std::vector<TriMesh> DecimateToBudgets(const TriMesh &welded,
+                                       const std::vector<std::size_t> &budgets);
+
+#endif // DECIMATE_H
@@ -18,27 +18,239 @@
 */
 
 #include "export.h"
+#include "budget.h"
+#include "decimate.h"
+#include "glb.h"
+#include "manifest.h"
+#include "mesh.h"
+#include "preflight.h"
+#include "progress.h"
+#include "stl.h"
+#include "tessellate.h"
+#include "weld.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
-#include <BRepBuilderAPI_Sewing.hxx>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <APIHeaderSection_MakeHeader.hxx>
 #include <BRepBuilderAPI_MakeSolid.hxx>
+#include <Interface_HArray1OfHAsciiString.hxx>
+#include <TCollection_HAsciiString.hxx>
 #include <TopoDS.hxx>
 #include <TopExp_Explorer.hxx>
 #include <TopoDS_Shell.hxx>
+#include <STEPCAFControl_Writer.hxx>
+#include <TCollection_ExtendedString.hxx>
+#include <TDataStd_Name.hxx>
+#include <TDF_Label.hxx>
+#include <TDocStd_Document.hxx>
+#include <TopLoc_Location.hxx>
+#include <XCAFApp_Application.hxx>
+#include <XCAFDoc_DocumentTool.hxx>
+#include <XCAFDoc_ShapeTool.hxx>
+
+// Every output is written beside its final path and renamed into place once
+// complete, as the result cache does. A download requested while the file
+// is being written finds no file rather than a partial one, and a failed or
+// cancelled write (the writer throws JobCancelled) leaves nothing behind.
+template <class Write>
+static bool WriteStaged(Standard_CString filename, Write write)
+{
+    const std::string staging = std::string(filename) + ".tmp";
+    bool written;
+    try {
+        written = write(staging.c_str());
+    } catch (...) {
+        std::remove(staging.c_str());
+        throw;
+    }
+    if (written && std::rename(staging.c_str(), filename) == 0)
+        return true;
+    std::remove(staging.c_str());
+    return false;
+}
 
 void ExportBRep(TopoDS_Shape shape, Standard_CString filename)
 {
-    BRepTools::Write(shape, filename);
+    bool written = WriteStaged(filename, [&](Standard_CString staging) {
+        Handle(CancelIndicator) progress = new CancelIndicator();
+        bool done = BRepTools::Write(shape, staging, progress->Start());
+        ThrowIfCancelled("BREP export");
+        return done;
+    });
+    if (!written)
+        std::cerr << "  ⚠ BREP export FAILED: " << filename << std::endl;
+}
+
+void ExportBinBRep(TopoDS_Shape shape, Standard_CString filename)
+{
+    bool written = WriteStaged(filename, [&](Standard_CString staging) {
+        Handle(CancelIndicator) progress = new CancelIndicator();
+        bool done = BinTools::Write(shape, staging, progress->Start());
+        ThrowIfCancelled("binary BREP export");
+        return done;
+    });
+    if (!written)
+        throw std::runtime_error(std::string("Could not write ") + filename);
+}
+
+bool ImportBinBRep(Standard_CString filename, TopoDS_Shape &shape)
+{
+    Handle(CancelIndicator) progress = new CancelIndicator();
+    bool read = BinTools::Read(shape, filename, progress->Start());
+    ThrowIfCancelled("binary BREP import");
+    return read && !shape.IsNull();
+}
+
+// STEP translation opens no stage and may run on a writer thread beside one
+// (see Session::MaterializeStepInBackground()), so only a job cancel stops it.
+static Handle(CancelIndicator) StepProgress()
+{
+    return new CancelIndicator(nullptr, false);
+}
+
+static void SetFileDescription(STEPControl_Writer &writer,
+                               const std::vector<std::string> &lines)
+{
+    if (lines.empty()) {
+        return;
+    }
+    Handle(Interface_HArray1OfHAsciiString) description =
+        new Interface_HArray1OfHAsciiString(1, static_cast<int>(lines.size()));
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+        description->SetValue(static_cast<int>(i) + 1,
+                              new TCollection_HAsciiString(lines[i].c_str()));
+    }
+    APIHeaderSection_MakeHeader header(writer.Model());
+    header.SetDescription(description);
+}
+
+static bool WriteStepFile(STEPControl_Writer &writer, Standard_CString filename)
+{
+    bool written = WriteStaged(filename, [&](Standard_CString staging) {
+        return writer.Write(staging) == IFSelect_RetDone;
+    });
+    if (!written)
+        std::cerr << "  ⚠ STEP export FAILED: " << filename << std::endl;
+    return written;
 }
 
 void ExportSTEP(TopoDS_Shape shape, Standard_CString filename)
 {
     // Geometry is now in millimeters, STEP writer expects mm by default
     STEPControl_Writer writer;
-    writer.Transfer(shape, STEPControl_AsIs);
-    writer.Write(filename);
+    Handle(CancelIndicator) progress = StepProgress();
+    writer.Transfer(shape, STEPControl_AsIs, Standard_True, progress->Start());
+    ThrowIfCancelled("STEP transfer");
+    WriteStepFile(writer, filename);
 }
 
-void ExportSTL(TopoDS_Shape shape, Standard_CString filename)
+std::vector<std::string> CosmeticThreadDescription(const BoltParameters &p,
+                                                   bool internal)
+{
+    // e.g. "cosmetic thread M10x1.5-6g", then one line per diameter (mm)
+    std::vector<std::string> lines;
+    std::ostringstream callout;
+    callout << "cosmetic thread M" << p.thread.majorDiameter << "x"
+            << p.thread.pitch;
+    if (!p.material.toleranceClass.empty()) {
+        callout << "-" << p.material.toleranceClass;
+    }
+    callout << (internal ? " internal" : " external");
+    lines.push_back(callout.str());
+    auto diameter = [&](const char *label, double value) {
+        std::ostringstream line;
+        line << label << " diameter " << value << " mm";
+        lines.push_back(line.str());
+    };
+    diameter("major", p.thread.majorDiameter);
+    diameter("pitch", PitchDiameter(p));
+    diameter("minor", MinorDiameter(p));
+    if (!internal) {
+        std::ostringstream line;
+        line << "thread length " << p.shank.totalLength - ClampedGripLength(p)
+             << " mm";
+        lines.push_back(line.str());
+    }
+    return lines;
+}
+
+void ExportSTEP(TopoDS_Shape shape, const BoltParameters &p, bool internal,
+                Standard_CString filename)
+{
+    STEPControl_Writer writer;
+    Handle(CancelIndicator) progress = StepProgress();
+    writer.Transfer(shape, STEPControl_AsIs, Standard_True, progress->Start());
+    ThrowIfCancelled("STEP transfer");
+    SetFileDescription(writer, CosmeticThreadDescription(p, internal));
+    WriteStepFile(writer, filename);
+}
+
+void ExportAssemblySTEP(const std::vector<AssemblyPart> &parts,
+                        const std::string &name,
+                        const std::vector<std::string> &description,
+                        Standard_CString filename)
+{
+    Handle(TDocStd_Document) document;
+    XCAFApp_Application::GetApplication()->NewDocument("MDTV-XCAF", document);
+    Handle(XCAFDoc_ShapeTool) shapes =
+        XCAFDoc_DocumentTool::ShapeTool(document->Main());
+
+    // Each part becomes one product whose geometry is written once; every
+    // placement is a NEXT_ASSEMBLY_USAGE_OCCURRENCE referencing it
+    TDF_Label assembly = shapes->NewShape();
+    TDataStd_Name::Set(assembly, TCollection_ExtendedString(name.c_str()));
+    for (const AssemblyPart &part : parts) {
+        TDF_Label label = shapes->AddShape(part.shape, Standard_False);
+        TDataStd_Name::Set(label, TCollection_ExtendedString(part.name.c_str()));
+        for (const gp_Trsf &placement : part.placements) {
+            shapes->AddComponent(assembly, label, TopLoc_Location(placement));
+        }
+    }
+    shapes->UpdateAssemblies();
+
+    STEPCAFControl_Writer writer;
+    writer.SetNameMode(Standard_True);
+    Handle(CancelIndicator) progress = StepProgress();
+    bool transferred =
+        writer.Transfer(document, STEPControl_AsIs, nullptr, progress->Start());
+    XCAFApp_Application::GetApplication()->Close(document);
+    ThrowIfCancelled("STEP assembly transfer");
+    if (!transferred) {
+        throw std::runtime_error("STEP assembly transfer failed");
+    }
+    SetFileDescription(writer.ChangeWriter(), description);
+    bool written = WriteStaged(filename, [&](Standard_CString staging) {
+        return writer.Write(staging) == IFSelect_RetDone;
+    });
+    if (!written)
+        throw std::runtime_error(std::string("Could not write ") + filename);
+}
+
+// Viewer size (device pixels) the preview meshes are tuned for; 0 keeps
+// them at download quality
+static int previewScreenPixels = 0;
+
+// Chordal error allowed in a preview, in pixels of the viewer with the part
+// filling it
+static const double kPreviewPixelError = 0.5;
+
+void SetPreviewScreenSize(int pixels)
+{
+    previewScreenPixels = std::max(0, pixels);
+}
+
+// Mesh quality for the shape at download quality, or at the screen-space
+// preview quality if one is set; false if there is nothing to mesh.
+static bool QualityForSTL(const TopoDS_Shape &shape, bool preview,
+                          MeshQuality &quality)
 {
     // EXACT FreeCAD MeshPart implementation
     // Source: MeshPart/App/Mesher.cpp line 222-226 (createStandard method)
@@ -55,7 +267,7 @@ void ExportSTL(TopoDS_Shape shape, Standard_CString filename)
     
     if (bbox.IsVoid()) {
         std::cerr << "Error: Cannot calculate bounding box" << std::endl;
-        return;
+        return false;
     }
     
     Standard_Real xMin, yMin, zMin, xMax, yMax, zMax;
@@ -79,6 +291,21 @@ void ExportSTL(TopoDS_Shape shape, Standard_CString filename)
 
         // Compute absolute deflection from bounding box when running in relative mode
         Standard_Real deflection = relative ? (diagLength * relativeFactor) : 0.05;
+
+    // A preview only has to be right to within a fraction of a pixel
+    if (preview && previewScreenPixels > 0) {
+        relative = Standard_False;
+        deflection = kPreviewPixelError * diagLength / previewScreenPixels;
+    }
+
+    // Behind schedule: trade mesh density for latency rather than overrun
+    if (!BudgetAllows(kMeshBudgetShare)) {
+        deflection *= 4.0;
+        angularDeflection *= 2.0;
+        std::cout << "Job over budget, coarsening mesh" << std::endl;
+        ManifestAddEntry("degradations", "mesh",
+                         "deflection coarsened 4x, angular deflection 2x; job over budget");
+    }
     
     // Diagnostic output (FreeCAD style)
     std::cout << "\n=== FreeCAD MeshPart STL Export ===" << std::endl;
@@ -86,22 +313,26 @@ void ExportSTL(TopoDS_Shape shape, Standard_CString filename)
         std::cout << "Linear deflection: " << deflection << " mm" << std::endl;
         std::cout << "Angular deflection: " << angularDeflection << " rad" << std::endl;
         std::cout << "Relative mode: " << (relative ? "YES (factor=" + std::to_string(relativeFactor) + ")" : "NO (absolute)") << std::endl;
-    
-    // Repair shape to ensure closed for proper STL export
-    if (!shape.IsNull()) {
-        try {
-            double repairTol = 1e-4;
-            BRepBuilderAPI_Sewing sewer(repairTol);
-            sewer.Add(shape);
-            sewer.Perform();
-            TopoDS_Shape sewed = sewer.SewedShape();
-            
-            shape = sewed;
-        } catch(...) {
-            std::cout << "Shape repair failed, proceeding with original" << std::endl;
-        }
-    }
-    
+
+    // Faces are budgeted by feature class: thread flanks get the full
+    // budget, planes and fillets far less
+    quality = {deflection, angularDeflection, relative == Standard_True, true};
+    return true;
+}
+
+// Meshes the shape at download quality, or at the screen-space preview
+// quality if one is set; returns a null shape if there is nothing to mesh.
+static TopoDS_Shape MeshForSTL(TopoDS_Shape shape, bool preview = false)
+{
+    MeshQuality quality;
+    if (!QualityForSTL(shape, preview, quality))
+        return TopoDS_Shape();
+
+    // Sewing and meshing happen once per (shape, quality); later exports of
+    // the same solid reuse the cached triangulation
+    std::cout << "\nGenerating mesh (exact FreeCAD MeshPart code)..." << std::endl;
+    shape = MeshedShape(shape, quality);
+
     if (!shape.IsNull()) {
         std::cout << "\nShape validation:" << std::endl;
         std::cout << "  Type: ";
@@ -120,33 +351,380 @@ void ExportSTL(TopoDS_Shape shape, Standard_CString filename)
         }
         std::cout << "  Closed: " << (shape.Closed() ? "YES ✓" : "NO ⚠") << std::endl;
     }
-    
-    // EXACT FreeCAD MeshPart meshing code
-    // From: MeshPart/App/Mesher.cpp line 222-225
-    std::cout << "\nGenerating mesh (exact FreeCAD MeshPart code)..." << std::endl;
-    
-    if (!shape.IsNull()) {
-        BRepTools::Clean(shape);  // FreeCAD does this before meshing
-        BRepMesh_IncrementalMesh aMesh(shape, deflection, relative, angularDeflection);
-        
-        if (!aMesh.IsDone()) {
-            std::cerr << "  ⚠ Warning: Mesh generation incomplete" << std::endl;
-        } else {
-            std::cout << "  ✓ Mesh generation: SUCCESS" << std::endl;
-        }
+    return shape;
+}
+
+// Positions closer than this are the same node (mm). Shared edges are
+// discretized once, so coincident nodes normally match to float precision;
+// the slack covers sewn edges whose vertices carry a tolerance.
+static const float kWeldTolerance = 1e-3f;
+
+// Records whether a welded mesh is watertight, along with its volume,
+// against the output it was written to.
+static void RecordMeshQA(const TriMesh &mesh, const std::string &output)
+{
+    std::size_t openEdges = OpenEdgeCount(mesh);
+    double volume = SignedVolume(mesh);
+
+    std::cout << "  Mesh QA: " << mesh.VertexCount() << " vertices, "
+              << openEdges << " open edges, volume " << volume << " mm^3"
+              << std::endl;
+    ManifestAddRecord("meshes", {
+        {"output", ManifestString(output)},
+        {"vertices", ManifestNumber(static_cast<double>(mesh.VertexCount()))},
+        {"triangles", ManifestNumber(static_cast<double>(mesh.TriangleCount()))},
+        {"openEdges", ManifestNumber(static_cast<double>(openEdges))},
+        {"volume", ManifestNumber(volume)}});
+}
+
+// Welds the triangulation into a shared-vertex mesh first
+static void RecordMeshQA(const TopoDS_Shape &meshed, const std::string &output)
+{
+    TriMesh mesh = ExtractTriMesh(meshed);
+    WeldStats weld = WeldVertices(mesh, kWeldTolerance);
+    std::cout << "  Welded " << weld.merged << " vertices" << std::endl;
+    RecordMeshQA(mesh, output);
+}
+
+void ExportSTL(TopoDS_Shape shape, Standard_CString filename)
+{
+    shape = MeshForSTL(shape);
+    if (shape.IsNull())
+        return;
+
+    // Export to binary STL (FreeCAD default), written in parallel straight
+    // from the face triangulations into a memory-mapped file
+    std::cout << "\nExporting binary STL..." << std::endl;
+    bool success = WriteStaged(filename, [&](Standard_CString staging) {
+        return WriteBinarySTL(shape, staging);
+    });
+
+    if (success) {
+        std::cout << "  ✓ STL export: SUCCESS" << std::endl;
+        RecordMeshQA(shape, filename);
+    } else {
+        std::cerr << "  ⚠ STL export FAILED" << std::endl;
     }
-    
-    // Export to binary STL (FreeCAD default)
+    std::cout << "===================================\n" << std::endl;
+}
+
+void ExportSTL(TopoDS_Shape shape, const PeriodicLayout &layout,
+               Standard_CString filename)
+{
+    MeshQuality quality;
+    if (!QualityForSTL(shape, false, quality))
+        return;
+
+    // Seam vertices of neighbouring copies sit on the same cut edge, but
+    // each side discretized it on its own; they agree to the deflection
+    std::cout << "\nGenerating periodic mesh..." << std::endl;
+    TriMesh mesh = PeriodicTriMesh(shape, quality, layout, kWeldTolerance,
+                                   static_cast<float>(2.0 * quality.deflection));
+    if (mesh.TriangleCount() == 0) {
+        std::cout << "  Periodic mesh unavailable, meshing the whole part"
+                  << std::endl;
+        ManifestAddEntry("fallbacks", "periodic mesh",
+                         "split into cells failed; meshed the whole part");
+        ExportSTL(shape, filename);
+        return;
+    }
+
     std::cout << "\nExporting binary STL..." << std::endl;
-    StlAPI_Writer writer;
-    writer.ASCIIMode() = Standard_False;  // Binary mode for compact files
-    
-    Standard_Boolean success = writer.Write(shape, filename);
-    
+    bool success = WriteStaged(filename, [&](Standard_CString staging) {
+        return WriteBinarySTL(mesh, staging);
+    });
     if (success) {
         std::cout << "  ✓ STL export: SUCCESS" << std::endl;
+        RecordMeshQA(mesh, filename);
     } else {
         std::cerr << "  ⚠ STL export FAILED" << std::endl;
     }
     std::cout << "===================================\n" << std::endl;
 }
+
+void StreamSTL(TopoDS_Shape shape, int fd)
+{
+    shape = MeshForSTL(shape);
+    if (shape.IsNull())
+        throw std::runtime_error("Nothing to stream: empty shape");
+
+    std::cout << "\nStreaming binary STL..." << std::endl;
+    if (!StreamBinarySTL(shape, fd))
+        throw std::runtime_error("STL stream write failed");
+    std::cout << "  ✓ STL stream: SUCCESS" << std::endl;
+    RecordMeshQA(shape, "stdout");
+}
+
+// Triangle budgets of the preview LOD chain, finest first. Meshes up to
+// kPreviewTriangleLimit are light enough for the browser as they are.
+static const std::size_t kPreviewLodBudgets[] = {500000, 100000, 20000};
+static const std::size_t kPreviewTriangleLimit = 200000;
+
+struct PreviewLevels
+{
+    TopoDS_Shape meshed;
+    TriMesh full;
+    std::vector<TriMesh> lods; // finest first
+};
+
+// Bolt, nut and washer are previewed in turn, so a few solids are kept,
+// most recently used first
+static const std::size_t kMaxCachedPreviews = 4;
+static std::list<std::shared_ptr<const PreviewLevels>> previewCache;
+static std::mutex previewCacheMutex;
+
+// The streamed preview and the GLB files of one solid share a single
+// extraction and decimation pass
+static std::shared_ptr<const PreviewLevels> PreviewFor(const TopoDS_Shape &meshed)
+{
+    {
+        std::lock_guard<std::mutex> lock(previewCacheMutex);
+        for (auto it = previewCache.begin(); it != previewCache.end(); ++it) {
+            if ((*it)->meshed.IsSame(meshed)) {
+                previewCache.splice(previewCache.begin(), previewCache, it);
+                return previewCache.front();
+            }
+        }
+    }
+
+    auto levels = std::make_shared<PreviewLevels>();
+    levels->meshed = meshed;
+    levels->full = ExtractTriMesh(meshed);
+    std::size_t triangles = levels->full.TriangleCount();
+    if (triangles > kPreviewTriangleLimit) {
+        std::vector<std::size_t> budgets;
+        for (std::size_t budget : kPreviewLodBudgets) {
+            if (budget < triangles)
+                budgets.push_back(budget);
+        }
+        TriMesh welded = levels->full;
+        WeldVertices(welded, kWeldTolerance);
+        StageBudget stage(kMeshBudgetShare);
+        for (const TriMesh &lod : DecimateToBudgets(welded, budgets))
+            levels->lods.push_back(SplitFaces(lod));
+        ThrowIfCancelled("preview decimation");
+        if (stage.Interrupted()) {
+            std::cout << "Preview: decimation over budget, keeping "
+                      << levels->lods.size() << " levels" << std::endl;
+            ManifestAddEntry("degradations", "preview",
+                             "decimation exceeded its time budget; LOD chain cut short");
+        }
+        std::cout << "Preview: " << triangles << " triangles decimated into "
+                  << levels->lods.size() << " levels" << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(previewCacheMutex);
+    previewCache.push_front(levels);
+    if (previewCache.size() > kMaxCachedPreviews)
+        previewCache.pop_back();
+    return levels;
+}
+
+static bool WriteGLB(const TriMesh &mesh, const std::string &filename)
+{
+    std::vector<unsigned char> glb = EncodeGLB(mesh);
+    bool written = WriteStaged(filename.c_str(), [&](Standard_CString staging) {
+        std::ofstream out(staging, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(glb.data()), glb.size());
+        out.close();
+        return !out.fail();
+    });
+    if (!written) {
+        std::cerr << "  ⚠ GLB export FAILED: " << filename << std::endl;
+        return false;
+    }
+    std::cout << "  ✓ GLB export: " << filename << " (" << glb.size()
+              << " bytes)" << std::endl;
+    return true;
+}
+
+void ExportGLB(TopoDS_Shape shape, Standard_CString filename)
+{
+    // Same (cached) triangulation as the STL outputs unless a preview
+    // screen size is set
+    shape = MeshForSTL(shape, true);
+    if (shape.IsNull())
+        return;
+
+    std::shared_ptr<const PreviewLevels> levels = PreviewFor(shape);
+    WriteGLB(levels->full, filename);
+
+    std::string base(filename);
+    if (base.size() > 4 && base.compare(base.size() - 4, 4, ".glb") == 0)
+        base.resize(base.size() - 4);
+    for (std::size_t k = 0; k < levels->lods.size(); ++k) {
+        std::string path = base + "_lod" + std::to_string(k) + ".glb";
+        if (!WriteGLB(levels->lods[k], path))
+            continue;
+        ManifestAddRecord("lods", {
+            {"source", ManifestString(filename)},
+            {"output", ManifestString(path)},
+            {"triangles", ManifestNumber(static_cast<double>(levels->lods[k].TriangleCount()))}});
+    }
+}
+
+void ExportAssemblyGLB(const std::vector<AssemblyPart> &parts,
+                       Standard_CString filename)
+{
+    // Every instance is drawn, so each part gets the finest level within
+    // the preview triangle budget rather than its full mesh
+    std::vector<TriMesh> meshes;
+    std::vector<GlbInstance> instances;
+    for (const AssemblyPart &part : parts) {
+        TopoDS_Shape meshed = MeshForSTL(part.shape, true);
+        if (meshed.IsNull())
+            continue;
+        std::shared_ptr<const PreviewLevels> levels = PreviewFor(meshed);
+        const TriMesh *mesh = &levels->full;
+        for (const TriMesh &lod : levels->lods) {
+            mesh = &lod;
+            if (lod.TriangleCount() <= kPreviewTriangleLimit)
+                break;
+        }
+        meshes.push_back(*mesh);
+        for (const gp_Trsf &placement : part.placements) {
+            GlbInstance instance = {meshes.size() - 1, {}};
+            for (int column = 0; column < 4; ++column) {
+                for (int row = 0; row < 3; ++row)
+                    instance.matrix[4 * column + row] =
+                        static_cast<float>(placement.Value(row + 1, column + 1));
+            }
+            instance.matrix[15] = 1.0f;
+            instances.push_back(instance);
+        }
+    }
+
+    std::vector<unsigned char> glb = EncodeGLBScene(meshes, instances);
+    bool written = WriteStaged(filename, [&](Standard_CString staging) {
+        std::ofstream out(staging, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(glb.data()), glb.size());
+        out.close();
+        return !out.fail();
+    });
+    if (!written)
+        throw std::runtime_error(std::string("Could not write ") + filename);
+    std::cout << "  ✓ GLB assembly: " << filename << " (" << meshes.size()
+              << " meshes, " << instances.size() << " instances, "
+              << glb.size() << " bytes)" << std::endl;
+}
+
+void StreamGLB(TopoDS_Shape shape, int fd)
+{
+    shape = MeshForSTL(shape, true);
+    if (shape.IsNull())
+        throw std::runtime_error("Nothing to stream: empty shape");
+
+    // Coarsest level first; the client refines from the GLB files
+    std::shared_ptr<const PreviewLevels> levels = PreviewFor(shape);
+    const TriMesh &first = levels->lods.empty() ? levels->full : levels->lods.back();
+    std::vector<unsigned char> glb = EncodeGLB(first);
+    if (!WriteFully(fd, glb.data(), glb.size()))
+        throw std::runtime_error("GLB stream write failed");
+    std::cout << "  ✓ GLB stream: " << first.TriangleCount() << " triangles, "
+              << glb.size() << " bytes" << std::endl;
+}
+
+// Deflection of the analytic previews for a part with this bounding box
+// diagonal, following MeshForSTL(): 0.1% of the diagonal, or the screen-space
+// error when a viewer size is set
+static double AnalyticDeflection(double diagLength)
+{
+    if (previewScreenPixels > 0)
+        return kPreviewPixelError * diagLength / previewScreenPixels;
+    return 0.001 * diagLength;
+}
+
+// Bounding box diagonal of a part this tall with a hex or round outline
+static double PartDiagonal(double height, double width)
+{
+    return std::sqrt(height * height + 2.0 * width * width);
+}
+
+static double BoltPreviewDeflection(const BoltParameters &p)
+{
+    const double s = p.head.widthAcrossFlats;
+    const bool roundHead = (p.head.type == HeadType::SOCKET_CAP ||
+                            p.head.type == HeadType::FLAT ||
+                            p.head.type == HeadType::COUNTERSUNK);
+    const double width = roundHead ? s : 2.0 * s / std::sqrt(3.0);
+    return AnalyticDeflection(
+        PartDiagonal(p.shank.totalLength + p.head.height, width));
+}
+
+static double NutPreviewDeflection(const BoltParameters &p)
+{
+    const double width = 2.0 * p.nut.widthAcrossFlats / std::sqrt(3.0);
+    return AnalyticDeflection(PartDiagonal(p.nut.height, width));
+}
+
+TriMesh AnalyticBoltPreview(const BoltParameters &p)
+{
+    TriMesh mesh = TessellateBolt(p, BoltPreviewDeflection(p));
+    std::cout << "Analytic preview: bolt, " << mesh.TriangleCount()
+              << " triangles" << std::endl;
+    return mesh;
+}
+
+TriMesh AnalyticNutPreview(const BoltParameters &p)
+{
+    TriMesh mesh = TessellateNut(p, NutPreviewDeflection(p));
+    std::cout << "Analytic preview: nut, " << mesh.TriangleCount()
+              << " triangles" << std::endl;
+    return mesh;
+}
+
+TriMesh MeshCsgBoltPreview(const BoltParameters &p)
+{
+    TriMesh mesh = MeshCsgBolt(p, BoltPreviewDeflection(p));
+    if (mesh.TriangleCount() == 0) {
+        std::cerr << "Mesh CSG preview: bolt booleans failed, tessellating directly"
+                  << std::endl;
+        ManifestAddEntry("fallbacks", "mesh CSG",
+                         "bolt preview booleans failed; tessellated directly");
+        return AnalyticBoltPreview(p);
+    }
+    std::cout << "Mesh CSG preview: bolt, " << mesh.TriangleCount()
+              << " triangles" << std::endl;
+    return mesh;
+}
+
+TriMesh MeshCsgNutPreview(const BoltParameters &p)
+{
+    TriMesh mesh = MeshCsgNut(p, NutPreviewDeflection(p));
+    if (mesh.TriangleCount() == 0) {
+        std::cerr << "Mesh CSG preview: nut booleans failed, tessellating directly"
+                  << std::endl;
+        ManifestAddEntry("fallbacks", "mesh CSG",
+                         "nut preview booleans failed; tessellated directly");
+        return AnalyticNutPreview(p);
+    }
+    std::cout << "Mesh CSG preview: nut, " << mesh.TriangleCount()
+              << " triangles" << std::endl;
+    return mesh;
+}
+
+void ExportGLB(const TriMesh &mesh, Standard_CString filename)
+{
+    // Faces get their own vertices back so the creases shade sharp
+    if (WriteGLB(SplitFaces(mesh), filename))
+        RecordMeshQA(mesh, filename);
+}
+
+void StreamGLB(const TriMesh &mesh, int fd)
+{
+    std::vector<unsigned char> glb = EncodeGLB(SplitFaces(mesh));
+    if (!WriteFully(fd, glb.data(), glb.size()))
+        throw std::runtime_error("GLB stream write failed");
+    std::cout << "  ✓ GLB stream: " << mesh.TriangleCount() << " triangles, "
+              << glb.size() << " bytes" << std::endl;
+    RecordMeshQA(mesh, "stdout");
+}
+
+void StreamSTL(const TriMesh &mesh, int fd)
+{
+    if (!StreamBinarySTL(mesh, fd))
+        throw std::runtime_error("STL stream write failed");
+    std::cout << "  ✓ STL stream: " << mesh.TriangleCount() << " triangles"
+              << std::endl;
+    RecordMeshQA(mesh, "stdout");
+}
@@ -23,6 +23,7 @@
 // OpenCASCADE includes for CAD operations
 #include <TopoDS_Shape.hxx>
 #include <BRepTools.hxx>
+#include <BinTools.hxx>
 #include <STEPControl_Writer.hxx>
 #include <BRepBuilderAPI_Transform.hxx>
 #include <gp_Trsf.hxx>
@@ -39,14 +40,113 @@
 
 // Math for adaptive mesh
 #include <cmath>
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+#include "parameters.h"
+#include "trimesh.h"
 
 void ExportBRep(TopoDS_Shape shape,
                 Standard_CString filename);
 
+// Binary B-rep (BinTools): several times smaller than the ASCII format
+// for the helical BSplines, and much faster to write and read back. Throws
+// if the file could not be written, so the result cache never keeps one.
+void ExportBinBRep(TopoDS_Shape shape,
+                   Standard_CString filename);
+
+// Reads a file written by ExportBinBRep(); false if it is missing or
+// unreadable
+bool ImportBinBRep(Standard_CString filename,
+                   TopoDS_Shape &shape);
+
+void ExportSTEP(TopoDS_Shape shape,
+                Standard_CString filename);
+
+// Same file for a part with a cosmetic thread: the thread designation and
+// its diameters go into the FILE_DESCRIPTION of the header. `internal` is
+// set for the nut.
 void ExportSTEP(TopoDS_Shape shape,
+                const BoltParameters &p,
+                bool internal,
                 Standard_CString filename);
 
+// Lines for ExportSTEP() below: the thread designation and its diameters
+std::vector<std::string> CosmeticThreadDescription(const BoltParameters &p,
+                                                   bool internal);
+
+// One part of an assembly, placed once per entry of `placements`
+struct AssemblyPart {
+    std::string name;
+    TopoDS_Shape shape;
+    std::vector<gp_Trsf> placements;
+};
+
+// STEP assembly through XCAF: every part is written once, as its own
+// product, and each instance only references it with a placement, so the
+// file (and the translation time) grows with the distinct parts rather than
+// the instances. `description` goes into the FILE_DESCRIPTION of the header.
+void ExportAssemblySTEP(const std::vector<AssemblyPart> &parts,
+                        const std::string &name,
+                        const std::vector<std::string> &description,
+                        Standard_CString filename);
+
+void ExportSTL(TopoDS_Shape shape,
+               Standard_CString filename);
+
+// Same file for a part that repeats (see PeriodicTriMesh()): one thread
+// pitch and one head sector are meshed and instanced, the seams stitched.
+// Falls back to meshing the whole part if it cannot be split into cells.
 void ExportSTL(TopoDS_Shape shape,
+               const PeriodicLayout &layout,
                Standard_CString filename);
 
+// Writes the same binary STL as ExportSTL() to an open file descriptor
+// (e.g. stdout) without a temporary file.
+void StreamSTL(TopoDS_Shape shape,
+               int fd);
+
+// Compact preview mesh: indexed, quantized glTF binary (see glb.h). Meshes
+// too heavy for the browser also get decimated levels next to the file,
+// <name>_lod<k>.glb (finest first), listed in the manifest under "lods".
+void ExportGLB(TopoDS_Shape shape,
+               Standard_CString filename);
+
+// Assembly preview: each part meshed once and drawn at every placement by
+// its own glTF node (see EncodeGLBScene())
+void ExportAssemblyGLB(const std::vector<AssemblyPart> &parts,
+                       Standard_CString filename);
+
+// Streams the coarsest preview level, so the first frame arrives quickly.
+void StreamGLB(TopoDS_Shape shape,
+               int fd);
+
+// Meshes the GLB previews for a viewer this many device pixels across
+// (screen-space error target); 0 meshes them like the STL downloads.
+void SetPreviewScreenSize(int pixels);
+
+// Preview meshes tessellated straight from the parameters (see tessellate.h)
+// at the same quality target as the B-rep previews. No B-rep is built or
+// meshed, so they are ready in milliseconds; downloads still come from the
+// kernel.
+TriMesh AnalyticBoltPreview(const BoltParameters &p);
+TriMesh AnalyticNutPreview(const BoltParameters &p);
+
+// Same previews combined from meshed primitives by mesh booleans (see
+// MeshCsgBolt()). If a boolean fails they are tessellated directly, and the
+// manifest records the fallback.
+TriMesh MeshCsgBoltPreview(const BoltParameters &p);
+TriMesh MeshCsgNutPreview(const BoltParameters &p);
+
+// ExportGLB() and the streams for an already tessellated preview mesh
+void ExportGLB(const TriMesh &mesh,
+               Standard_CString filename);
+
+void StreamGLB(const TriMesh &mesh,
+               int fd);
+
+void StreamSTL(const TriMesh &mesh,
+               int fd);
+
 #endif // EXPORT_H
@@ -0,0 +1,99 @@
+#include "fillet.h"
+#include "budget.h"
+#include "manifest.h"
+#include "progress.h"
+
+#include <BRepCheck_Analyzer.hxx>
+#include <BRepFilletAPI_MakeFillet.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+
+#include <iostream>
+#include <sstream>
+
+namespace {
+// Each rung retries with the radius scaled by this factor
+constexpr double kRetryScale = 0.5;
+
+bool TryFillet(const TopoDS_Solid &solid, double radius,
+               const FilletSelector &select, const char *stage,
+               TopoDS_Solid &result, int &edgesAdded) {
+  BRepFilletAPI_MakeFillet fillet(solid);
+  edgesAdded = 0;
+  for (TopExp_Explorer ex(solid, TopAbs_EDGE); ex.More(); ex.Next()) {
+    TopoDS_Edge edge = TopoDS::Edge(ex.Current());
+    if (select(edge, radius)) {
+      fillet.Add(radius, edge);
+      edgesAdded++;
+    }
+  }
+  if (edgesAdded == 0) {
+    return false;
+  }
+
+  Handle(CancelIndicator) progress = new CancelIndicator();
+  fillet.Build(progress->Start());
+  ThrowIfCancelled(stage);
+  if (!fillet.IsDone()) {
+    return false;
+  }
+
+  // A "successful" fillet can still leave self-intersecting faces behind
+  TopExp_Explorer solids(fillet.Shape(), TopAbs_SOLID);
+  if (!solids.More() || !BRepCheck_Analyzer(solids.Current()).IsValid()) {
+    return false;
+  }
+  result = TopoDS::Solid(solids.Current());
+  return true;
+}
+} // namespace
+
+TopoDS_Solid Fillet(const char *stage, const TopoDS_Solid &solid,
+                    double radius, const FilletSelector &select) {
+  double r = radius;
+  for (int attempt = 0; attempt < 2; ++attempt, r *= kRetryScale) {
+    TopoDS_Solid result;
+    int edgesAdded = 0;
+    bool done = false;
+    std::string reason;
+    try {
+      done = TryFillet(solid, r, select, stage, result, edgesAdded);
+    } catch (const JobCancelled &) {
+      throw;
+    } catch (const std::exception &e) {
+      reason = e.what();
+    } catch (...) {
+      reason = "unknown error";
+    }
+
+    if (done) {
+      std::cout << "Fillet: " << stage << " radius " << r << " applied to "
+                << edgesAdded << " edges" << std::endl;
+      return result;
+    }
+    if (edgesAdded == 0 && reason.empty()) {
+      std::cout << "Fillet: " << stage << " has no suitable edges, skipping"
+                << std::endl;
+      return solid;
+    }
+    if (StageDeadlinePassed()) {
+      std::cerr << "Fillet: " << stage << " over budget, keeping original "
+                << "geometry" << std::endl;
+      ManifestAddEntry("degradations", stage,
+                       "fillet exceeded its time budget; skipped");
+      return solid;
+    }
+
+    std::ostringstream detail;
+    detail << "radius " << r << " failed"
+           << (reason.empty() ? "" : " (" + reason + ")");
+    if (attempt == 0) {
+      detail << "; retrying at " << r * kRetryScale;
+    } else {
+      detail << "; fillet skipped";
+    }
+    std::cerr << "Fillet: " << stage << " " << detail.str() << std::endl;
+    ManifestAddEntry("fallbacks", stage, detail.str());
+  }
+  return solid;
+}
@@ -0,0 +1,26 @@
+/*
+    BoltGenerator - Edge fillets with fallback
+    Copyright (C) 2025
+*/
+
+#ifndef FILLET_H
+#define FILLET_H
+
+#include <TopoDS_Edge.hxx>
+#include <TopoDS_Solid.hxx>
+
+#include <functional>
+
+// Returns true if `edge` should be rounded at `radius`.
+using FilletSelector =
+    std::function<bool(const TopoDS_Edge &edge, double radius)>;
+
+// Fillets the selected edges of `solid`. A fillet that fails or produces an
+// invalid solid is retried once at half the radius and then skipped, so the
+// caller always gets a usable part back. Every rung taken is recorded in the
+// manifest under "fallbacks" (or "degradations" when the stage ran out of
+// time) with `stage` as its name.
+TopoDS_Solid Fillet(const char *stage, const TopoDS_Solid &solid,
+                    double radius, const FilletSelector &select);
+
+#endif // FILLET_H
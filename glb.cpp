@@ -0,0 +1,435 @@
+#include "glb.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+namespace {
+// Post-transform cache size Tipsify optimizes for
+constexpr int kCacheSize = 16;
+
+// glTF constants
+constexpr int kByte = 5120;
+constexpr int kShort = 5122;
+constexpr int kUnsignedShort = 5123;
+constexpr int kUnsignedInt = 5125;
+constexpr int kArrayBuffer = 34962;
+constexpr int kElementArrayBuffer = 34963;
+
+struct QuantizedVertex {
+  std::int16_t position[4]; // w is padding for 4-byte alignment
+  std::int8_t normal[4];
+
+  bool operator==(const QuantizedVertex &o) const {
+    return std::memcmp(this, &o, sizeof(*this)) == 0;
+  }
+};
+
+struct VertexHash {
+  std::size_t operator()(const QuantizedVertex &v) const {
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, v.position, sizeof(bits));
+    std::uint32_t normal = 0;
+    std::memcpy(&normal, v.normal, sizeof(normal));
+    return std::hash<std::uint64_t>()(bits * 0x9E3779B97F4A7C15ull ^ normal);
+  }
+};
+
+std::int16_t QuantizeUnit16(float v) {
+  return static_cast<std::int16_t>(
+      std::lround(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f));
+}
+
+std::int8_t QuantizeUnit8(float v) {
+  return static_cast<std::int8_t>(
+      std::lround(std::max(-1.0f, std::min(1.0f, v)) * 127.0f));
+}
+
+// Tipsify (Sander, Nehab, Barczak 2007): fans around the most recently
+// emitted vertex that is still in the cache, jumping to a dead-end vertex
+// or the next live vertex when the fan is exhausted. Linear time.
+std::vector<std::uint32_t> Tipsify(const std::vector<std::uint32_t> &indices,
+                                   std::size_t vertexCount) {
+  const std::size_t triangleCount = indices.size() / 3;
+
+  // Vertex -> triangles adjacency (CSR)
+  std::vector<std::uint32_t> offsets(vertexCount + 1, 0);
+  for (std::uint32_t v : indices) {
+    offsets[v + 1]++;
+  }
+  for (std::size_t v = 0; v < vertexCount; ++v) {
+    offsets[v + 1] += offsets[v];
+  }
+  std::vector<std::uint32_t> adjacency(indices.size());
+  std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (std::size_t t = 0; t < triangleCount; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      adjacency[fill[indices[3 * t + k]]++] = static_cast<std::uint32_t>(t);
+    }
+  }
+
+  std::vector<int> live(vertexCount);
+  for (std::size_t v = 0; v < vertexCount; ++v) {
+    live[v] = static_cast<int>(offsets[v + 1] - offsets[v]);
+  }
+  std::vector<long> cacheTime(vertexCount, 0);
+  std::vector<char> emitted(triangleCount, 0);
+  std::vector<std::uint32_t> deadEnds;
+  std::vector<std::uint32_t> candidates;
+  std::vector<std::uint32_t> out;
+  out.reserve(indices.size());
+
+  long time = kCacheSize + 1;
+  std::size_t cursor = 0;
+  long fan = vertexCount > 0 ? 0 : -1;
+  while (fan >= 0) {
+    candidates.clear();
+    for (std::uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+      std::uint32_t t = adjacency[a];
+      if (emitted[t]) {
+        continue;
+      }
+      for (int k = 0; k < 3; ++k) {
+        std::uint32_t v = indices[3 * t + k];
+        out.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - cacheTime[v] > kCacheSize) {
+          cacheTime[v] = time++;
+        }
+      }
+      emitted[t] = 1;
+    }
+
+    // Next fan: the candidate that stays in cache longest after its
+    // remaining triangles are emitted
+    long best = -1, bestPriority = -1;
+    for (std::uint32_t v : candidates) {
+      if (live[v] <= 0) {
+        continue;
+      }
+      long priority = 0;
+      if (time - cacheTime[v] + 2 * live[v] <= kCacheSize) {
+        priority = time - cacheTime[v];
+      }
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        best = v;
+      }
+    }
+    if (best < 0) {
+      while (!deadEnds.empty() && best < 0) {
+        std::uint32_t v = deadEnds.back();
+        deadEnds.pop_back();
+        if (live[v] > 0) {
+          best = v;
+        }
+      }
+      while (best < 0 && cursor < vertexCount) {
+        if (live[cursor] > 0) {
+          best = static_cast<long>(cursor);
+        }
+        ++cursor;
+      }
+    }
+    fan = best;
+  }
+  return out;
+}
+
+void Append(std::vector<unsigned char> &bin, const void *data,
+            std::size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  bin.insert(bin.end(), bytes, bytes + size);
+}
+
+void Pad(std::vector<unsigned char> &bytes, unsigned char value) {
+  while (bytes.size() % 4 != 0) {
+    bytes.push_back(value);
+  }
+}
+
+void AppendU32(std::vector<unsigned char> &out, std::uint32_t value) {
+  Append(out, &value, sizeof(value)); // GLB is little-endian
+}
+
+// One mesh in the binary chunk, with what its accessors and node need
+struct Primitive {
+  float center[3];
+  float scale;
+  bool hasNormals;
+  bool shortIndices;
+  std::size_t vertexCount;
+  std::size_t indexCount;
+  std::int16_t qmin[3];
+  std::int16_t qmax[3];
+  std::size_t positionOffset, positionLength;
+  std::size_t normalOffset, normalLength;
+  std::size_t indexOffset, indexLength;
+};
+
+// Quantizes and orders `mesh` (see EncodeGLB()) and appends its positions,
+// normals and indices to `bin`, leaving it 4-byte aligned
+Primitive AppendPrimitive(std::vector<unsigned char> &bin,
+                          const TriMesh &mesh) {
+  Primitive primitive = {};
+  const std::size_t sourceVertices = mesh.VertexCount();
+
+  // Uniform scale keeps normals valid under the dequantizing node transform
+  float lo[3] = {std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max()};
+  float hi[3] = {std::numeric_limits<float>::lowest(),
+                 std::numeric_limits<float>::lowest(),
+                 std::numeric_limits<float>::lowest()};
+  for (std::size_t v = 0; v < sourceVertices; ++v) {
+    for (int k = 0; k < 3; ++k) {
+      lo[k] = std::min(lo[k], mesh.positions[3 * v + k]);
+      hi[k] = std::max(hi[k], mesh.positions[3 * v + k]);
+    }
+  }
+  float *center = primitive.center;
+  float scale = 0.0f;
+  if (sourceVertices > 0) {
+    for (int k = 0; k < 3; ++k) {
+      center[k] = 0.5f * (lo[k] + hi[k]);
+      scale = std::max(scale, 0.5f * (hi[k] - lo[k]));
+    }
+  }
+  if (scale <= 0.0f) {
+    scale = 1.0f;
+  }
+  primitive.scale = scale;
+
+  // Quantize and merge identical vertices
+  std::vector<QuantizedVertex> vertices;
+  std::vector<std::uint32_t> remap(sourceVertices);
+  std::unordered_map<QuantizedVertex, std::uint32_t, VertexHash> unique;
+  unique.reserve(sourceVertices);
+  const bool hasNormals = mesh.normals.size() == mesh.positions.size();
+  for (std::size_t v = 0; v < sourceVertices; ++v) {
+    QuantizedVertex q = {};
+    for (int k = 0; k < 3; ++k) {
+      q.position[k] =
+          QuantizeUnit16((mesh.positions[3 * v + k] - center[k]) / scale);
+      q.normal[k] = hasNormals ? QuantizeUnit8(mesh.normals[3 * v + k]) : 0;
+    }
+    auto inserted =
+        unique.emplace(q, static_cast<std::uint32_t>(vertices.size()));
+    if (inserted.second) {
+      vertices.push_back(q);
+    }
+    remap[v] = inserted.first->second;
+  }
+  primitive.hasNormals = hasNormals;
+
+  // Drop triangles that collapsed under quantization, then order for the
+  // vertex cache
+  std::vector<std::uint32_t> indices;
+  indices.reserve(mesh.indices.size());
+  for (std::size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+    std::uint32_t a = remap[mesh.indices[t]], b = remap[mesh.indices[t + 1]],
+                  c = remap[mesh.indices[t + 2]];
+    if (a != b && b != c && a != c) {
+      indices.insert(indices.end(), {a, b, c});
+    }
+  }
+  indices = Tipsify(indices, vertices.size());
+
+  // Renumber vertices in first-use order so fetches stream linearly
+  std::vector<std::uint32_t> order(vertices.size(), UINT32_MAX);
+  std::vector<QuantizedVertex> ordered;
+  ordered.reserve(vertices.size());
+  for (std::uint32_t &index : indices) {
+    if (order[index] == UINT32_MAX) {
+      order[index] = static_cast<std::uint32_t>(ordered.size());
+      ordered.push_back(vertices[index]);
+    }
+    index = order[index];
+  }
+  primitive.vertexCount = ordered.size();
+  primitive.indexCount = indices.size();
+
+  // Accessor bounds are given in stored (integer) units
+  std::int16_t *qmin = primitive.qmin;
+  std::int16_t *qmax = primitive.qmax;
+  std::fill(qmin, qmin + 3, 32767);
+  std::fill(qmax, qmax + 3, -32767);
+  for (const QuantizedVertex &q : ordered) {
+    for (int k = 0; k < 3; ++k) {
+      qmin[k] = std::min(qmin[k], q.position[k]);
+      qmax[k] = std::max(qmax[k], q.position[k]);
+    }
+  }
+  if (ordered.empty()) {
+    std::fill(qmin, qmin + 3, 0);
+    std::fill(qmax, qmax + 3, 0);
+  }
+
+  // Positions, normals, indices; each view 4-byte aligned
+  primitive.positionOffset = bin.size();
+  for (const QuantizedVertex &q : ordered) {
+    Append(bin, q.position, sizeof(q.position));
+  }
+  primitive.positionLength = bin.size() - primitive.positionOffset;
+  primitive.normalOffset = bin.size();
+  for (const QuantizedVertex &q : ordered) {
+    Append(bin, q.normal, sizeof(q.normal));
+  }
+  primitive.normalLength = bin.size() - primitive.normalOffset;
+  primitive.indexOffset = bin.size();
+  primitive.shortIndices = ordered.size() <= 65535;
+  for (std::uint32_t index : indices) {
+    if (primitive.shortIndices) {
+      std::uint16_t i16 = static_cast<std::uint16_t>(index);
+      Append(bin, &i16, sizeof(i16));
+    } else {
+      Append(bin, &index, sizeof(index));
+    }
+  }
+  primitive.indexLength = bin.size() - primitive.indexOffset;
+  Pad(bin, 0);
+  return primitive;
+}
+
+bool IsIdentity(const float matrix[16]) {
+  for (int k = 0; k < 16; ++k) {
+    if (matrix[k] != ((k % 5 == 0) ? 1.0f : 0.0f)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Node of one instance: the instance transform followed by the dequantizing
+// translation and scale of its mesh
+void WriteNode(std::ostringstream &json, std::size_t mesh,
+               const Primitive &primitive, const float matrix[16]) {
+  const float *center = primitive.center;
+  const float scale = primitive.scale;
+  json << "{\"mesh\":" << mesh;
+  if (IsIdentity(matrix)) {
+    json << ",\"translation\":[" << center[0] << "," << center[1] << ","
+         << center[2] << "],\"scale\":[" << scale << "," << scale << ","
+         << scale << "]}";
+    return;
+  }
+  // Column-major: M * T(center) * S(scale)
+  json << ",\"matrix\":[";
+  for (int column = 0; column < 4; ++column) {
+    for (int row = 0; row < 4; ++row) {
+      float value;
+      if (column < 3) {
+        value = matrix[4 * column + row] * scale;
+      } else {
+        value = matrix[12 + row];
+        for (int k = 0; k < 3; ++k) {
+          value += matrix[4 * k + row] * center[k];
+        }
+      }
+      json << (column + row > 0 ? "," : "") << value;
+    }
+  }
+  json << "]}";
+}
+} // namespace
+
+std::vector<unsigned char> EncodeGLB(const TriMesh &mesh) {
+  GlbInstance instance = {0, {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}};
+  return EncodeGLBScene({mesh}, {instance});
+}
+
+std::vector<unsigned char>
+EncodeGLBScene(const std::vector<TriMesh> &meshes,
+               const std::vector<GlbInstance> &instances) {
+  // Binary chunk: every mesh once
+  std::vector<unsigned char> bin;
+  std::vector<Primitive> primitives;
+  primitives.reserve(meshes.size());
+  for (const TriMesh &mesh : meshes) {
+    primitives.push_back(AppendPrimitive(bin, mesh));
+  }
+
+  std::ostringstream json;
+  json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"BoltGenerator\"},"
+       << "\"extensionsUsed\":[\"KHR_mesh_quantization\"],"
+       << "\"extensionsRequired\":[\"KHR_mesh_quantization\"],"
+       << "\"scene\":0,\"scenes\":[{\"nodes\":[";
+  for (std::size_t n = 0; n < instances.size(); ++n) {
+    json << (n > 0 ? "," : "") << n;
+  }
+  json << "]}],\"nodes\":[";
+  for (std::size_t n = 0; n < instances.size(); ++n) {
+    if (n > 0) {
+      json << ",";
+    }
+    WriteNode(json, instances[n].mesh, primitives[instances[n].mesh],
+              instances[n].matrix);
+  }
+
+  // Three accessors and three buffer views per mesh, in mesh order
+  json << "],\"meshes\":[";
+  for (std::size_t m = 0; m < primitives.size(); ++m) {
+    json << (m > 0 ? "," : "") << "{\"primitives\":[{\"attributes\":{"
+         << "\"POSITION\":" << 3 * m;
+    if (primitives[m].hasNormals) {
+      json << ",\"NORMAL\":" << 3 * m + 1;
+    }
+    json << "},\"indices\":" << 3 * m + 2 << ",\"mode\":4}]}";
+  }
+  json << "],\"accessors\":[";
+  for (std::size_t m = 0; m < primitives.size(); ++m) {
+    const Primitive &primitive = primitives[m];
+    json << (m > 0 ? "," : "") << "{\"bufferView\":" << 3 * m
+         << ",\"componentType\":" << kShort
+         << ",\"normalized\":true,\"count\":" << primitive.vertexCount
+         << ",\"type\":\"VEC3\",\"min\":[" << primitive.qmin[0] << ","
+         << primitive.qmin[1] << "," << primitive.qmin[2] << "],\"max\":["
+         << primitive.qmax[0] << "," << primitive.qmax[1] << ","
+         << primitive.qmax[2] << "]},"
+         << "{\"bufferView\":" << 3 * m + 1 << ",\"componentType\":" << kByte
+         << ",\"normalized\":true,\"count\":" << primitive.vertexCount
+         << ",\"type\":\"VEC3\"},"
+         << "{\"bufferView\":" << 3 * m + 2 << ",\"componentType\":"
+         << (primitive.shortIndices ? kUnsignedShort : kUnsignedInt)
+         << ",\"count\":" << primitive.indexCount << ",\"type\":\"SCALAR\"}";
+  }
+  json << "],\"bufferViews\":[";
+  for (std::size_t m = 0; m < primitives.size(); ++m) {
+    const Primitive &primitive = primitives[m];
+    json << (m > 0 ? "," : "") << "{\"buffer\":0,\"byteOffset\":"
+         << primitive.positionOffset
+         << ",\"byteLength\":" << primitive.positionLength
+         << ",\"byteStride\":8,\"target\":" << kArrayBuffer << "},"
+         << "{\"buffer\":0,\"byteOffset\":" << primitive.normalOffset
+         << ",\"byteLength\":" << primitive.normalLength
+         << ",\"byteStride\":4,\"target\":" << kArrayBuffer << "},"
+         << "{\"buffer\":0,\"byteOffset\":" << primitive.indexOffset
+         << ",\"byteLength\":" << primitive.indexLength
+         << ",\"target\":" << kElementArrayBuffer << "}";
+  }
+  json << "],\"buffers\":[{\"byteLength\":" << bin.size() << "}]}";
+  std::string text = json.str();
+  std::vector<unsigned char> jsonChunk(text.begin(), text.end());
+  Pad(jsonChunk, ' ');
+
+  std::vector<unsigned char> glb;
+  glb.reserve(12 + 8 + jsonChunk.size() + 8 + bin.size());
+  AppendU32(glb, 0x46546C67); // "glTF"
+  AppendU32(glb, 2);
+  AppendU32(glb, static_cast<std::uint32_t>(12 + 8 + jsonChunk.size() + 8 +
+                                             bin.size()));
+  AppendU32(glb, static_cast<std::uint32_t>(jsonChunk.size()));
+  AppendU32(glb, 0x4E4F534A); // "JSON"
+  Append(glb, jsonChunk.data(), jsonChunk.size());
+  AppendU32(glb, static_cast<std::uint32_t>(bin.size()));
+  AppendU32(glb, 0x004E4942); // "BIN\0"
+  Append(glb, bin.data(), bin.size());
+  return glb;
+}
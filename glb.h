@@ -0,0 +1,37 @@
+/*
+    BoltGenerator - Quantized glTF binary (GLB) writer
+    Copyright (C) 2025
+*/
+
+#ifndef GLB_H
+#define GLB_H
+
+#include "trimesh.h"
+
+#include <cstddef>
+#include <vector>
+
+// Encodes `mesh` as a single-primitive GLB for browser previews:
+//  - positions quantized to normalized int16 and normals to normalized int8
+//    (KHR_mesh_quantization), dequantized by the node's scale/translation
+//  - vertices with identical quantized position and normal are merged
+//  - triangles reordered for the post-transform vertex cache (Tipsify), and
+//    vertices renumbered in first-use order
+//  - 16-bit indices whenever the vertex count allows
+std::vector<unsigned char> EncodeGLB(const TriMesh &mesh);
+
+// One placed copy of a mesh: index into the scene's meshes and a
+// column-major 4x4 transform
+struct GlbInstance {
+  std::size_t mesh;
+  float matrix[16];
+};
+
+// Scene of several meshes, each encoded once as above and drawn by one node
+// per instance, so the file grows with the distinct meshes rather than the
+// instances
+std::vector<unsigned char>
+EncodeGLBScene(const std::vector<TriMesh> &meshes,
+               const std::vector<GlbInstance> &instances);
+
+#endif // GLB_H
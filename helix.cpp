@@ -1,5 +1,6 @@
 #define _USE_MATH_DEFINES
 #include "helix.h"
+#include "progress.h"
 #include <cmath>
 #include <gp_Vec.hxx>
 
@@ -30,7 +31,9 @@ TopoDS_Solid Helix(TopoDS_Wire sketch, double diameter, double pitch,
       BRepOffsetAPI_MakePipeShell(BRepBuilderAPI_MakeWire(toolPath).Wire());
   threadPipe.Add(sketch);
   threadPipe.SetMode(gp_Vec(0, 0, 1));
-  threadPipe.Build();
+  Handle(CancelIndicator) progress = new CancelIndicator();
+  threadPipe.Build(progress->Start());
+  ThrowIfCancelled("thread sweep");
 
   if (!threadPipe.IsDone()) {
     throw std::runtime_error("Helix: Pipe shell construction failed");
@@ -1,9 +1,22 @@
 #include "bolt.h"
+#include "budget.h"
+#include "cache.h"
+#include "cut.h"
 #include "export.h"
+#include "manifest.h"
+#include "mesh.h"
 #include "nut.h"
 #include "parameters.h"
+#include "pattern.h"
+#include "preflight.h"
+#include "progress.h"
+#include "session.h"
+#include <csignal>
 #include <cstdlib>
 #include <iostream>
+#include <unistd.h>
+#include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -15,15 +28,31 @@ int main(int argc, char *argv[]) {
                  "<d> <L> <ls> <bodyTol> <threadD> <P> <minorD> <genNut> "
                  "<nutS> <nutH> <nutDw> <nutTol> <boltFillet> <nutFillet> "
                  "<topFillet> <vChamfer> <transFillet> <crestR> <nutChamfer> "
-                 "<threadClear> <tolClass>"
+                 "<threadClear> <tolClass> [--race-booleans] [--budget-ms=N] "
+                 "[--stream[=stl|glb]] [--screen-px=N] "
+                 "[--preview=brep|analytic|mesh] "
+                 "[--periodic-mesh] "
+                 "[--thread-lod=full|simplified|cosmetic|none] "
+                 "[--outputs=preview,brep,stl,step] [--session] "
+                 "[--brep-format=ascii|binary] [--cache-dir=DIR] "
+                 "[--pattern=circle:N:R[:start]|grid:ROWS:COLS:DY:DX|"
+                 "points:x,y[,a];...] [--washer]"
               << std::endl;
     return 1;
   }
 
+  // The server terminates the job when its client goes away
+  InstallCancelHandler();
+  SetJobBudget(0.0);
+  SetMeshThreads(0);
+
+  std::string name = argv[1];
+  std::string manifestPath = std::string("Tests/").append(name).append(".json");
+  ManifestSet("name", name);
+
   try {
-    BoltParameters p;
-    int i = 1;
-    std::string name = argv[i++];
+    BoltParameters p{};
+    int i = 2;
 
     // Head
     p.head.type = static_cast<HeadType>(atoi(argv[i++]));
@@ -66,34 +95,228 @@ int main(int argc, char *argv[]) {
     p.nut.threadClearance = atof(argv[i++]);
     p.material.toleranceClass = argv[i++]; // string
 
+    // Optional job flags follow the positional arguments as --key[=value]
+    std::string stream; // preview format written to stdout, if any
+    bool analyticPreview = false;
+    bool meshCsgPreview = false;
+    bool periodicMesh = false;
+    // Outputs written up front (preview, brep, stl, step, assembly); a
+    // session writes the others on request
+    std::set<std::string> outputs = {"preview", "brep", "stl"};
+    bool outputsGiven = false;
+    bool serveSession = false;
+    OutputFormat brepFormat = OutputFormat::BREP;
+    PatternParameters pattern;
+    for (; i < argc; ++i) {
+      std::string arg = argv[i];
+      std::string key = arg.substr(0, arg.find('='));
+      std::string value =
+          (key.size() < arg.size()) ? arg.substr(key.size() + 1) : "";
+      if (key == "--race-booleans") {
+        SetCutStrategy(CutStrategy::RACE);
+      } else if (key == "--stream") {
+        // The bolt preview goes to stdout as binary STL, so every log line
+        // moves to stderr and a closed pipe counts as a cancelled request
+        stream = value.empty() ? "stl" : value;
+        std::cout.rdbuf(std::cerr.rdbuf());
+        std::signal(SIGPIPE, SIG_IGN);
+      } else if (key == "--preview") {
+        // Previews tessellated from the parameters rather than the B-rep,
+        // directly or combined from meshed primitives by mesh booleans
+        analyticPreview = (value == "analytic" || value == "mesh");
+        meshCsgPreview = (value == "mesh");
+      } else if (key == "--periodic-mesh") {
+        // The bolt download meshes one thread pitch and one head sector.
+        // Opt-in: the split costs a boolean on the helical solid, so check
+        // `make bench-periodic` before relying on it being faster.
+        periodicMesh = true;
+      } else if (key == "--thread-lod") {
+        // Assembly context often needs no more than the thread's envelope
+        if (value == "simplified") {
+          p.thread.lod = ThreadLod::SIMPLIFIED;
+        } else if (value == "cosmetic") {
+          p.thread.lod = ThreadLod::COSMETIC;
+        } else if (value == "none") {
+          p.thread.lod = ThreadLod::NONE;
+        } else if (value != "full") {
+          std::cerr << "Warning: ignoring unknown thread LOD " << value
+                    << std::endl;
+          continue;
+        }
+        ManifestSet("threadLod", value);
+      } else if (key == "--outputs") {
+        outputs.clear();
+        outputsGiven = true;
+        std::stringstream list(value);
+        std::string output;
+        while (std::getline(list, output, ',')) {
+          outputs.insert(output);
+        }
+      } else if (key == "--session") {
+        // After the job, keep its parts and write further outputs on
+        // request: file names on stdin, replies on kSessionReplyFd
+        serveSession = true;
+      } else if (key == "--brep-format") {
+        // The binary format is smaller and much faster to write and read
+        brepFormat = (value == "binary") ? OutputFormat::BREP_BINARY
+                                         : OutputFormat::BREP;
+      } else if (key == "--pattern") {
+        // Instances of the fastener for a flange or plate; its parts are
+        // still built once
+        if (!ParsePattern(value, pattern)) {
+          std::cerr << "Warning: ignoring malformed pattern " << value
+                    << std::endl;
+          continue;
+        }
+        ManifestSet("pattern", value);
+      } else if (key == "--root-radius") {
+        // ISO 68-1 thread root radius; the crest radius is positional
+        p.thread.rootRadius = atof(value.c_str());
+      } else if (key == "--washer") {
+        pattern.washer = true;
+      } else if (key == "--cache-dir") {
+        SetResultCacheDir(value);
+      } else if (key == "--screen-px") {
+        SetPreviewScreenSize(atoi(value.c_str()));
+      } else if (key == "--budget-ms") {
+        SetJobBudget(atof(value.c_str()));
+        ManifestSet("budgetMs", BudgetMs());
+      } else {
+        std::cerr << "Warning: ignoring unknown option " << arg << std::endl;
+      }
+    }
+
+    // Reject infeasible parameter sets before any OCCT work; the remaining
+    // violations are clamped and reported back through the manifest
+    std::vector<Violation> violations = Preflight(p);
+    for (const Violation &v : violations) {
+      std::cerr << (v.fatal ? "Preflight error: " : "Preflight clamp: ")
+                << v.message << std::endl;
+      ManifestAddRecord("violations",
+                        {{"code", ManifestString(v.code)},
+                         {"field", ManifestString(v.field)},
+                         {"value", ManifestNumber(v.value)},
+                         {"suggested", ManifestNumber(v.suggested)},
+                         {"fatal", v.fatal ? "true" : "false"},
+                         {"message", ManifestString(v.message)}});
+    }
+    if (HasFatalViolation(violations)) {
+      ManifestSet("status", "rejected");
+      ManifestSet("elapsedMs", ElapsedMs());
+      WriteManifest(manifestPath);
+      return 2;
+    }
+    ApplyClamps(p, violations);
+
     std::cout << "Starting generation for " << name << "..." << std::endl;
+    if (!outputsGiven && p.thread.lod == ThreadLod::COSMETIC) {
+      outputs.insert("step");
+    }
+    if (!outputsGiven && pattern.type != PatternType::SINGLE) {
+      outputs.insert("assembly");
+    }
+    ManifestSet("instances",
+                static_cast<double>(PatternInstances(pattern).size()));
+    auto wants = [&](const char *output) { return outputs.count(output) > 0; };
 
-    // Generate Bolt
-    Bolt bolt(p);
-    std::string brepPath = std::string("Tests/").append(name).append(".brep");
-    std::string stlPath = std::string("Tests/").append(name).append(".stl");
+    // Parts are built the first time an output needs them
+    Session job(name, p, periodicMesh, pattern);
 
-    ExportBRep(bolt.Solid(), brepPath.c_str());
-    ExportSTL(bolt.Solid(), stlPath.c_str());
-    std::cout << "Bolt exported: " << brepPath << std::endl;
+    // An analytic preview needs no kernel work, so it is streamed before the
+    // bolt is even built
+    if (analyticPreview && (wants("preview") || !stream.empty())) {
+      TriMesh boltPreview = meshCsgPreview ? MeshCsgBoltPreview(p)
+                                           : AnalyticBoltPreview(p);
+      if (stream == "glb") {
+        StreamGLB(boltPreview, STDOUT_FILENO);
+      } else if (!stream.empty()) {
+        StreamSTL(boltPreview, STDOUT_FILENO);
+      }
+      if (!stream.empty()) {
+        close(STDOUT_FILENO);
+      }
+      if (wants("preview")) {
+        ExportGLB(boltPreview, job.Path(Part::BOLT, OutputFormat::GLB).c_str());
+      }
+    } else if (stream == "glb") {
+      // Preview first, then close the pipe so the client can render it
+      // while the downloads and nut are still being written
+      StreamGLB(job.BoltPart().Solid(), STDOUT_FILENO);
+      close(STDOUT_FILENO);
+    } else if (!stream.empty()) {
+      StreamSTL(job.BoltPart().Solid(), STDOUT_FILENO);
+      close(STDOUT_FILENO);
+    }
+
+    // The STEP output is the assembly: the bolt and nut of every fastener of
+    // the pattern. Its translation is the slowest writer, so it runs on its
+    // own thread while the meshes below are written.
+    if (wants("step")) {
+      job.MaterializeStepInBackground(Part::ASSEMBLY);
+    }
+
+    // Only the outputs asked for; an analytic preview alone never builds
+    // the B-rep
+    if (wants("brep")) {
+      job.Materialize(Part::BOLT, brepFormat);
+    }
+    if (wants("stl")) {
+      job.Materialize(Part::BOLT, OutputFormat::STL);
+    }
+    if (wants("preview") && !analyticPreview && stream != "stl") {
+      job.Materialize(Part::BOLT, OutputFormat::GLB);
+    }
+    std::cout << "Bolt outputs written" << std::endl;
 
     // Generate Nut if requested
     if (p.nut.generate) {
-      Nut nut(p);
-      std::string nutBrepPath =
-          std::string("Tests/").append(name).append("_nut.brep");
-      std::string nutStlPath =
-          std::string("Tests/").append(name).append("_nut.stl");
-
-      ExportBRep(nut.Solid(), nutBrepPath.c_str());
-      ExportSTL(nut.Solid(), nutStlPath.c_str());
-      std::cout << "Nut exported: " << nutBrepPath << std::endl;
+      if (wants("brep")) {
+        job.Materialize(Part::NUT, brepFormat);
+      }
+      if (wants("stl")) {
+        job.Materialize(Part::NUT, OutputFormat::STL);
+      }
+      if (wants("preview")) {
+        if (analyticPreview) {
+          ExportGLB(meshCsgPreview ? MeshCsgNutPreview(p)
+                                   : AnalyticNutPreview(p),
+                    job.Path(Part::NUT, OutputFormat::GLB).c_str());
+        } else {
+          job.Materialize(Part::NUT, OutputFormat::GLB);
+        }
+      }
+      std::cout << "Nut outputs written" << std::endl;
+    }
+    if (wants("assembly")) {
+      job.Materialize(Part::ASSEMBLY, OutputFormat::GLB);
+    }
+    job.Join();
+
+    if (serveSession) {
+      // The job is done; its parts stay in memory for the downloads, which
+      // the server requests when they are clicked
+      ManifestSet("status", "ok");
+      ManifestSet("elapsedMs", ElapsedMs());
+      WriteManifest(manifestPath);
+      WriteLine(kSessionReplyFd, "ready");
+      job.Serve(kSessionReplyFd, manifestPath);
+      return 0;
     }
 
+  } catch (const JobCancelled &e) {
+    std::cerr << "Cancelled: " << e.what() << std::endl;
+    return 130;
   } catch (const std::exception &e) {
     std::cerr << "Fatal Error: " << e.what() << std::endl;
+    ManifestSet("status", "failed");
+    ManifestSet("error", e.what());
+    ManifestSet("elapsedMs", ElapsedMs());
+    WriteManifest(manifestPath);
     return 1;
   }
 
+  ManifestSet("status", "ok");
+  ManifestSet("elapsedMs", ElapsedMs());
+  WriteManifest(manifestPath);
   return 0;
 }
@@ -0,0 +1,129 @@
+#include "manifest.h"
+
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+namespace {
+// Fields keep their insertion order; values are stored already JSON-encoded.
+std::vector<std::pair<std::string, std::string>> fields;
+std::vector<std::pair<std::string, std::vector<ManifestRecord>>> lists;
+std::mutex manifestMutex;
+
+std::string Quote(const std::string &text) {
+  std::string out = "\"";
+  for (char c : text) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        out += ' ';
+      } else {
+        out += c;
+      }
+    }
+  }
+  return out + "\"";
+}
+
+void SetField(const std::string &key, const std::string &json) {
+  std::lock_guard<std::mutex> lock(manifestMutex);
+  for (auto &field : fields) {
+    if (field.first == key) {
+      field.second = json;
+      return;
+    }
+  }
+  fields.emplace_back(key, json);
+}
+} // namespace
+
+void ManifestSet(const std::string &key, const std::string &value) {
+  SetField(key, Quote(value));
+}
+
+void ManifestSet(const std::string &key, double value) {
+  SetField(key, ManifestNumber(value));
+}
+
+void ManifestSetFlag(const std::string &key, bool value) {
+  SetField(key, value ? "true" : "false");
+}
+
+std::string ManifestString(const std::string &value) { return Quote(value); }
+
+std::string ManifestNumber(double value) {
+  if (!std::isfinite(value)) {
+    return "null";
+  }
+  std::ostringstream out;
+  out << value;
+  return out.str();
+}
+
+void ManifestAddRecord(const std::string &list, const ManifestRecord &record) {
+  std::lock_guard<std::mutex> lock(manifestMutex);
+  for (auto &named : lists) {
+    if (named.first == list) {
+      named.second.push_back(record);
+      return;
+    }
+  }
+  lists.emplace_back(list, std::vector<ManifestRecord>{record});
+}
+
+void ManifestAddEntry(const std::string &list, const std::string &stage,
+                      const std::string &detail) {
+  ManifestAddRecord(list, {{"stage", Quote(stage)}, {"detail", Quote(detail)}});
+}
+
+std::size_t ManifestListSize(const std::string &list) {
+  std::lock_guard<std::mutex> lock(manifestMutex);
+  for (const auto &named : lists) {
+    if (named.first == list) {
+      return named.second.size();
+    }
+  }
+  return 0;
+}
+
+bool WriteManifest(const std::string &filename) {
+  std::lock_guard<std::mutex> lock(manifestMutex);
+  std::ofstream out(filename);
+  if (!out) {
+    return false;
+  }
+
+  out << "{";
+  bool first = true;
+  for (const auto &field : fields) {
+    out << (first ? "\n" : ",\n") << "  " << Quote(field.first) << ": "
+        << field.second;
+    first = false;
+  }
+  for (const auto &named : lists) {
+    out << (first ? "\n" : ",\n") << "  " << Quote(named.first) << ": [";
+    for (std::size_t i = 0; i < named.second.size(); ++i) {
+      out << (i == 0 ? "\n" : ",\n") << "    {";
+      const ManifestRecord &record = named.second[i];
+      for (std::size_t j = 0; j < record.size(); ++j) {
+        out << (j == 0 ? "" : ", ") << Quote(record[j].first) << ": "
+            << record[j].second;
+      }
+      out << "}";
+    }
+    out << "\n  ]";
+    first = false;
+  }
+  out << "\n}\n";
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,37 @@
+/*
+    BoltGenerator - Job manifest
+    Copyright (C) 2025
+*/
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The manifest is a small JSON document written next to the job outputs. It
+// tells the server what the engine actually produced, including every
+// shortcut it took to stay within budget.
+void ManifestSet(const std::string &key, const std::string &value);
+void ManifestSet(const std::string &key, double value);
+void ManifestSetFlag(const std::string &key, bool value);
+
+// Appends a {stage, detail} record to the named list (e.g. "degradations").
+void ManifestAddEntry(const std::string &list, const std::string &stage,
+                      const std::string &detail);
+
+// Appends an arbitrary flat record to the named list. Values are JSON
+// literals; build them with ManifestString() / ManifestNumber().
+using ManifestRecord = std::vector<std::pair<std::string, std::string>>;
+std::string ManifestString(const std::string &value);
+std::string ManifestNumber(double value);
+void ManifestAddRecord(const std::string &list, const ManifestRecord &record);
+
+// Number of records in the named list so far
+std::size_t ManifestListSize(const std::string &list);
+
+bool WriteManifest(const std::string &filename);
+
+#endif // MANIFEST_H
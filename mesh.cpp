@@ -0,0 +1,567 @@
+#include "mesh.h"
+#include "manifest.h"
+#include "progress.h"
+#include "replicate.h"
+
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepAlgoAPI_Splitter.hxx>
+#include <BRepBndLib.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <BRepBuilderAPI_MakePolygon.hxx>
+#include <BRepBuilderAPI_Sewing.hxx>
+#include <BRepGProp.hxx>
+#include <BRepMesh_IncrementalMesh.hxx>
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <Bnd_Box.hxx>
+#include <GProp_GProps.hxx>
+#include <IMeshTools_Parameters.hxx>
+#include <OSD_Parallel.hxx>
+#include <OSD_ThreadPool.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopLoc_Location.hxx>
+#include <TopTools_IndexedDataMapOfShapeListOfShape.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TopTools_ListOfShape.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+#include <TopoDS_Edge.hxx>
+#include <TopoDS_Face.hxx>
+#include <gp_Trsf.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace {
+// Enough for every quality level of a bolt and its nut within one session
+constexpr std::size_t kMaxCachedMeshes = 8;
+
+struct CachedMesh {
+  TopoDS_Shape source; // shape as passed in, before sewing
+  MeshQuality quality;
+  TopoDS_Shape meshed;
+};
+
+// Most recently used first
+std::list<CachedMesh> meshCache;
+std::mutex meshCacheMutex;
+
+bool SameQuality(const MeshQuality &a, const MeshQuality &b) {
+  return a.deflection == b.deflection && a.angle == b.angle &&
+         a.relative == b.relative && a.adaptive == b.adaptive;
+}
+
+// Set once any shape of the job needed sewing
+std::atomic<bool> anySewn(false);
+
+// A closed shell uses every (non-degenerated) edge in two faces, or twice in
+// one face for a seam; an edge with a single face use is a free edge.
+bool HasFreeEdges(const TopoDS_Shape &shape) {
+  TopTools_IndexedDataMapOfShapeListOfShape edgeFaces;
+  TopExp::MapShapesAndAncestors(shape, TopAbs_EDGE, TopAbs_FACE, edgeFaces);
+  for (int i = 1; i <= edgeFaces.Extent(); ++i) {
+    const TopoDS_Edge &edge = TopoDS::Edge(edgeFaces.FindKey(i));
+    if (!BRep_Tool::Degenerated(edge) &&
+        edgeFaces.FindFromIndex(i).Extent() < 2) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Repair shape to ensure closed for proper mesh export. Bolt and Nut return
+// closed solids, so sewing (a full pass over every face) only runs when the
+// adjacency check finds free edges.
+TopoDS_Shape Sewn(const TopoDS_Shape &shape) {
+  if (!HasFreeEdges(shape)) {
+    std::cout << "Mesh: Shape is closed, skipping sewing" << std::endl;
+    ManifestSetFlag("sewn", anySewn.load());
+    return shape;
+  }
+
+  std::cout << "Mesh: Free edges found, sewing" << std::endl;
+  anySewn.store(true);
+  ManifestSetFlag("sewn", true);
+  try {
+    double repairTol = 1e-4;
+    BRepBuilderAPI_Sewing sewer(repairTol);
+    sewer.Add(shape);
+    Handle(CancelIndicator) progress = new CancelIndicator();
+    sewer.Perform(progress->Start());
+    ThrowIfCancelled("sewing");
+    return sewer.SewedShape();
+  } catch (const JobCancelled &) {
+    throw;
+  } catch (...) {
+    std::cout << "Shape repair failed, proceeding with original" << std::endl;
+    return shape;
+  }
+}
+
+// Relative meshing cost per unit of face extent. Freeform faces (the swept
+// thread flanks) need curvature-driven refinement; planes need almost none.
+double SurfaceCostWeight(GeomAbs_SurfaceType type) {
+  switch (type) {
+  case GeomAbs_Plane:
+    return 1.0;
+  case GeomAbs_Cylinder:
+  case GeomAbs_Cone:
+    return 4.0;
+  case GeomAbs_Sphere:
+  case GeomAbs_Torus:
+  case GeomAbs_SurfaceOfRevolution:
+  case GeomAbs_SurfaceOfExtrusion:
+    return 8.0;
+  default:
+    return 32.0;
+  }
+}
+
+double EstimatedCost(const TopoDS_Face &face) {
+  Bnd_Box box;
+  BRepBndLib::Add(face, box, Standard_False);
+  double extent = box.IsVoid() ? 0.0 : box.SquareExtent();
+  return SurfaceCostWeight(BRepAdaptor_Surface(face, Standard_False).GetType()) *
+         extent;
+}
+
+// Rebuilds the face list as a compound ordered by descending estimated cost.
+// The faces keep their TShapes, so triangulations land on the original shape
+// and shared edges are still discretized once.
+TopoDS_Compound FacesByCost(const std::vector<TopoDS_Face> &faceList) {
+  std::vector<std::pair<double, TopoDS_Face>> faces;
+  for (const TopoDS_Face &face : faceList) {
+    faces.emplace_back(EstimatedCost(face), face);
+  }
+  std::stable_sort(faces.begin(), faces.end(),
+                   [](const std::pair<double, TopoDS_Face> &a,
+                      const std::pair<double, TopoDS_Face> &b) {
+                     return a.first > b.first;
+                   });
+
+  BRep_Builder builder;
+  TopoDS_Compound ordered;
+  builder.MakeCompound(ordered);
+  for (const auto &entry : faces) {
+    builder.Add(ordered, entry.second);
+  }
+  return ordered;
+}
+
+// Feature classes of the adaptive policy, finest budget first
+enum FaceFeature { kFreeform, kCylinder, kFillet, kPlane, kFeatureCount };
+
+struct FeatureBudget {
+  const char *name;
+  double deflectionScale;
+  double angleScale;
+};
+
+// Thread flanks (swept freeform faces) carry the visible detail and get the
+// base budget. Cylinders and cones keep the chordal limit for their
+// silhouettes but relax the angular one, which is what over-refines small
+// radii. Fillets are narrow blends whose chordal error is sub-pixel well
+// before the angle limit is met. Planes are fully described by their
+// boundary, which they share with finer faces anyway.
+constexpr FeatureBudget kFeatureBudgets[kFeatureCount] = {
+    {"freeform", 1.0, 1.0},
+    {"cylinder", 1.0, 2.0},
+    {"fillet", 2.0, 2.0},
+    {"plane", 4.0, 4.0},
+};
+
+FaceFeature ClassifyFace(const TopoDS_Face &face) {
+  switch (BRepAdaptor_Surface(face, Standard_False).GetType()) {
+  case GeomAbs_Plane:
+    return kPlane;
+  case GeomAbs_Cylinder:
+  case GeomAbs_Cone:
+    return kCylinder;
+  case GeomAbs_Torus:
+  case GeomAbs_Sphere:
+    return kFillet;
+  default:
+    return kFreeform;
+  }
+}
+
+bool MeshFaces(const std::vector<TopoDS_Face> &faces,
+               const IMeshTools_Parameters &meshParams) {
+  Handle(CancelIndicator) progress = new CancelIndicator();
+  BRepMesh_IncrementalMesh mesher(FacesByCost(faces), meshParams,
+                                  progress->Start());
+  ThrowIfCancelled("meshing");
+  return mesher.IsDone();
+}
+
+// Planar quad through four corners, used as a splitting tool
+TopoDS_Face QuadFace(const gp_Pnt &a, const gp_Pnt &b, const gp_Pnt &c,
+                     const gp_Pnt &d) {
+  BRepBuilderAPI_MakePolygon polygon;
+  polygon.Add(a);
+  polygon.Add(b);
+  polygon.Add(c);
+  polygon.Add(d);
+  polygon.Close();
+  return BRepBuilderAPI_MakeFace(polygon.Wire(), Standard_True).Face();
+}
+
+// Horizontal cut at height z across the whole part
+TopoDS_Face CutAcross(double z, double extent) {
+  return QuadFace(gp_Pnt(-extent, -extent, z), gp_Pnt(extent, -extent, z),
+                  gp_Pnt(extent, extent, z), gp_Pnt(-extent, extent, z));
+}
+
+// Vertical cut from the z axis outwards at `angle`, between heights z0, z1
+TopoDS_Face CutFromAxis(double angle, double z0, double z1, double extent) {
+  const double x = extent * std::cos(angle), y = extent * std::sin(angle);
+  return QuadFace(gp_Pnt(0.0, 0.0, z0), gp_Pnt(x, y, z0), gp_Pnt(x, y, z1),
+                  gp_Pnt(0.0, 0.0, z1));
+}
+
+// Absolute deflection BRepMesh's relative mode gives `face`: each edge gets
+// `deflection` times its largest extent and the face the mean over its edges
+double RelativeFaceDeflection(const TopoDS_Face &face, double deflection) {
+  double sum = 0.0;
+  int edges = 0;
+  for (TopExp_Explorer ex(face, TopAbs_EDGE); ex.More(); ex.Next()) {
+    Bnd_Box box;
+    BRepBndLib::Add(ex.Current(), box);
+    if (box.IsVoid()) {
+      continue;
+    }
+    Standard_Real xMin, yMin, zMin, xMax, yMax, zMax;
+    box.Get(xMin, yMin, zMin, xMax, yMax, zMax);
+    sum += deflection * std::max({xMax - xMin, yMax - yMin, zMax - zMin});
+    ++edges;
+  }
+  return (edges > 0) ? sum / edges : deflection;
+}
+
+// Rounds a deflection down to a quarter octave, so the faces of a part fall
+// into a few meshing passes and none is meshed coarser than asked
+double QuarterOctaveBelow(double deflection) {
+  return std::exp2(std::floor(4.0 * std::log2(deflection)) / 4.0);
+}
+
+// Pieces of the periodic split
+enum PeriodicPiece { kRest, kThreadCell, kThreadCopies, kHeadCell, kHeadCopies,
+                     kPieceCount };
+} // namespace
+
+// BRepMesh dispatches faces through OSD_Parallel, whose workers pull the
+// next face from a shared counter; with the expensive faces first this is
+// longest-processing-time scheduling. Both settings are process-wide (the
+// STEP writer and the splitter share the pool), so they are made here once
+// rather than by every MeshShape() call.
+void SetMeshThreads(int threads) {
+  OSD_Parallel::SetUseOcctThreads(Standard_True);
+  Handle(OSD_ThreadPool) pool = OSD_ThreadPool::DefaultPool();
+  pool->SetNbDefaultThreadsToLaunch(threads > 0 ? threads : pool->NbThreads());
+}
+
+bool MeshShape(const TopoDS_Shape &shape, const MeshQuality &quality) {
+  if (shape.IsNull()) {
+    return false;
+  }
+
+  IMeshTools_Parameters meshParams;
+  meshParams.Deflection = quality.deflection;
+  meshParams.Angle = quality.angle;
+  meshParams.Relative = quality.relative;
+  meshParams.InParallel = Standard_True;
+
+  std::vector<TopoDS_Face> classFaces[kFeatureCount];
+  for (TopExp_Explorer ex(shape, TopAbs_FACE); ex.More(); ex.Next()) {
+    TopoDS_Face face = TopoDS::Face(ex.Current());
+    classFaces[quality.adaptive ? ClassifyFace(face) : kFreeform].push_back(
+        face);
+  }
+  if (!quality.adaptive) {
+    return MeshFaces(classFaces[kFreeform], meshParams);
+  }
+
+  // Pass k remeshes nothing from earlier passes: their triangulations are
+  // finer than pass k asks for, so BRepMesh keeps them and takes the shared
+  // edges' polygons from them instead of rediscretizing those edges coarser
+  std::vector<TopoDS_Face> faces;
+  bool done = true;
+  for (int feature = 0; feature < kFeatureCount; ++feature) {
+    if (classFaces[feature].empty()) {
+      continue;
+    }
+    const FeatureBudget &budget = kFeatureBudgets[feature];
+    std::cout << "Mesh: " << classFaces[feature].size() << " " << budget.name
+              << " faces (deflection x" << budget.deflectionScale
+              << ", angle x" << budget.angleScale << ")" << std::endl;
+    faces.insert(faces.end(), classFaces[feature].begin(),
+                 classFaces[feature].end());
+    meshParams.Deflection = quality.deflection * budget.deflectionScale;
+    meshParams.Angle = quality.angle * budget.angleScale;
+    done = MeshFaces(faces, meshParams) && done;
+  }
+  return done;
+}
+
+TopoDS_Shape MeshedShape(const TopoDS_Shape &shape,
+                         const MeshQuality &quality) {
+  {
+    std::lock_guard<std::mutex> lock(meshCacheMutex);
+    for (auto it = meshCache.begin(); it != meshCache.end(); ++it) {
+      if (it->source.IsSame(shape) && SameQuality(it->quality, quality)) {
+        std::cout << "Mesh: Reusing cached triangulation" << std::endl;
+        meshCache.splice(meshCache.begin(), meshCache, it);
+        return meshCache.front().meshed;
+      }
+    }
+  }
+
+  // Topology-only copy: geometry stays shared, triangulations do not
+  TopoDS_Shape meshed =
+      BRepBuilderAPI_Copy(Sewn(shape), Standard_False, Standard_False).Shape();
+  if (!MeshShape(meshed, quality)) {
+    std::cerr << "Mesh: Mesh generation incomplete" << std::endl;
+    return meshed; // not cached; a later request retries
+  }
+
+  std::lock_guard<std::mutex> lock(meshCacheMutex);
+  meshCache.push_front({shape, quality, meshed});
+  if (meshCache.size() > kMaxCachedMeshes) {
+    meshCache.pop_back();
+  }
+  return meshed;
+}
+
+std::size_t TriangleCount(const TopoDS_Shape &shape) {
+  std::size_t count = 0;
+  for (TopExp_Explorer ex(shape, TopAbs_FACE); ex.More(); ex.Next()) {
+    TopLoc_Location location;
+    Handle(Poly_Triangulation) triangulation =
+        BRep_Tool::Triangulation(TopoDS::Face(ex.Current()), location);
+    if (!triangulation.IsNull()) {
+      count += triangulation->NbTriangles();
+    }
+  }
+  return count;
+}
+
+TriMesh ExtractTriMesh(const TopoDS_Shape &shape) {
+  TriMesh mesh;
+  for (TopExp_Explorer ex(shape, TopAbs_FACE); ex.More(); ex.Next()) {
+    const TopoDS_Face &face = TopoDS::Face(ex.Current());
+    TopLoc_Location location;
+    Handle(Poly_Triangulation) triangulation =
+        BRep_Tool::Triangulation(face, location);
+    if (triangulation.IsNull()) {
+      continue;
+    }
+    const gp_Trsf &transform = location.Transformation();
+    const bool transformed = !location.IsIdentity();
+    const bool flipped =
+        (face.Orientation() == TopAbs_REVERSED) != transform.IsNegative();
+
+    mesh.faceTriangles.push_back(
+        static_cast<std::uint32_t>(mesh.TriangleCount()));
+    const std::uint32_t base = static_cast<std::uint32_t>(mesh.VertexCount());
+    for (int i = 1; i <= triangulation->NbNodes(); ++i) {
+      gp_Pnt p = triangulation->Node(i);
+      if (transformed) {
+        p.Transform(transform);
+      }
+      mesh.positions.insert(mesh.positions.end(),
+                            {static_cast<float>(p.X()),
+                             static_cast<float>(p.Y()),
+                             static_cast<float>(p.Z())});
+    }
+    for (int i = 1; i <= triangulation->NbTriangles(); ++i) {
+      int n1, n2, n3;
+      triangulation->Triangle(i).Get(n1, n2, n3);
+      if (flipped) {
+        std::swap(n2, n3);
+      }
+      mesh.indices.insert(mesh.indices.end(),
+                          {base + n1 - 1, base + n2 - 1, base + n3 - 1});
+    }
+  }
+  mesh.faceTriangles.push_back(static_cast<std::uint32_t>(mesh.TriangleCount()));
+  ComputeVertexNormals(mesh);
+  return mesh;
+}
+
+TriMesh PeriodicTriMesh(const TopoDS_Shape &shape, const MeshQuality &quality,
+                        const PeriodicLayout &layout, float weldTolerance,
+                        float seamTolerance) {
+  const bool thread = (layout.turns >= 2);
+  const bool head = (layout.sectors >= 2);
+  Bnd_Box box;
+  BRepBndLib::Add(shape, box);
+  if ((!thread && !head) || box.IsVoid()) {
+    return TriMesh();
+  }
+  Standard_Real xMin, yMin, zMin, xMax, yMax, zMax;
+  box.Get(xMin, yMin, zMin, xMax, yMax, zMax);
+  const double extent =
+      2.0 * std::max({-xMin, -yMin, xMax, yMax}) + 1.0;
+  const double cellTop = layout.threadStart + layout.pitch;
+  const double threadEnd = layout.threadStart + layout.turns * layout.pitch;
+  const double sector = 2.0 * M_PI / std::max(1, layout.sectors);
+
+  // Cut a private copy, so the source faces never carry this triangulation
+  TopTools_ListOfShape arguments, tools;
+  arguments.Append(
+      BRepBuilderAPI_Copy(shape, Standard_False, Standard_False).Shape());
+  if (thread) {
+    tools.Append(CutAcross(layout.threadStart, extent));
+    tools.Append(CutAcross(cellTop, extent));
+    tools.Append(CutAcross(threadEnd, extent));
+  }
+  if (head) {
+    tools.Append(CutAcross(layout.headStart, extent));
+    tools.Append(CutFromAxis(0.0, layout.headStart, zMax + 1.0, extent));
+    tools.Append(CutFromAxis(sector, layout.headStart, zMax + 1.0, extent));
+  }
+
+  BRepAlgoAPI_Splitter splitter;
+  splitter.SetArguments(arguments);
+  splitter.SetTools(tools);
+  splitter.SetRunParallel(Standard_True);
+  Handle(CancelIndicator) progress = new CancelIndicator();
+  splitter.Build(progress->Start());
+  ThrowIfCancelled("periodic split");
+  if (!splitter.IsDone() || splitter.HasErrors()) {
+    std::cerr << "Mesh: Periodic split failed" << std::endl;
+    return TriMesh();
+  }
+  const TopoDS_Shape pieces = splitter.Shape();
+
+  // A relative deflection scales with the size of each face's edges, and the
+  // cuts make the cell's helical edges far shorter than the part's. Each
+  // piece face is meshed instead at the absolute deflection its face of the
+  // unsplit part would get, so the cells match the full mesh.
+  TopTools_IndexedMapOfShape pieceFaces;
+  std::vector<double> pieceDeflections;
+  if (quality.relative) {
+    for (TopExp_Explorer ex(arguments.First(), TopAbs_FACE); ex.More();
+         ex.Next()) {
+      const double deflection = RelativeFaceDeflection(
+          TopoDS::Face(ex.Current()), quality.deflection);
+      const TopTools_ListOfShape &modified = splitter.Modified(ex.Current());
+      if (modified.IsEmpty()) {
+        pieceFaces.Add(ex.Current());
+        pieceDeflections.push_back(deflection);
+      }
+      for (TopTools_ListIteratorOfListOfShape it(modified); it.More();
+           it.Next()) {
+        if (pieceFaces.Add(it.Value()) > static_cast<int>(
+                                              pieceDeflections.size())) {
+          pieceDeflections.push_back(deflection);
+        }
+      }
+    }
+  }
+
+  // Pieces are told apart by where their centroid lies
+  auto classify = [&](const gp_Pnt &c) {
+    if (thread && c.Z() > layout.threadStart && c.Z() < cellTop) {
+      return kThreadCell;
+    }
+    if (thread && c.Z() > cellTop && c.Z() < threadEnd) {
+      return kThreadCopies;
+    }
+    if (head && c.Z() > layout.headStart) {
+      double angle = std::atan2(c.Y(), c.X());
+      return (angle > 0.0 && angle < sector) ? kHeadCell : kHeadCopies;
+    }
+    return kRest;
+  };
+
+  // Faces on the cuts are shared by two pieces; only the part's own surface
+  // is meshed
+  TopTools_IndexedDataMapOfShapeListOfShape faceSolids;
+  TopExp::MapShapesAndAncestors(pieces, TopAbs_FACE, TopAbs_SOLID, faceSolids);
+  BRep_Builder builder;
+  TopoDS_Compound faces[kPieceCount], meshed;
+  for (TopoDS_Compound &compound : faces) {
+    builder.MakeCompound(compound);
+  }
+  builder.MakeCompound(meshed);
+  // Faces to mesh by absolute deflection, finest first
+  std::map<double, std::vector<TopoDS_Shape>> passes;
+  int count[kPieceCount] = {0};
+  for (TopExp_Explorer solids(pieces, TopAbs_SOLID); solids.More();
+       solids.Next()) {
+    GProp_GProps props;
+    BRepGProp::VolumeProperties(solids.Current(), props);
+    const PeriodicPiece piece = classify(props.CentreOfMass());
+    ++count[piece];
+    if (piece == kThreadCopies || piece == kHeadCopies) {
+      continue;
+    }
+    for (TopExp_Explorer ex(solids.Current(), TopAbs_FACE); ex.More();
+         ex.Next()) {
+      if (faceSolids.FindFromKey(ex.Current()).Extent() > 1) {
+        continue;
+      }
+      builder.Add(faces[piece], ex.Current());
+      builder.Add(meshed, ex.Current());
+      if (quality.relative) {
+        const int index = pieceFaces.FindIndex(ex.Current());
+        passes[QuarterOctaveBelow(index > 0 ? pieceDeflections[index - 1]
+                                            : quality.deflection)]
+            .push_back(ex.Current());
+      }
+    }
+  }
+  if ((thread && (count[kThreadCell] != 1 || count[kThreadCopies] != 1)) ||
+      (head && (count[kHeadCell] != 1 || count[kHeadCopies] != 1))) {
+    std::cerr << "Mesh: Periodic split gave unexpected pieces" << std::endl;
+    return TriMesh();
+  }
+
+  // As in MeshShape(), faces meshed by an earlier, finer pass are passed
+  // again and kept, so shared edges reuse their discretization
+  bool done = true;
+  if (!quality.relative) {
+    done = MeshShape(meshed, quality);
+  } else {
+    MeshQuality absolute = quality;
+    absolute.relative = false;
+    TopoDS_Compound pass;
+    builder.MakeCompound(pass);
+    for (const auto &group : passes) {
+      for (const TopoDS_Shape &face : group.second) {
+        builder.Add(pass, face);
+      }
+      absolute.deflection = group.first;
+      done = MeshShape(pass, absolute) && done;
+    }
+  }
+  if (!done) {
+    std::cerr << "Mesh: Mesh generation incomplete" << std::endl;
+    return TriMesh();
+  }
+  TriMesh mesh = ExtractTriMesh(faces[kRest]);
+  if (thread) {
+    AppendCopies(mesh, ExtractTriMesh(faces[kThreadCell]), layout.pitch, 0.0,
+                 layout.turns);
+  }
+  if (head) {
+    AppendCopies(mesh, ExtractTriMesh(faces[kHeadCell]), 0.0, sector,
+                 layout.sectors);
+  }
+  SeamStats seams = StitchSeams(mesh, weldTolerance, seamTolerance);
+  std::cout << "Mesh: Periodic, " << TriangleCount(meshed) << " of "
+            << mesh.TriangleCount() << " triangles meshed; seams "
+            << seams.merged << " welded, " << seams.splits << " split"
+            << std::endl;
+  return mesh;
+}
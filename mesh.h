@@ -0,0 +1,73 @@
+/*
+    BoltGenerator - Parallel meshing
+    Copyright (C) 2025
+*/
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <TopoDS_Shape.hxx>
+
+#include "trimesh.h"
+
+#include <cstddef>
+
+struct MeshQuality {
+  double deflection; // linear deflection (mm)
+  double angle;      // angular deflection (rad)
+  bool relative;     // deflection relative to edge size
+  // Scale deflection and angle per face by feature class (thread flanks and
+  // other freeform faces, cylinders and cones, fillets, planes) instead of
+  // meshing every face to the finest budget
+  bool adaptive;
+};
+
+// Triangulates every face of `shape` in place, meshing faces in parallel on
+// the OCCT thread pool. Faces are handed to BRepMesh longest-job-first, so
+// the few large helical faces start immediately and the many small planar
+// faces fill in around them instead of forming the tail. With an adaptive
+// quality the feature classes are meshed finest first, so the coarser faces
+// reuse the finer discretization of every edge they share and the mesh stays
+// watertight.
+bool MeshShape(const TopoDS_Shape &shape, const MeshQuality &quality);
+
+// Returns a triangulated copy of `shape` at the given quality. The first
+// request for a (shape, quality) pair sews and meshes the shape; later
+// requests from other mesh-based outputs (preview STL, download STL, GLB,
+// thumbnails) reuse that triangulation. Each quality level gets its own
+// topological copy, since a face holds a single triangulation.
+TopoDS_Shape MeshedShape(const TopoDS_Shape &shape, const MeshQuality &quality);
+
+// Symmetries of a part that meshing can exploit (see PeriodicTriMesh()).
+struct PeriodicLayout {
+  double threadStart; // the thread repeats unchanged from this height
+  double pitch;       // with this period
+  int turns;          // for this many pitches (0: no periodic thread)
+  double headStart;   // above this height the part is
+  int sectors;        // this-fold symmetric about the z axis (0: none)
+};
+
+// Meshes one pitch of the thread and one sector of the head instead of the
+// whole part, then replicates them and stitches the seams (see replicate.h).
+// The cells are split off a copy of the B-rep with planar cuts and meshed
+// with the rest at `quality`. A relative quality is applied per face at the
+// absolute deflection of the face it was cut from, so the cells are
+// triangulated as a full mesh would be there. Returns an empty mesh, for the caller to mesh `shape` as usual,
+// if the cuts do not produce the expected pieces.
+TriMesh PeriodicTriMesh(const TopoDS_Shape &shape, const MeshQuality &quality,
+                        const PeriodicLayout &layout, float weldTolerance,
+                        float seamTolerance);
+
+// Limits the number of worker threads MeshShape() uses (0 = all cores) by
+// configuring OCCT's shared thread pool. Call it at startup, before any
+// parallel work.
+void SetMeshThreads(int threads);
+
+std::size_t TriangleCount(const TopoDS_Shape &shape);
+
+// Copies the face triangulations of an already meshed shape into one indexed
+// mesh with vertex normals. Faces keep their own vertices; faceTriangles
+// maps triangles back to the faces in TopExp_Explorer order.
+TriMesh ExtractTriMesh(const TopoDS_Shape &shape);
+
+#endif // MESH_H
@@ -1,11 +1,15 @@
 #include "nut.h"
+#include "budget.h"
 #include "cut.h"
+#include "fillet.h"
+#include "manifest.h"
+#include "preflight.h"
+#include "progress.h"
+#include "simplify.h"
 #include "hexagon.h"
 #include "thread.h"
 #include <BRepAlgoAPI_Cut.hxx>
 #include <BRepAlgoAPI_Fuse.hxx>
-#include <BRepBuilderAPI_Transform.hxx>
-#include <BRepFilletAPI_MakeFillet.hxx>
 #include <BRepGProp.hxx>
 #include <BRepPrimAPI_MakeCylinder.hxx>
 #include <GProp_GProps.hxx>
@@ -14,11 +18,15 @@
 #include <TopExp_Explorer.hxx>
 #include <TopoDS.hxx>
 #include <TopoDS_Edge.hxx>
+#include <TopLoc_Location.hxx>
+#include <gp_Ax2.hxx>
+#include <gp_Dir.hxx>
 #include <gp_Pnt.hxx>
 #include <gp_Trsf.hxx>
 #include <gp_Vec.hxx>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
 Nut::Nut(const BoltParameters &p) : params(p) {
   double d = params.thread.majorDiameter;
@@ -44,8 +52,9 @@ Nut::Nut(const BoltParameters &p) : params(p) {
     TopoDS_Solid washer =
         BRepPrimAPI_MakeCylinder(0.5 * params.nut.washerFaceDiameter, wft)
             .Solid();
-    BRepAlgoAPI_Fuse washerFuse(hexOuter, washer);
-    washerFuse.Build();
+    Handle(CancelIndicator) progress = new CancelIndicator();
+    BRepAlgoAPI_Fuse washerFuse(hexOuter, washer, progress->Start());
+    ThrowIfCancelled("nut washer face fuse");
     if (washerFuse.IsDone()) {
       hexOuter = TopoDS::Solid(washerFuse.Shape());
     }
@@ -57,9 +66,7 @@ Nut::Nut(const BoltParameters &p) : params(p) {
   double cutterLength = h + 2.0 * overlap;
 
   // Calculate minor diameter for thread profile
-  double minorD = (params.thread.minorDiameter > 0)
-                      ? params.thread.minorDiameter
-                      : (d - 1.0825 * p_pitch);
+  double minorD = MinorDiameter(params);
 
   std::cout << "Nut: majorD=" << d << " minorD=" << minorD
             << " cutterLength=" << cutterLength << std::endl;
@@ -70,93 +77,136 @@ Nut::Nut(const BoltParameters &p) : params(p) {
   TopoDS_Solid shaftCylinder =
       BRepPrimAPI_MakeCylinder(shaftRadius, cutterLength).Solid();
 
-  // Create the helical thread profile to subtract from the shaft
-  // This cuts the thread grooves into our cutter cylinder
-  TopoDS_Solid threadCutter = Thread(minorD, p_pitch, cutterLength + p_pitch);
-
-  // Position thread to start before the shaft
-  gp_Trsf threadOffset;
-  threadOffset.SetTranslation(gp_Vec(0.0, 0.0, -0.5 * p_pitch));
-  BRepBuilderAPI_Transform threadPos(threadCutter, threadOffset, Standard_True);
-
-  // Create the threaded shaft by cutting thread grooves from the cylinder
+  // Create the threaded shaft by cutting thread grooves from the cylinder.
+  // Fallback ladder: helical grooves, then revolved grooves with the same
+  // pitch, then a plain bore; every step down is recorded in the manifest.
+  // Lower levels of detail start further down the ladder, unrecorded.
   std::cout << "Nut: Creating threaded shaft cutter..." << std::endl;
   TopoDS_Solid threadedShaft;
-  try {
-    threadedShaft = Cut(shaftCylinder, threadPos.Shape());
-  } catch (...) {
-    std::cerr << "Nut: Thread cut failed, using plain cylinder" << std::endl;
+  bool threaded = false;
+  std::string failure;
+  if (params.thread.lod == ThreadLod::NONE) {
     threadedShaft = shaftCylinder;
+    threaded = true;
+  } else if (params.thread.lod == ThreadLod::COSMETIC) {
+    // Bore at the pitch diameter, with the same fit clearance
+    threadedShaft = BRepPrimAPI_MakeCylinder(
+                        0.5 * PitchDiameter(params) + tol + threadClearance,
+                        cutterLength)
+                        .Solid();
+    threaded = true;
+  } else if (params.thread.lod == ThreadLod::FULL) {
+    StageBudget stage(kThreadBudgetShare);
+    try {
+      // Create the helical thread profile to subtract from the shaft
+      // This cuts the thread grooves into our cutter cylinder. The nut's
+      // roots are the cutter's crests and the other way round.
+      ThreadRounding rounding;
+      rounding.root = params.thread.crestRadius;
+      rounding.crest = params.thread.rootRadius;
+      rounding.blankDiameter = 2.0 * shaftRadius;
+      TopoDS_Solid threadCutter =
+          Thread(minorD, p_pitch, cutterLength + p_pitch, rounding);
+
+      // Position thread to start before the shaft. Only the location
+      // changes; the helical sweep is not copied.
+      gp_Trsf threadOffset;
+      threadOffset.SetTranslation(gp_Vec(0.0, 0.0, -0.5 * p_pitch));
+      threaded = TryCut(shaftCylinder,
+                        threadCutter.Moved(TopLoc_Location(threadOffset)),
+                        threadedShaft);
+      if (!threaded) {
+        failure = "thread groove cut failed";
+      }
+    } catch (const JobCancelled &) {
+      throw;
+    } catch (const std::exception &e) {
+      failure = e.what();
+    }
+    // Only a cut stopped at the deadline degrades; a late one is kept
+    if (!threaded && stage.Interrupted()) {
+      std::cout << "Nut: Thread over budget, using revolved grooves"
+                << std::endl;
+      ManifestAddEntry("degradations", "nut thread",
+                       "internal thread exceeded its time budget; replaced "
+                       "by revolved grooves");
+      failure.clear();
+    }
+  }
+  if (!threaded && !failure.empty()) {
+    std::cerr << "Nut: Helical thread failed (" << failure
+              << "), using revolved grooves" << std::endl;
+    ManifestAddEntry("fallbacks", "nut thread",
+                     "helical thread failed (" + failure +
+                         "); replaced by revolved grooves");
+  }
+  if (!threaded) {
+    try {
+      threadedShaft = SimplifiedThread(minorD, 2.0 * shaftRadius, p_pitch,
+                                       cutterLength);
+      threaded = true;
+    } catch (const JobCancelled &) {
+      throw;
+    } catch (const std::exception &e) {
+      std::cerr << "Nut: Revolved grooves failed (" << e.what()
+                << "), using plain bore" << std::endl;
+      ManifestAddEntry("fallbacks", "nut thread",
+                       std::string("revolved grooves failed (") + e.what() +
+                           "); plain bore used");
+      threadedShaft = shaftCylinder;
+    }
   }
 
   // Position the threaded shaft to pass through the nut
   gp_Trsf shaftTransform;
   shaftTransform.SetTranslation(gp_Vec(0.0, 0.0, -overlap));
-  BRepBuilderAPI_Transform shaftPos(threadedShaft, shaftTransform,
-                                    Standard_True);
+  const TopoDS_Shape shaftPos =
+      threadedShaft.Moved(TopLoc_Location(shaftTransform));
 
   // 3. Boolean subtract the threaded shaft from the hex to create internal
   // threads
   std::cout << "Nut: Cutting internal threads from hex body..." << std::endl;
-  try {
-    body = Cut(hexOuter, shaftPos.Shape());
+  if (TryCut(hexOuter, shaftPos, body)) {
     std::cout << "Nut: Internal threads created successfully" << std::endl;
-  } catch (const std::exception &e) {
-    std::cerr << "Nut: Boolean cut failed: " << e.what() << std::endl;
-    // Fallback: just cut a plain hole
+  } else {
+    std::cerr << "Nut: Boolean cut failed, cutting plain bore" << std::endl;
+    ManifestAddEntry("fallbacks", "nut thread",
+                     "internal thread cut failed; plain bore used");
     TopoDS_Solid plainHole =
-        BRepPrimAPI_MakeCylinder(shaftRadius, cutterLength).Solid();
-    gp_Trsf holeTransform;
-    holeTransform.SetTranslation(gp_Vec(0.0, 0.0, -overlap));
-    BRepBuilderAPI_Transform holePos(plainHole, holeTransform, Standard_True);
-    body = Cut(hexOuter, holePos.Shape());
+        BRepPrimAPI_MakeCylinder(
+            gp_Ax2(gp_Pnt(0.0, 0.0, -overlap), gp_Dir(0.0, 0.0, 1.0)),
+            shaftRadius, cutterLength)
+            .Solid();
+    if (!TryCut(hexOuter, plainHole, body)) {
+      throw std::runtime_error("Nut: Bore cut failed");
+    }
   }
 
+  // The washer face fuse and the bore cut leave split faces behind
+  body = Simplify("nut cleanup", body);
+
   // 4. Apply edge fillet for smooth edges
   double filletRadius = params.nut.edgeFilletRadius;
   if (filletRadius > 0.01) {
-    double maxSafeRadius = s * 0.1;
+    double maxSafeRadius = MaxNutFilletRadius(params);
     if (filletRadius > maxSafeRadius) {
       std::cout << "Nut Fillet: Clamping radius from " << filletRadius
                 << " to safe max " << maxSafeRadius << std::endl;
       filletRadius = maxSafeRadius;
     }
 
-    try {
-      std::cout << "Nut: Applying safe edge fillet radius: " << filletRadius
-                << std::endl;
-      BRepFilletAPI_MakeFillet fillet(body);
-      int edgesAdded = 0;
-
-      for (TopExp_Explorer ex(body, TopAbs_EDGE); ex.More(); ex.Next()) {
-        TopoDS_Edge edge = TopoDS::Edge(ex.Current());
-
-        GProp_GProps edgeProps;
-        BRepGProp::LinearProperties(edge, edgeProps);
-        double edgeLength = edgeProps.Mass();
-
-        if (edgeLength > filletRadius * 4.0) {
-          fillet.Add(filletRadius, edge);
-          edgesAdded++;
-        }
-      }
-
-      std::cout << "Nut Fillet: Added to " << edgesAdded << " edges"
-                << std::endl;
-
-      if (edgesAdded > 0) {
-        fillet.Build();
-        if (fillet.IsDone()) {
-          body = TopoDS::Solid(fillet.Shape());
-          std::cout << "Nut: Edge fillet applied successfully" << std::endl;
-        }
-      }
-    } catch (...) {
-      std::cerr << "Nut Fillet failed, keeping original geometry" << std::endl;
-    }
+    body = Fillet("nut fillet", body, filletRadius,
+                  [](const TopoDS_Edge &edge, double radius) {
+                    GProp_GProps edgeProps;
+                    BRepGProp::LinearProperties(edge, edgeProps);
+                    return edgeProps.Mass() > radius * 4.0;
+                  });
   }
 
   std::cout << "Nut: Generation complete" << std::endl;
 }
 
+Nut::Nut(const BoltParameters &p, const TopoDS_Solid &body)
+    : params(p), body(body) {}
+
 TopoDS_Solid Nut::Solid() { return body; }
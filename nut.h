@@ -13,6 +13,8 @@
 class Nut {
 public:
   Nut(const BoltParameters &);
+  // Wraps a body built earlier from the same parameters (result cache)
+  Nut(const BoltParameters &, const TopoDS_Solid &body);
   TopoDS_Solid Solid();
 
 private:
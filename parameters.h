@@ -9,6 +9,11 @@
 
 enum class HeadType { HEX = 0, SOCKET_CAP = 1, FLAT = 2, COUNTERSUNK = 3 };
 
+// How much of the thread is modelled: the helical sweep, revolved grooves
+// without a helix, a cosmetic cylinder at the pitch diameter (the thread
+// itself is described in the STEP header), or none (major diameter).
+enum class ThreadLod { FULL = 0, SIMPLIFIED = 1, COSMETIC = 2, NONE = 3 };
+
 struct HeadParameters {
   HeadType type;
   double widthAcrossFlats;      // s
@@ -41,6 +46,7 @@ struct ThreadParameters {
   double rootRadius;    // R
   double crestRadius;   // New: Radius of the thread crest
   double runout;        // thread runout length
+  ThreadLod lod;        // level of detail
 };
 
 struct NutParameters {
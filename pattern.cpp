@@ -0,0 +1,198 @@
+#include "pattern.h"
+#include "preflight.h"
+#include "washer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#include <gp_Ax1.hxx>
+#include <gp_Dir.hxx>
+#include <gp_Pnt.hxx>
+#include <gp_Vec.hxx>
+
+namespace {
+std::vector<std::string> Split(const std::string &text, char separator) {
+  std::vector<std::string> fields;
+  std::stringstream stream(text);
+  std::string field;
+  while (std::getline(stream, field, separator)) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+bool ParseNumber(const std::string &text, double &value) {
+  char *end = nullptr;
+  value = std::strtod(text.c_str(), &end);
+  return !text.empty() && *end == '\0' && std::isfinite(value);
+}
+
+bool ParseCount(const std::string &text, int &value) {
+  double number;
+  if (!ParseNumber(text, number) || number != std::floor(number) ||
+      number < 1 || number > kMaxPatternInstances) {
+    return false;
+  }
+  value = static_cast<int>(number);
+  return true;
+}
+
+// Turned by `angle` degrees about z, then moved to (x, y)
+gp_Trsf Placement(double x, double y, double angle) {
+  gp_Trsf turn;
+  turn.SetRotation(gp_Ax1(gp_Pnt(0.0, 0.0, 0.0), gp_Dir(0.0, 0.0, 1.0)),
+                   angle * M_PI / 180.0);
+  gp_Trsf move;
+  move.SetTranslation(gp_Vec(x, y, 0.0));
+  return move * turn;
+}
+
+std::string PartName(const BoltParameters &p, const char *part) {
+  std::ostringstream name;
+  name << part << " M" << p.thread.majorDiameter << "x" << p.thread.pitch;
+  if (std::string(part) == "bolt") {
+    name << "x" << p.shank.totalLength;
+  }
+  return name.str();
+}
+
+// Bottom of the nut on the bolt: two pitches above the tip, lowered if the
+// nut (and washer) would otherwise run past the end of the thread
+double NutBottom(const BoltParameters &p, bool washer) {
+  const double threadEnd = p.shank.totalLength - ClampedGripLength(p);
+  const double stack = p.nut.height + (washer ? Washer::Thickness(p) : 0.0);
+  return std::min(2.0 * p.thread.pitch, std::max(0.0, threadEnd - stack));
+}
+} // namespace
+
+bool ParsePattern(const std::string &text, PatternParameters &pattern) {
+  std::vector<std::string> fields = Split(text, ':');
+  if (fields.empty()) {
+    return false;
+  }
+  PatternParameters parsed;
+  parsed.washer = pattern.washer;
+  const std::string &type = fields[0];
+  if (type == "single" && fields.size() == 1) {
+    parsed.type = PatternType::SINGLE;
+  } else if (type == "circle" && (fields.size() == 3 || fields.size() == 4)) {
+    parsed.type = PatternType::CIRCLE;
+    if (!ParseCount(fields[1], parsed.count) ||
+        !ParseNumber(fields[2], parsed.radius) || parsed.radius < 0 ||
+        (fields.size() == 4 && !ParseNumber(fields[3], parsed.startAngle))) {
+      return false;
+    }
+  } else if (type == "grid" && fields.size() == 5) {
+    parsed.type = PatternType::GRID;
+    if (!ParseCount(fields[1], parsed.rows) ||
+        !ParseCount(fields[2], parsed.columns) ||
+        parsed.rows * parsed.columns > kMaxPatternInstances ||
+        !ParseNumber(fields[3], parsed.rowPitch) ||
+        !ParseNumber(fields[4], parsed.columnPitch)) {
+      return false;
+    }
+  } else if (type == "points" && fields.size() == 2) {
+    parsed.type = PatternType::POINTS;
+    for (const std::string &point : Split(fields[1], ';')) {
+      std::vector<std::string> coordinates = Split(point, ',');
+      PatternPlacement placement = {0.0, 0.0, 0.0};
+      if ((coordinates.size() != 2 && coordinates.size() != 3) ||
+          !ParseNumber(coordinates[0], placement.x) ||
+          !ParseNumber(coordinates[1], placement.y) ||
+          (coordinates.size() == 3 &&
+           !ParseNumber(coordinates[2], placement.angle))) {
+        return false;
+      }
+      parsed.placements.push_back(placement);
+    }
+    if (parsed.placements.empty() ||
+        parsed.placements.size() >
+            static_cast<std::size_t>(kMaxPatternInstances)) {
+      return false;
+    }
+  } else {
+    return false;
+  }
+  pattern = parsed;
+  return true;
+}
+
+std::vector<gp_Trsf> PatternInstances(const PatternParameters &pattern) {
+  std::vector<gp_Trsf> instances;
+  switch (pattern.type) {
+  case PatternType::SINGLE:
+    instances.push_back(gp_Trsf());
+    break;
+  case PatternType::CIRCLE:
+    // Each fastener turned with its position, so hex heads sit alike
+    // relative to the flange
+    for (int k = 0; k < pattern.count; ++k) {
+      const double angle = pattern.startAngle + 360.0 * k / pattern.count;
+      const double radians = angle * M_PI / 180.0;
+      instances.push_back(Placement(pattern.radius * std::cos(radians),
+                                    pattern.radius * std::sin(radians),
+                                    angle));
+    }
+    break;
+  case PatternType::GRID:
+    for (int row = 0; row < pattern.rows; ++row) {
+      for (int column = 0; column < pattern.columns; ++column) {
+        instances.push_back(Placement(
+            (column - 0.5 * (pattern.columns - 1)) * pattern.columnPitch,
+            (row - 0.5 * (pattern.rows - 1)) * pattern.rowPitch, 0.0));
+      }
+    }
+    break;
+  case PatternType::POINTS:
+    for (const PatternPlacement &placement : pattern.placements) {
+      instances.push_back(
+          Placement(placement.x, placement.y, placement.angle));
+    }
+    break;
+  }
+  return instances;
+}
+
+gp_Trsf AssembledNutPlacement(const BoltParameters &p, bool washer) {
+  const double h = p.nut.height;
+  gp_Trsf flip;
+  flip.SetRotation(gp_Ax1(gp_Pnt(0.0, 0.0, 0.5 * h), gp_Dir(1.0, 0.0, 0.0)),
+                   M_PI);
+  gp_Trsf lift;
+  lift.SetTranslation(gp_Vec(0.0, 0.0, NutBottom(p, washer)));
+  return lift * flip;
+}
+
+gp_Trsf AssembledWasherPlacement(const BoltParameters &p) {
+  gp_Trsf lift;
+  lift.SetTranslation(gp_Vec(0.0, 0.0, NutBottom(p, true) + p.nut.height));
+  return lift;
+}
+
+std::vector<AssemblyPart> PatternAssembly(const BoltParameters &p,
+                                          const PatternParameters &pattern,
+                                          const TopoDS_Shape &bolt,
+                                          const TopoDS_Shape &nut,
+                                          const TopoDS_Shape &washer) {
+  const std::vector<gp_Trsf> instances = PatternInstances(pattern);
+  const bool withWasher = !washer.IsNull();
+  std::vector<AssemblyPart> parts;
+  auto add = [&](const char *name, const TopoDS_Shape &shape,
+                 const gp_Trsf &local) {
+    AssemblyPart part{PartName(p, name), shape, {}};
+    for (const gp_Trsf &instance : instances) {
+      part.placements.push_back(instance * local);
+    }
+    parts.push_back(part);
+  };
+  add("bolt", bolt, gp_Trsf());
+  if (!nut.IsNull()) {
+    add("nut", nut, AssembledNutPlacement(p, withWasher));
+  }
+  if (withWasher) {
+    add("washer", washer, AssembledWasherPlacement(p));
+  }
+  return parts;
+}
@@ -0,0 +1,69 @@
+/*
+    BoltGenerator - Bolt patterns
+    Copyright (C) 2025
+*/
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <TopoDS_Shape.hxx>
+#include <gp_Trsf.hxx>
+
+#include <string>
+#include <vector>
+
+#include "export.h"
+#include "parameters.h"
+
+enum class PatternType { SINGLE, CIRCLE, GRID, POINTS };
+
+// One fastener of an explicit pattern: axis through (x, y) mm, turned by
+// `angle` degrees about it
+struct PatternPlacement {
+  double x;
+  double y;
+  double angle;
+};
+
+// Where the fasteners of an assembly go. The default is one fastener on the
+// z axis. Grids are centred on the origin.
+struct PatternParameters {
+  PatternType type = PatternType::SINGLE;
+  int count = 1;            // circle: fasteners on it
+  double radius = 0.0;      // circle: pitch circle radius
+  double startAngle = 0.0;  // circle: first fastener, degrees from +x
+  int rows = 1;             // grid: along y
+  int columns = 1;          // grid: along x
+  double rowPitch = 0.0;    // grid: y spacing
+  double columnPitch = 0.0; // grid: x spacing
+  std::vector<PatternPlacement> placements; // points
+  bool washer = false;      // plain washer under each nut
+};
+
+// More instances than this are rejected as a malformed request
+constexpr int kMaxPatternInstances = 1000;
+
+// Reads "circle:N:R[:start]", "grid:ROWS:COLUMNS:rowPitch:columnPitch" or
+// "points:x,y[,angle];x,y[,angle]..." into `pattern` (the washer flag is
+// left alone); false if malformed or out of range
+bool ParsePattern(const std::string &text, PatternParameters &pattern);
+
+// Frame of each fastener of the pattern: bolt axis along its z, bolt tip
+// at its origin
+std::vector<gp_Trsf> PatternInstances(const PatternParameters &pattern);
+
+// Nut (and washer) on an assembled bolt, in the bolt's frame: bearing face
+// towards the head, two pitches of thread showing past the nut (less if the
+// thread is short)
+gp_Trsf AssembledNutPlacement(const BoltParameters &p, bool washer);
+gp_Trsf AssembledWasherPlacement(const BoltParameters &p);
+
+// The parts of the pattern's assembly, each listed once with one placement
+// per instance. `nut` and `washer` may be null.
+std::vector<AssemblyPart> PatternAssembly(const BoltParameters &p,
+                                          const PatternParameters &pattern,
+                                          const TopoDS_Shape &bolt,
+                                          const TopoDS_Shape &nut,
+                                          const TopoDS_Shape &washer);
+
+#endif // PATTERN_H
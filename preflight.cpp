@@ -0,0 +1,258 @@
+#include "preflight.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace {
+// ISO 68-1 basic external thread depth h3 = 0.6134 P
+constexpr double kThreadDepthFactor = 0.6134;
+// Coarsest pitch the thread sweep handles reliably, as a fraction of d
+constexpr double kMaxPitchRatio = 0.25;
+// Minimum socket wall, as a fraction of the head diameter
+constexpr double kSocketWallRatio = 0.1;
+
+std::string Describe(const char *what, double value, const char *relation,
+                     double limit) {
+  std::ostringstream out;
+  out << what << " " << value << " " << relation << " " << limit;
+  return out.str();
+}
+
+void Fatal(std::vector<Violation> &out, const char *code, const char *field,
+           double value, const std::string &message) {
+  out.push_back({code, field, value, value, true, message});
+}
+
+void Clamp(std::vector<Violation> &out, const char *code, const char *field,
+           double value, double suggested, const std::string &message) {
+  out.push_back({code, field, value, suggested, false, message});
+}
+
+double AcrossCorners(double acrossFlats) {
+  return acrossFlats / std::cos(M_PI / 6.0);
+}
+} // namespace
+
+double MinorDiameter(const BoltParameters &p) {
+  return (p.thread.minorDiameter > 0)
+             ? p.thread.minorDiameter
+             : (p.thread.majorDiameter - 1.0825 * p.thread.pitch);
+}
+
+double PitchDiameter(const BoltParameters &p) {
+  // ISO 724: d2 = d - 0.6495P
+  return (p.thread.pitchDiameter > 0)
+             ? p.thread.pitchDiameter
+             : (p.thread.majorDiameter - 0.649519 * p.thread.pitch);
+}
+
+double ClampedGripLength(const BoltParameters &p) {
+  // Leave at least three pitches of thread below the grip
+  return std::max(0.0, std::min(p.shank.gripLength,
+                                p.shank.totalLength - 3.0 * p.thread.pitch));
+}
+
+double MaxEdgeFilletRadius(const BoltParameters &p) {
+  // 10% of the diameter, and never more than half the thread depth so the
+  // fillet cannot consume a flank
+  return std::min(0.1 * p.thread.majorDiameter,
+                  0.5 * kThreadDepthFactor * p.thread.pitch);
+}
+
+double MaxNutFilletRadius(const BoltParameters &p) {
+  return 0.1 * p.nut.widthAcrossFlats;
+}
+
+std::vector<Violation> Preflight(const BoltParameters &requested) {
+  std::vector<Violation> out;
+  // Constraints that depend on the pitch are evaluated on the parameters as
+  // ApplyClamps() will leave them, so their suggestions match what is built
+  BoltParameters p = requested;
+  const double d = p.thread.majorDiameter;
+  const double pitch = p.thread.pitch;
+  const double L = p.shank.totalLength;
+  const double s = p.head.widthAcrossFlats;
+  const double k = p.head.height;
+
+  // Dimensions every stage divides by or extrudes with
+  if (!(d > 0)) {
+    Fatal(out, "diameter_not_positive", "majorDiameter", d,
+          "Thread major diameter must be positive");
+  }
+  if (!(pitch > 0)) {
+    Fatal(out, "pitch_not_positive", "pitch", pitch,
+          "Thread pitch must be positive");
+  }
+  if (!(L > 0)) {
+    Fatal(out, "length_not_positive", "totalLength", L,
+          "Total length must be positive");
+  }
+  if (!(s > 0)) {
+    Fatal(out, "head_size_not_positive", "widthAcrossFlats", s,
+          "Head width must be positive");
+  }
+  if (!(k > 0)) {
+    Fatal(out, "head_height_not_positive", "headHeight", k,
+          "Head height must be positive");
+  }
+  if (!out.empty()) {
+    return out;
+  }
+
+  // Thread profile
+  if (pitch > kMaxPitchRatio * d) {
+    Clamp(out, "pitch_too_coarse", "pitch", pitch, kMaxPitchRatio * d,
+          Describe("Pitch", pitch, "exceeds coarse limit", kMaxPitchRatio * d));
+    p.thread.pitch = kMaxPitchRatio * d;
+  }
+  const double minorD = MinorDiameter(p);
+  if (minorD <= 0 || minorD >= d) {
+    Fatal(out, "minor_diameter_invalid", "minorDiameter", minorD,
+          Describe("Minor diameter", minorD, "must lie strictly between 0 and",
+                   d));
+  }
+  const double shankCap = d - p.shank.bodyTolerance;
+  if (p.shank.bodyTolerance < 0) {
+    Clamp(out, "body_tolerance_negative", "bodyTolerance",
+          p.shank.bodyTolerance, 0.0, "Body tolerance cannot be negative");
+  } else if (shankCap <= minorD && minorD > 0) {
+    Fatal(out, "body_below_minor_diameter", "bodyTolerance",
+          p.shank.bodyTolerance,
+          Describe("Shank diameter", shankCap, "is not above minor diameter",
+                   minorD));
+  }
+
+  // Thread() reduces radii too large for the pitch itself
+  if (p.thread.rootRadius < 0) {
+    Clamp(out, "root_radius_negative", "rootRadius", p.thread.rootRadius, 0.0,
+          "Thread root radius cannot be negative");
+  }
+  if (p.thread.crestRadius < 0) {
+    Clamp(out, "crest_radius_negative", "crestRadius", p.thread.crestRadius,
+          0.0, "Thread crest radius cannot be negative");
+  }
+
+  // Grip must leave three pitches of thread
+  if (p.shank.gripLength < 0) {
+    Clamp(out, "grip_negative", "gripLength", p.shank.gripLength, 0.0,
+          "Grip length cannot be negative");
+  } else if (p.shank.gripLength > ClampedGripLength(p)) {
+    Clamp(out, "grip_too_long", "gripLength", p.shank.gripLength,
+          ClampedGripLength(p),
+          Describe("Grip length", p.shank.gripLength, "exceeds L - 3P =",
+                   ClampedGripLength(p)));
+  }
+
+  // Head
+  if (s <= d) {
+    Fatal(out, "head_smaller_than_shank", "widthAcrossFlats", s,
+          Describe("Head width", s, "is not larger than diameter", d));
+  }
+  if (p.head.type == HeadType::SOCKET_CAP && p.head.socketSize > 0) {
+    // Socket cap heads are cylinders of diameter s; keep a wall around the
+    // socket corners
+    const double maxSocket =
+        (1.0 - 2.0 * kSocketWallRatio) * s * std::cos(M_PI / 6.0);
+    if (p.head.socketSize > maxSocket) {
+      Clamp(out, "socket_too_large", "socketSize", p.head.socketSize,
+            maxSocket,
+            Describe("Socket across corners", AcrossCorners(p.head.socketSize),
+                     "leaves no wall in head diameter", s));
+    }
+    if (p.head.socketDepth >= k) {
+      Clamp(out, "socket_too_deep", "socketDepth", p.head.socketDepth, 0.8 * k,
+            Describe("Socket depth", p.head.socketDepth,
+                     "reaches through head height", k));
+    }
+  }
+  if (p.head.washerFaceDiameter > 0 && p.head.washerFaceThickness > 0 &&
+      p.head.washerFaceDiameter > AcrossCorners(s)) {
+    Clamp(out, "washer_face_too_large", "washerFaceDiameter",
+          p.head.washerFaceDiameter, s,
+          Describe("Washer face diameter", p.head.washerFaceDiameter,
+                   "exceeds head across corners", AcrossCorners(s)));
+  }
+  const double maxUnderhead = std::min(0.5 * (s - d), 0.5 * k);
+  if (p.head.underheadFilletRadius > maxUnderhead && maxUnderhead > 0) {
+    Clamp(out, "underhead_fillet_too_large", "underheadFilletRadius",
+          p.head.underheadFilletRadius, maxUnderhead,
+          Describe("Underhead fillet", p.head.underheadFilletRadius,
+                   "exceeds head overhang limit", maxUnderhead));
+  }
+
+  // Fillets
+  if (p.shank.edgeFilletRadius > MaxEdgeFilletRadius(p)) {
+    Clamp(out, "fillet_too_large", "edgeFilletRadius", p.shank.edgeFilletRadius,
+          MaxEdgeFilletRadius(p),
+          Describe("Edge fillet", p.shank.edgeFilletRadius,
+                   "exceeds safe limit (10% d, half thread depth)",
+                   MaxEdgeFilletRadius(p)));
+  }
+
+  // Nut
+  if (p.nut.generate) {
+    const double bore = d + 2.0 * (p.nut.tolerance + p.nut.threadClearance);
+    if (!(p.nut.height > 0)) {
+      Fatal(out, "nut_height_not_positive", "nutHeight", p.nut.height,
+            "Nut height must be positive");
+    }
+    if (p.nut.widthAcrossFlats <= bore) {
+      Fatal(out, "nut_smaller_than_bore", "nutAcrossFlats",
+            p.nut.widthAcrossFlats,
+            Describe("Nut width", p.nut.widthAcrossFlats,
+                     "is not larger than bore", bore));
+    }
+    if (p.nut.tolerance < 0) {
+      Clamp(out, "nut_tolerance_negative", "nutTolerance", p.nut.tolerance,
+            0.0, "Nut tolerance cannot be negative");
+    }
+    if (p.nut.edgeFilletRadius > MaxNutFilletRadius(p) &&
+        p.nut.widthAcrossFlats > 0) {
+      Clamp(out, "nut_fillet_too_large", "nutEdgeFilletRadius",
+            p.nut.edgeFilletRadius, MaxNutFilletRadius(p),
+            Describe("Nut edge fillet", p.nut.edgeFilletRadius,
+                     "exceeds 10% of nut width", MaxNutFilletRadius(p)));
+    }
+  }
+
+  return out;
+}
+
+bool HasFatalViolation(const std::vector<Violation> &violations) {
+  return std::any_of(violations.begin(), violations.end(),
+                     [](const Violation &v) { return v.fatal; });
+}
+
+void ApplyClamps(BoltParameters &p, const std::vector<Violation> &violations) {
+  for (const Violation &v : violations) {
+    if (v.fatal) {
+      continue;
+    }
+    if (v.field == "pitch") {
+      p.thread.pitch = v.suggested;
+    } else if (v.field == "bodyTolerance") {
+      p.shank.bodyTolerance = v.suggested;
+    } else if (v.field == "rootRadius") {
+      p.thread.rootRadius = v.suggested;
+    } else if (v.field == "crestRadius") {
+      p.thread.crestRadius = v.suggested;
+    } else if (v.field == "gripLength") {
+      p.shank.gripLength = v.suggested;
+    } else if (v.field == "socketSize") {
+      p.head.socketSize = v.suggested;
+    } else if (v.field == "socketDepth") {
+      p.head.socketDepth = v.suggested;
+    } else if (v.field == "washerFaceDiameter") {
+      p.head.washerFaceDiameter = v.suggested;
+    } else if (v.field == "underheadFilletRadius") {
+      p.head.underheadFilletRadius = v.suggested;
+    } else if (v.field == "edgeFilletRadius") {
+      p.shank.edgeFilletRadius = v.suggested;
+    } else if (v.field == "nutTolerance") {
+      p.nut.tolerance = v.suggested;
+    } else if (v.field == "nutEdgeFilletRadius") {
+      p.nut.edgeFilletRadius = v.suggested;
+    }
+  }
+}
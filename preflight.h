@@ -0,0 +1,42 @@
+/*
+    BoltGenerator - Analytic feasibility pre-flight
+    Copyright (C) 2025
+*/
+
+#ifndef PREFLIGHT_H
+#define PREFLIGHT_H
+
+#include <string>
+#include <vector>
+
+#include "parameters.h"
+
+// One geometric constraint that the requested parameters break. Fatal
+// violations reject the job before any OCCT work; the others carry a
+// suggested value that ApplyClamps() substitutes.
+struct Violation {
+  std::string code;  // stable identifier, e.g. "grip_too_long"
+  std::string field; // parameter the violation is reported against
+  double value;      // requested value
+  double suggested;  // clamp to apply (only meaningful when !fatal)
+  bool fatal;
+  std::string message;
+};
+
+// Checks every constraint the construction code relies on, analytically and
+// without touching OCCT, so infeasible requests fail in microseconds. A
+// pitch clamp is applied before the constraints that depend on the pitch.
+std::vector<Violation> Preflight(const BoltParameters &requested);
+
+bool HasFatalViolation(const std::vector<Violation> &violations);
+void ApplyClamps(BoltParameters &p, const std::vector<Violation> &violations);
+
+// Limits shared by the pre-flight and the construction code, so both clamp
+// to the same values.
+double MinorDiameter(const BoltParameters &p);
+double PitchDiameter(const BoltParameters &p);
+double ClampedGripLength(const BoltParameters &p);
+double MaxEdgeFilletRadius(const BoltParameters &p);
+double MaxNutFilletRadius(const BoltParameters &p);
+
+#endif // PREFLIGHT_H
@@ -0,0 +1,40 @@
+#include "progress.h"
+#include "budget.h"
+
+#include <csignal>
+
+namespace {
+std::atomic<bool> cancelRequested(false);
+
+extern "C" void OnCancelSignal(int) { cancelRequested.store(true); }
+} // namespace
+
+void InstallCancelHandler() {
+  std::signal(SIGTERM, OnCancelSignal);
+  std::signal(SIGINT, OnCancelSignal);
+}
+
+bool CancelRequested() {
+  return cancelRequested.load(std::memory_order_relaxed);
+}
+
+void ThrowIfCancelled(const char *stage) {
+  if (CancelRequested()) {
+    throw JobCancelled(stage);
+  }
+}
+
+CancelIndicator::CancelIndicator(const std::atomic<bool> *stop,
+                                 bool stageDeadline)
+    : stopFlag(stop), followStageDeadline(stageDeadline) {}
+
+Standard_Boolean CancelIndicator::UserBreak() {
+  if (CancelRequested()) {
+    return Standard_True;
+  }
+  if (followStageDeadline && StageDeadlinePassed()) {
+    NoteStageInterrupted();
+    return Standard_True;
+  }
+  return stopFlag != nullptr && stopFlag->load(std::memory_order_relaxed);
+}
@@ -0,0 +1,54 @@
+/*
+    BoltGenerator - Progress and cancellation
+    Copyright (C) 2025
+*/
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <Message_ProgressIndicator.hxx>
+#include <Message_ProgressRange.hxx>
+#include <Message_ProgressScope.hxx>
+#include <Standard_Handle.hxx>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+// Thrown once the job has been cancelled so that the remaining stages unwind
+// instead of falling back to cheaper geometry nobody will look at.
+class JobCancelled : public std::runtime_error {
+public:
+  explicit JobCancelled(const std::string &stage)
+      : std::runtime_error("Job cancelled during " + stage) {}
+};
+
+// The server sends SIGTERM when the client disconnects; the handler only
+// raises a flag that every CancelIndicator polls.
+void InstallCancelHandler();
+bool CancelRequested();
+void ThrowIfCancelled(const char *stage);
+
+// Progress indicator whose only job is to tell OCCT algorithms when to stop.
+// Long operations poll UserBreak() through the Message_ProgressRange they are
+// given, so raising the job cancel flag (or the optional local stop flag), or
+// passing the active stage deadline, makes them return early with IsDone()
+// false. Work that runs beside the stages rather than in one (a background
+// writer) passes `stageDeadline` false so another thread's stage budget
+// cannot stop it.
+class CancelIndicator : public Message_ProgressIndicator {
+public:
+  explicit CancelIndicator(const std::atomic<bool> *stop = nullptr,
+                           bool stageDeadline = true);
+
+  Standard_Boolean UserBreak() override;
+
+  // Nothing is displayed; the indicator is only polled for cancellation.
+  void Show(const Message_ProgressScope &, const Standard_Boolean) override {}
+
+private:
+  const std::atomic<bool> *stopFlag;
+  bool followStageDeadline;
+};
+
+#endif // PROGRESS_H
@@ -0,0 +1,316 @@
+#include "replicate.h"
+#include "weld.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+// Splitting can expose new T-junctions only where three pieces meet, so a
+// couple of passes settle every seam
+constexpr int kMaxPasses = 4;
+
+// A vertex of the other side lies on the true curve between the edge's ends,
+// at most the arc's sagitta off the chord: about a tenth of the chord for
+// the angular deflections the meshes use. This bounds the distance searched,
+// in chord lengths, on top of the absolute seam tolerance.
+constexpr double kMaxSagitta = 0.2;
+
+// ...and its own open edges run along the same curve. Vertices across a
+// sharp corner of the seam (the other face of the same side) fail this.
+constexpr double kMinSeamCosine = 0.8;
+
+// 21 bits per axis; aliased cells only cost extra distance tests
+std::uint64_t CellKey(std::int64_t x, std::int64_t y, std::int64_t z) {
+  constexpr std::uint64_t kMask = (std::uint64_t(1) << 21) - 1;
+  return (static_cast<std::uint64_t>(x) & kMask) << 42 |
+         (static_cast<std::uint64_t>(y) & kMask) << 21 |
+         (static_cast<std::uint64_t>(z) & kMask);
+}
+
+// A vertex of the other side of a seam lying on edge k of a triangle
+struct Split {
+  std::size_t triangle;
+  int edge;     // edge k runs from corner k to corner (k + 1) % 3
+  float along;  // position along the edge, 0..1
+  std::uint32_t vertex;
+};
+
+// One pass of T-junction removal; returns the number of splits made
+std::size_t SplitOpenEdges(TriMesh &mesh, float weldTolerance,
+                           float seamTolerance) {
+  const std::vector<float> &p = mesh.positions;
+  std::vector<std::uint32_t> &indices = mesh.indices;
+  const std::size_t triangleCount = mesh.TriangleCount();
+
+  // Directed half-edges packed as (from << 32 | to), sorted for lookup
+  std::vector<std::uint64_t> halfEdges;
+  halfEdges.reserve(indices.size());
+  for (std::size_t i = 0; i < indices.size(); i += 3) {
+    for (int k = 0; k < 3; ++k) {
+      halfEdges.push_back(std::uint64_t(indices[i + k]) << 32 |
+                          indices[i + (k + 1) % 3]);
+    }
+  }
+  std::sort(halfEdges.begin(), halfEdges.end());
+
+  std::vector<std::pair<std::size_t, int>> openEdges; // (triangle, edge)
+  std::vector<std::uint32_t> openVertices;
+  // Both ends of every open edge, keyed by vertex: (vertex, other end)
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> openNeighbours;
+  double totalLength = 0.0;
+  for (std::size_t t = 0; t < triangleCount; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      const std::uint32_t a = indices[3 * t + k],
+                          b = indices[3 * t + (k + 1) % 3];
+      if (std::binary_search(halfEdges.begin(), halfEdges.end(),
+                             std::uint64_t(b) << 32 | a)) {
+        continue;
+      }
+      openEdges.push_back({t, k});
+      openVertices.push_back(a);
+      openVertices.push_back(b);
+      openNeighbours.push_back({a, b});
+      openNeighbours.push_back({b, a});
+      const float dx = p[3 * b] - p[3 * a], dy = p[3 * b + 1] - p[3 * a + 1],
+                  dz = p[3 * b + 2] - p[3 * a + 2];
+      totalLength += std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+  }
+  if (openEdges.empty()) {
+    return 0;
+  }
+  std::sort(openNeighbours.begin(), openNeighbours.end());
+  std::sort(openVertices.begin(), openVertices.end());
+  openVertices.erase(std::unique(openVertices.begin(), openVertices.end()),
+                     openVertices.end());
+
+  // Grid cells about as long as a typical open edge, so an edge's search box
+  // spans a handful of cells
+  const double cell =
+      std::max<double>(2.0 * seamTolerance, totalLength / openEdges.size());
+  auto cellOf = [&](double v) {
+    return static_cast<std::int64_t>(std::floor(v / cell));
+  };
+  std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> grid;
+  for (std::uint32_t v : openVertices) {
+    grid[CellKey(cellOf(p[3 * v]), cellOf(p[3 * v + 1]), cellOf(p[3 * v + 2]))]
+        .push_back(v);
+  }
+
+  std::vector<Split> splits;
+  for (const std::pair<std::size_t, int> &open : openEdges) {
+    const std::size_t t = open.first;
+    const int k = open.second;
+    const std::uint32_t a = indices[3 * t + k],
+                        b = indices[3 * t + (k + 1) % 3];
+    const float *pa = &p[3 * a], *pb = &p[3 * b];
+    const double ex = pb[0] - pa[0], ey = pb[1] - pa[1], ez = pb[2] - pa[2];
+    const double length2 = ex * ex + ey * ey + ez * ez;
+    if (length2 <= 0.0) {
+      continue;
+    }
+    const double length = std::sqrt(length2);
+    // Vertices this close to an end are that end, not a T-junction
+    const double margin = weldTolerance / length;
+    const double reach = std::max<double>(seamTolerance, kMaxSagitta * length);
+    const double reach2 = reach * reach;
+
+    std::int64_t lo[3], hi[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      lo[axis] = cellOf(std::min(pa[axis], pb[axis]) - reach);
+      hi[axis] = cellOf(std::max(pa[axis], pb[axis]) + reach);
+    }
+    for (std::int64_t x = lo[0]; x <= hi[0]; ++x) {
+      for (std::int64_t y = lo[1]; y <= hi[1]; ++y) {
+        for (std::int64_t z = lo[2]; z <= hi[2]; ++z) {
+          auto found = grid.find(CellKey(x, y, z));
+          if (found == grid.end()) {
+            continue;
+          }
+          for (std::uint32_t v : found->second) {
+            if (v == a || v == b) {
+              continue;
+            }
+            const float *pv = &p[3 * v];
+            const double vx = pv[0] - pa[0], vy = pv[1] - pa[1],
+                         vz = pv[2] - pa[2];
+            const double along = (vx * ex + vy * ey + vz * ez) / length2;
+            if (along <= margin || along >= 1.0 - margin) {
+              continue;
+            }
+            const double dx = vx - along * ex, dy = vy - along * ey,
+                         dz = vz - along * ez;
+            if (dx * dx + dy * dy + dz * dz > reach2) {
+              continue;
+            }
+            auto neighbours = std::equal_range(
+                openNeighbours.begin(), openNeighbours.end(),
+                std::make_pair(v, std::uint32_t(0)),
+                [](const std::pair<std::uint32_t, std::uint32_t> &l,
+                   const std::pair<std::uint32_t, std::uint32_t> &r) {
+                  return l.first < r.first;
+                });
+            bool alongSeam = false;
+            for (auto n = neighbours.first; n != neighbours.second; ++n) {
+              const float *pn = &p[3 * n->second];
+              const double nx = pn[0] - pv[0], ny = pn[1] - pv[1],
+                           nz = pn[2] - pv[2];
+              const double dot = nx * ex + ny * ey + nz * ez;
+              const double norm2 = (nx * nx + ny * ny + nz * nz) * length2;
+              if (dot * dot >= kMinSeamCosine * kMinSeamCosine * norm2) {
+                alongSeam = true;
+                break;
+              }
+            }
+            if (alongSeam) {
+              splits.push_back({t, k, static_cast<float>(along), v});
+            }
+          }
+        }
+      }
+    }
+  }
+  if (splits.empty()) {
+    return 0;
+  }
+
+  // Aliased grid cells can report a vertex twice
+  std::sort(splits.begin(), splits.end(), [](const Split &l, const Split &r) {
+    if (l.triangle != r.triangle) {
+      return l.triangle < r.triangle;
+    }
+    if (l.edge != r.edge) {
+      return l.edge < r.edge;
+    }
+    return l.along < r.along;
+  });
+  splits.erase(std::unique(splits.begin(), splits.end(),
+                           [](const Split &l, const Split &r) {
+                             return l.triangle == r.triangle &&
+                                    l.vertex == r.vertex;
+                           }),
+               splits.end());
+
+  // Rebuild face by face, so every face keeps a contiguous triangle range
+  std::vector<std::uint32_t> rebuilt;
+  rebuilt.reserve(indices.size() + 6 * splits.size());
+  std::vector<std::uint32_t> faceTriangles = mesh.faceTriangles;
+  if (faceTriangles.empty()) {
+    faceTriangles = {0, static_cast<std::uint32_t>(triangleCount)};
+  }
+  std::size_t next = 0; // first split not yet used
+  std::vector<std::uint32_t> polygon;
+  for (std::size_t f = 0; f + 1 < faceTriangles.size(); ++f) {
+    const std::size_t begin = faceTriangles[f], end = faceTriangles[f + 1];
+    faceTriangles[f] = static_cast<std::uint32_t>(rebuilt.size() / 3);
+    for (std::size_t t = begin; t < end; ++t) {
+      const std::uint32_t *corner = &indices[3 * t];
+      if (next == splits.size() || splits[next].triangle != t) {
+        rebuilt.insert(rebuilt.end(), corner, corner + 3);
+        continue;
+      }
+
+      // The triangle's outline with the split vertices, counter-clockwise
+      polygon.clear();
+      int splitEdges = 0, lastEdge = 0;
+      for (int k = 0; k < 3; ++k) {
+        polygon.push_back(corner[k]);
+        bool split = false;
+        for (; next < splits.size() && splits[next].triangle == t &&
+               splits[next].edge == k;
+             ++next) {
+          polygon.push_back(splits[next].vertex);
+          split = true;
+        }
+        if (split) {
+          ++splitEdges;
+          lastEdge = k;
+        }
+      }
+
+      if (splitEdges == 1) {
+        // Fan from the corner facing the split edge
+        const std::uint32_t apex = corner[(lastEdge + 2) % 3];
+        const std::size_t start = std::find(polygon.begin(), polygon.end(),
+                                            corner[lastEdge]) -
+                                  polygon.begin();
+        const std::size_t n = polygon.size();
+        for (std::size_t i = 0; i + 2 < n; ++i) {
+          rebuilt.insert(rebuilt.end(), {apex, polygon[(start + i) % n],
+                                         polygon[(start + i + 1) % n]});
+        }
+      } else {
+        // Splits on several edges: fan from a new vertex at the centroid,
+        // which stays in the triangle's plane
+        std::uint32_t centre = static_cast<std::uint32_t>(mesh.VertexCount());
+        for (int axis = 0; axis < 3; ++axis) {
+          mesh.positions.push_back((p[3 * corner[0] + axis] +
+                                    p[3 * corner[1] + axis] +
+                                    p[3 * corner[2] + axis]) /
+                                   3.0f);
+        }
+        for (std::size_t i = 0; i < polygon.size(); ++i) {
+          rebuilt.insert(rebuilt.end(),
+                         {centre, polygon[i],
+                          polygon[(i + 1) % polygon.size()]});
+        }
+      }
+    }
+  }
+  faceTriangles.back() = static_cast<std::uint32_t>(rebuilt.size() / 3);
+  if (!mesh.faceTriangles.empty()) {
+    mesh.faceTriangles = std::move(faceTriangles);
+  }
+  indices = std::move(rebuilt);
+  return splits.size();
+}
+} // namespace
+
+void AppendCopies(TriMesh &mesh, const TriMesh &cell, double dz, double angle,
+                  int count) {
+  if (mesh.faceTriangles.empty()) {
+    mesh.faceTriangles.push_back(
+        static_cast<std::uint32_t>(mesh.TriangleCount()));
+  }
+  std::vector<std::uint32_t> cellFaces = cell.faceTriangles;
+  if (cellFaces.empty()) {
+    cellFaces = {0, static_cast<std::uint32_t>(cell.TriangleCount())};
+  }
+  mesh.normals.clear();
+
+  for (int m = 0; m < count; ++m) {
+    const double c = std::cos(m * angle), s = std::sin(m * angle);
+    const std::uint32_t base = static_cast<std::uint32_t>(mesh.VertexCount());
+    const std::uint32_t firstTriangle =
+        static_cast<std::uint32_t>(mesh.TriangleCount());
+    for (std::size_t v = 0; v < cell.VertexCount(); ++v) {
+      const float *q = &cell.positions[3 * v];
+      mesh.positions.push_back(static_cast<float>(c * q[0] - s * q[1]));
+      mesh.positions.push_back(static_cast<float>(s * q[0] + c * q[1]));
+      mesh.positions.push_back(static_cast<float>(q[2] + m * dz));
+    }
+    for (std::uint32_t index : cell.indices) {
+      mesh.indices.push_back(base + index);
+    }
+    for (std::size_t f = 1; f < cellFaces.size(); ++f) {
+      mesh.faceTriangles.push_back(firstTriangle + cellFaces[f]);
+    }
+  }
+}
+
+SeamStats StitchSeams(TriMesh &mesh, float weldTolerance, float seamTolerance) {
+  SeamStats stats{WeldVertices(mesh, weldTolerance).merged, 0};
+  for (int pass = 0; pass < kMaxPasses; ++pass) {
+    const std::size_t splits =
+        SplitOpenEdges(mesh, weldTolerance, seamTolerance);
+    if (splits == 0) {
+      break;
+    }
+    stats.splits += splits;
+  }
+  return stats;
+}
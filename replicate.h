@@ -0,0 +1,33 @@
+/*
+    BoltGenerator - Periodic mesh replication
+    Copyright (C) 2025
+*/
+
+#ifndef REPLICATE_H
+#define REPLICATE_H
+
+#include "trimesh.h"
+
+#include <cstddef>
+
+struct SeamStats {
+  std::size_t merged; // vertices folded into another vertex
+  std::size_t splits; // triangle edges split at a vertex of the other side
+};
+
+// Appends `count` copies of `cell` to `mesh`: copy m is turned by m * angle
+// (rad) about the z axis and moved m * dz along it, so copy 0 lands where
+// the cell is. Each copy keeps its own faces in the face mapping.
+void AppendCopies(TriMesh &mesh, const TriMesh &cell, double dz, double angle,
+                  int count);
+
+// Closes the seams of a mesh assembled from separately triangulated pieces.
+// Vertices closer than `weldTolerance` are merged (see WeldVertices()). Then
+// every open edge is split at the open-edge vertices that lie along it:
+// within `seamTolerance`, or the sagitta of a curved seam, of the edge and
+// running in its direction. After that, a seam whose two sides were
+// discretized differently (T-junctions) matches vertex for vertex. Normals
+// are cleared.
+SeamStats StitchSeams(TriMesh &mesh, float weldTolerance, float seamTolerance);
+
+#endif // REPLICATE_H
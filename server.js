@@ -1,11 +1,28 @@
 const express = require('express');
-const { exec } = require('child_process');
+const { spawn } = require('child_process');
 const path = require('path');
 const fs = require('fs');
+const zlib = require('zlib');
 
 const app = express();
 const port = process.env.PORT || 3000;
 
+// Engine binary; ENGINE points the server at another build (or a stand-in)
+const engine = process.env.ENGINE || './scim_bolts';
+
+// Default latency budget per job; stages that overrun their share degrade
+// (simplified thread, skipped cosmetic fillet, coarser mesh) instead of
+// running unbounded. Requests may override it with budgetMs (0 = unbounded).
+const defaultBudgetMs = parseFloat(process.env.JOB_BUDGET_MS) || 15000;
+
+// Finished solids are cached as binary B-reps keyed by their parameters, so
+// repeated jobs and restarted sessions read them back instead of rebuilding.
+// RESULT_CACHE_DIR= (empty) disables the cache.
+const resultCacheDir = process.env.RESULT_CACHE_DIR !== undefined
+    ? process.env.RESULT_CACHE_DIR
+    : path.join(__dirname, 'Tests', 'cache');
+if (resultCacheDir) fs.mkdirSync(resultCacheDir, { recursive: true });
+
 app.use(express.urlencoded({ extended: true }));
 app.use(express.json());
 app.use(express.static('public'));
@@ -14,32 +31,47 @@ app.get('/', (req, res) => {
     res.sendFile(path.join(__dirname, 'public', 'index.html'));
 });
 
-app.post('/generate', (req, res) => {
-    const p = req.body;
+// The engine writes a JSON manifest next to its outputs describing what it
+// actually produced (clamps, degradations, rejection reasons)
+function readManifest(filename) {
+    const manifestFile = path.join(__dirname, 'Tests', `${filename}.json`);
+    if (!fs.existsSync(manifestFile)) return null;
+    try {
+        return JSON.parse(fs.readFileSync(manifestFile, 'utf8'));
+    } catch (e) {
+        console.error(`Unreadable manifest ${manifestFile}: ${e.message}`);
+        return null;
+    }
+}
 
-    // Debug: Log received parameters
-    console.log('Received parameters for generation:', p);
-
-    const filename = `bolt_${Date.now()}`;
+// Map frontend fields to CLI arguments (Matching main.cpp order).
+// Feasibility checks and clamping live in the engine's pre-flight, which
+// rejects infeasible sets before any geometry work.
+// Bolt pattern of an assembly request, in the engine's --pattern syntax:
+// { type: 'circle', count, radius, startAngle }, { type: 'grid', rows,
+// columns, rowPitch, columnPitch } or { type: 'points', placements: [{ x, y,
+// angle }] }; a string is passed through as it is
+function patternArg(pattern) {
+    if (typeof pattern === 'string') {
+        return pattern;
+    }
+    const num = value => parseFloat(value) || 0;
+    switch (pattern.type) {
+        case 'circle':
+            return `circle:${parseInt(pattern.count, 10)}:${num(pattern.radius)}:${num(pattern.startAngle)}`;
+        case 'grid':
+            return `grid:${parseInt(pattern.rows, 10)}:${parseInt(pattern.columns, 10)}:` +
+                `${num(pattern.rowPitch)}:${num(pattern.columnPitch)}`;
+        case 'points':
+            return 'points:' + (pattern.placements || [])
+                .map(pt => `${num(pt.x)},${num(pt.y)},${num(pt.angle)}`).join(';');
+        default:
+            return null;
+    }
+}
 
-    // Map frontend fields to CLI arguments (Matching main.cpp order)
-    // Clamping and validation for robustness
-    const L = parseFloat(p.totalLength) || 10;
-    const grip = parseFloat(p.gripLength) || 0;
-    const pitch = parseFloat(p.threadPitch) || 1.25;
-    const d = parseFloat(p.nominalDiameter) || 8;
-
-    // Ensure grip is never > L - 2*pitch
-    const clampedGrip = Math.min(grip, L - (2 * pitch));
-    // Clamp pitch to safe range (1.0 to max based on diameter)
-    const clampedPitch = Math.max(1.0, Math.min(p.pitch || 1.75, d * 0.2));
-
-    // Clamp fillet radii to safe maximum (10% of relevant dimension)
-    // This prevents geometry corruption from oversized fillets
-    const maxBoltFillet = d * 0.1;
-    const maxNutFillet = (p.nutAcrossFlats || d * 1.5) * 0.1;
-    const clampedBoltFillet = Math.max(0, Math.min(p.edgeFilletRadius || 0.2, maxBoltFillet));
-    const clampedNutFillet = Math.max(0, Math.min(p.nutEdgeFilletRadius || 0.2, maxNutFillet));
+function engineArgs(filename, p) {
+    const d = p.nominalDiameter || 8;
 
     const args = [
         filename,
@@ -52,19 +84,19 @@ app.post('/generate', (req, res) => {
         p.socketSize || 0,
         p.socketDepth || 0,
         d,
-        L,
-        clampedGrip,
+        p.totalLength || 10,
+        p.gripLength || 0,
         p.bodyTolerance || 0,
         p.majorDiameter || d,
-        clampedPitch,
+        p.threadPitch || 1.25,
         p.minorDiameter || 0,
         p.generateNut ? 1 : 0,
         p.nutAcrossFlats || 0,
         p.nutHeight || 0,
         p.nutWasherFace || 0,
         p.nutTolerance || 0.15,
-        clampedBoltFillet,  // Safe bolt edge fillet
-        clampedNutFillet,    // Safe nut edge fillet
+        p.edgeFilletRadius || 0.2,
+        p.nutEdgeFilletRadius || 0.2,
         // New Parameters
         p.topFilletRadius || 0,
         p.verticalChamfer || 0,
@@ -75,46 +107,406 @@ app.post('/generate', (req, res) => {
         p.toleranceClass || "6g"
     ];
 
-    const command = `./scim_bolts ${args.join(' ')}`;
-    console.log('Executing:', command);
+    // Race exact and fuzzy boolean strategies to cut tail latency on
+    // pathological parameter sets (costs extra cores per job)
+    if (p.raceBooleans || process.env.RACE_BOOLEANS === '1') {
+        args.push('--race-booleans');
+    }
+
+    // Previews tessellated from the parameters arrive in milliseconds; the
+    // kernel still builds every download
+    if (p.meshPreview || process.env.MESH_PREVIEW === '1') {
+        // Same previews, combined from meshed primitives by mesh booleans
+        args.push('--preview=mesh');
+    } else if (p.analyticPreview || process.env.ANALYTIC_PREVIEW === '1') {
+        args.push('--preview=analytic');
+    }
+    // Bolt downloads mesh one thread pitch and one head sector, then
+    // instance; opt-in until `make bench-periodic` shows it is faster
+    if (p.periodicMesh || process.env.PERIODIC_MESH === '1') {
+        args.push('--periodic-mesh');
+    }
+
+    // Binary B-rep downloads (BinTools) instead of ASCII, which stays the
+    // interchange default
+    if ((p.brepFormat || process.env.BREP_FORMAT) === 'binary') {
+        args.push('--brep-format=binary');
+    }
+    if (resultCacheDir) {
+        args.push(`--cache-dir=${resultCacheDir}`);
+    }
+
+    // Flange patterns: one bolt, nut (and washer) built, placed N times in
+    // the assembly outputs
+    const pattern = p.pattern ? patternArg(p.pattern) : null;
+    if (pattern) {
+        args.push(`--pattern=${pattern}`);
+    }
+    if (p.washer) {
+        args.push('--washer');
+    }
+
+    // ISO 68-1 root radius, swept with the thread profile
+    const rootRadius = Number(p.rootRadius);
+    if (rootRadius > 0) {
+        args.push(`--root-radius=${rootRadius}`);
+    }
+
+    // Thread level of detail: full, simplified, cosmetic or none
+    const threadLod = p.threadLod || process.env.THREAD_LOD;
+    if (threadLod) {
+        args.push(`--thread-lod=${threadLod}`);
+    }
+
+    // Preview meshes only need sub-pixel accuracy at the viewer's size
+    const screenPx = parseInt(p.viewerPx, 10);
+    if (screenPx > 0) {
+        args.push(`--screen-px=${screenPx}`);
+    }
+
+    const budgetMs = p.budgetMs !== undefined ? parseFloat(p.budgetMs) : defaultBudgetMs;
+    if (budgetMs > 0) {
+        args.push(`--budget-ms=${budgetMs}`);
+    }
+
+    // Only the previews are written up front; the engine stays up as a
+    // session and writes each download when it is first requested
+    if (!(p.eagerOutputs || process.env.EAGER_OUTPUTS === '1')) {
+        args.push('--outputs=preview', '--session');
+    } else {
+        args.push(p.pattern ? '--outputs=preview,brep,stl,step,assembly'
+                            : '--outputs=preview,brep,stl,step');
+    }
+    return args;
+}
+
+// Finished jobs keep their engine process as a session holding the built
+// parts, so a download costs one writer run instead of a regeneration.
+// Sessions end after SESSION_IDLE_MS without a request; beyond MAX_SESSIONS
+// the least recently used one ends.
+const sessionIdleMs = parseInt(process.env.SESSION_IDLE_MS, 10) || 600000;
+const maxSessions = parseInt(process.env.MAX_SESSIONS, 10) || 16;
+const sessions = new Map(); // job name -> session, least recently used first
+const reopening = new Map(); // job name -> promise of a restarted session
+
+// Parameters of recent jobs: a download after the session has ended
+// restarts it from them
+const jobParams = new Map();
+const jobParamsMs = 24 * 3600 * 1000;
+
+function rememberJob(filename, p) {
+    jobParams.set(filename, p);
+    setTimeout(() => jobParams.delete(filename), jobParamsMs);
+}
+
+function readLines(stream, onLine) {
+    let buffer = '';
+    stream.setEncoding('utf8');
+    stream.on('data', chunk => {
+        buffer += chunk;
+        let end;
+        while ((end = buffer.indexOf('\n')) >= 0) {
+            onLine(buffer.slice(0, end));
+            buffer = buffer.slice(end + 1);
+        }
+    });
+}
+
+// Runs the engine without a shell, so killing the child really stops the
+// geometry kernel. `finished` resolves with 0 once the job is done (the
+// session reports ready, or the engine exits cleanly) and with the exit code
+// if it fails first. Session replies arrive on the fourth pipe.
+function startEngine(filename, args, streamStdout) {
+    const child = spawn(engine, args.map(String), {
+        stdio: ['pipe', streamStdout ? 'pipe' : 'ignore', 'pipe', 'pipe']
+    });
+    const session = { child, ready: false, waiting: new Map(), timer: null, stderrTail: '' };
+
+    // Engine logs go to stderr in stream mode; keep the tail for errors
+    child.stderr.on('data', chunk => {
+        session.stderrTail = (session.stderrTail + chunk).slice(-4096);
+    });
+    // The engine may exit before reading its requests
+    child.stdin.on('error', () => {});
+
+    let finish;
+    session.finished = new Promise(resolve => { finish = resolve; });
+    readLines(child.stdio[3], line => {
+        const [status, file, ...reason] = line.split(' ');
+        if (status === 'ready') {
+            session.ready = true;
+            touchSession(filename, session);
+            finish(0);
+            return;
+        }
+        const callbacks = session.waiting.get(file) || [];
+        session.waiting.delete(file);
+        callbacks.forEach(done => done(status === 'ok' ? null : new Error(reason.join(' '))));
+    });
+    child.on('close', code => {
+        finish(code === null ? 1 : code);
+        if (sessions.get(filename) === session) sessions.delete(filename);
+        clearTimeout(session.timer);
+        for (const callbacks of session.waiting.values()) {
+            callbacks.forEach(done => done(new Error('Engine session ended')));
+        }
+        session.waiting.clear();
+    });
+    return session;
+}
+
+// Marks the session as just used and restarts its idle timer
+function touchSession(filename, session) {
+    sessions.delete(filename);
+    sessions.set(filename, session);
+    clearTimeout(session.timer);
+    session.timer = setTimeout(() => endSession(filename, session), sessionIdleMs);
+    while (sessions.size > maxSessions) {
+        const [oldest, oldestSession] = sessions.entries().next().value;
+        endSession(oldest, oldestSession);
+    }
+}
+
+// EOF on stdin: the engine answers the requests already sent, then exits
+function endSession(filename, session) {
+    if (sessions.get(filename) === session) sessions.delete(filename);
+    clearTimeout(session.timer);
+    session.child.stdin.end();
+}
+
+function requestOutput(session, file) {
+    return new Promise((resolve, reject) => {
+        const callbacks = session.waiting.get(file) || [];
+        callbacks.push(error => (error ? reject(error) : resolve()));
+        session.waiting.set(file, callbacks);
+        if (callbacks.length === 1) session.child.stdin.write(`${file}\n`);
+    });
+}
+
+// Path of a job output, asking the job's session to write it if it does not
+// exist yet; null if the job is unknown
+async function materialize(file) {
+    const target = path.join(__dirname, 'Tests', file);
+    if (fs.existsSync(target)) return target;
+
+    const job = file.replace(/(_nut|_assembly)?\.[a-z]+$/, '');
+    let session = sessions.get(job);
+    if (!session) {
+        const p = jobParams.get(job);
+        if (!p) return null;
+        if (!reopening.has(job)) {
+            console.log(`Restarting session for ${job}`);
+            const restarted = startEngine(job, [...engineArgs(job, p), '--outputs=', '--session'], false);
+            reopening.set(job, restarted.finished.then(code => {
+                reopening.delete(job);
+                return code === 0 ? restarted : null;
+            }));
+        }
+        session = await reopening.get(job);
+        if (!session) return null;
+    }
+    touchSession(job, session);
+    await requestOutput(session, file);
+    return target;
+}
+
+// Decimated preview levels of one GLB, finest first
+function previewLods(manifest, glbName) {
+    return (manifest.lods || [])
+        .filter(lod => path.basename(lod.source) === glbName)
+        .map(lod => ({ url: `/preview/${path.basename(lod.output)}`, triangles: lod.triangles }));
+}
+
+function jobResult(filename, p, manifest) {
+    const result = {
+        success: true,
+        filename: filename,
+        boltBrep: `/download/${filename}.brep`,
+        boltBrepBinary: `/download/${filename}.bbrep`,
+        boltStl: `/preview/${filename}.stl`,
+        boltGlb: `/preview/${filename}.glb`
+    };
+
+    if (p.generateNut) {
+        result.nutBrep = `/download/${filename}_nut.brep`;
+        result.nutBrepBinary = `/download/${filename}_nut.bbrep`;
+        result.nutStl = `/preview/${filename}_nut.stl`;
+        result.nutGlb = `/preview/${filename}_nut.glb`;
+    }
 
-    exec(command, (error, stdout, stderr) => {
-        if (error) {
-            console.error(`Generation error: ${error.message}`);
+    // STEP is written on request (a cosmetic thread is only described there);
+    // the assembly holds the bolt with the nut screwed on
+    result.boltStep = `/download/${filename}.step`;
+    result.assemblyStep = `/download/${filename}_assembly.step`;
+    if (p.generateNut) {
+        result.nutStep = `/download/${filename}_nut.step`;
+    }
+    if (p.pattern) {
+        result.assemblyGlb = `/preview/${filename}_assembly.glb`;
+    }
+
+    // The manifest records which clamps and degradations the engine applied
+    if (manifest) {
+        result.manifest = manifest;
+        result.boltLods = previewLods(manifest, `${filename}.glb`);
+        if (p.generateNut) {
+            result.nutLods = previewLods(manifest, `${filename}_nut.glb`);
+        }
+    }
+    return result;
+}
+
+app.post('/generate', (req, res) => {
+    const p = req.body;
+
+    // Debug: Log received parameters
+    console.log('Received parameters for generation:', p);
+
+    const filename = `bolt_${Date.now()}`;
+
+    const args = engineArgs(filename, p);
+
+    console.log(`Executing: ${engine}`, args.join(' '));
+
+    rememberJob(filename, p);
+    const session = startEngine(filename, args, false);
+    session.finished.then(code => {
+        if (res.writableEnded || res.destroyed) return;
+        const manifest = readManifest(filename);
+        if (code === 2) {
+            // Rejected by the pre-flight: the parameters are infeasible
+            return res.status(400).json({
+                success: false,
+                error: "Parameters are geometrically infeasible.",
+                violations: manifest ? manifest.violations : []
+            });
+        }
+        if (code !== 0) {
+            console.error(`Generation error (exit ${code}): ${session.stderrTail.slice(-500)}`);
             return res.status(500).json({
                 success: false,
                 error: "Geometry generation failed. Check parameters (especially pitch vs diameter)."
             });
         }
 
-        const result = {
-            success: true,
-            filename: filename,
-            boltBrep: `/download/${filename}.brep`,
-            boltStl: `/preview/${filename}.stl`
-        };
+        res.json(jobResult(filename, p, manifest));
+    });
 
-        if (p.generateNut) {
-            result.nutBrep = `/download/${filename}_nut.brep`;
-            result.nutStl = `/preview/${filename}_nut.stl`;
+    // Client closed the tab or re-submitted: ask the engine to stop. It polls
+    // the cancel flag inside every long OCCT call and exits early.
+    res.on('close', () => {
+        if (!res.writableEnded && !session.ready && session.child.exitCode === null) {
+            console.log(`Client disconnected, cancelling ${filename}`);
+            session.child.kill('SIGTERM');
         }
-
-        res.json(result);
     });
 });
 
-app.get('/preview/:filename', (req, res) => {
-    const file = path.join(__dirname, 'Tests', req.params.filename);
-    if (fs.existsSync(file)) res.sendFile(file);
-    else res.status(404).json({ error: 'File not found' });
+// Streamed jobs: the engine writes the bolt preview to stdout as quantized
+// GLB and it is piped (gzipped when accepted) to the response, with no temp
+// file. The
+// rest of the job (manifest, download links, nut) is served by /job/:name
+// once the engine is done.
+const streamedJobs = new Map();
+
+app.post('/generate/stream', (req, res) => {
+    const p = req.body;
+    const filename = `bolt_${Date.now()}`;
+    const args = engineArgs(filename, p);
+    args.push('--stream=glb');
+
+    console.log(`Streaming: ${engine}`, args.join(' '));
+
+    rememberJob(filename, p);
+    const session = startEngine(filename, args, true);
+    const child = session.child;
+
+    let started = false;
+    let out = null;
+    child.stdout.on('data', chunk => {
+        if (res.destroyed) return;
+        if (!started) {
+            started = true;
+            res.set({ 'Content-Type': 'model/gltf-binary', 'X-Job-Name': filename });
+            out = compressedSink(req, res);
+        }
+        if (!out.write(chunk)) {
+            child.stdout.pause();
+            out.once('drain', () => child.stdout.resume());
+        }
+    });
+    child.stdout.on('end', () => {
+        if (started && !res.writableEnded) out.end();
+    });
+
+    const done = session.finished.then(code => {
+        const manifest = readManifest(filename);
+        if (!started && !res.writableEnded && !res.destroyed) {
+            if (code === 2) {
+                res.status(400).json({
+                    success: false,
+                    error: "Parameters are geometrically infeasible.",
+                    violations: manifest ? manifest.violations : []
+                });
+            } else if (code !== 0) {
+                console.error(`Stream generation error (exit ${code}): ${session.stderrTail.slice(-500)}`);
+                res.status(500).json({ success: false, error: "Geometry generation failed." });
+            }
+        }
+        if (code !== 0) {
+            return { success: false, error: `Engine exited with ${code}`, manifest };
+        }
+        return jobResult(filename, p, manifest);
+    });
+    streamedJobs.set(filename, done);
+    done.then(() => setTimeout(() => streamedJobs.delete(filename), 60000));
+
+    // Client closed the tab or re-submitted before the preview finished
+    res.on('close', () => {
+        if (!res.writableEnded && !session.ready && child.exitCode === null) {
+            console.log(`Client disconnected, cancelling ${filename}`);
+            child.kill('SIGTERM');
+        }
+    });
 });
 
-app.get('/download/:filename', (req, res) => {
-    const file = path.join(__dirname, 'Tests', req.params.filename);
-    if (fs.existsSync(file)) res.download(file, req.params.filename);
-    else res.status(404).json({ error: 'File not found' });
+app.get('/job/:name', async (req, res) => {
+    const job = streamedJobs.get(req.params.name);
+    if (!job) return res.status(404).json({ error: 'Unknown job' });
+    res.json(await job);
 });
 
+// Mesh payloads compress well (quantized, cache-ordered GLB especially), so
+// previews are gzipped whenever the client accepts it
+function compressedSink(req, res) {
+    res.vary('Accept-Encoding');
+    if (!req.acceptsEncodings('gzip')) return res;
+    res.set('Content-Encoding', 'gzip');
+    const gzip = zlib.createGzip();
+    gzip.pipe(res);
+    return gzip;
+}
+
+// Outputs a session has not written yet are produced on the first request
+function sendOutput(req, res, send) {
+    materialize(path.basename(req.params.filename)).then(file => {
+        if (!file) return res.status(404).json({ error: 'File not found' });
+        send(file);
+    }, error => {
+        console.error(`Could not produce ${req.params.filename}: ${error.message}`);
+        res.status(500).json({ error: 'File could not be produced' });
+    });
+}
+
+app.get('/preview/:filename', (req, res) => sendOutput(req, res, file => {
+    res.type(path.extname(file) === '.glb' ? 'model/gltf-binary' : 'model/stl');
+    fs.createReadStream(file).pipe(compressedSink(req, res));
+}));
+
+app.get('/download/:filename', (req, res) => sendOutput(req, res, file => {
+    res.download(file, path.basename(file));
+}));
+
 app.listen(port, () => {
     console.log(`BoltGenerator (v2) listening on port ${port}`);
 });
@@ -0,0 +1,386 @@
+#include "session.h"
+#include "budget.h"
+#include "cache.h"
+#include "export.h"
+#include "manifest.h"
+#include "progress.h"
+
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+
+#include <BRepBuilderAPI_Copy.hxx>
+
+namespace {
+struct Extension {
+  OutputFormat format;
+  const char *suffix;
+};
+
+constexpr Extension kExtensions[] = {{OutputFormat::BREP, ".brep"},
+                                     {OutputFormat::BREP_BINARY, ".bbrep"},
+                                     {OutputFormat::STL, ".stl"},
+                                     {OutputFormat::STEP, ".step"},
+                                     {OutputFormat::GLB, ".glb"}};
+
+const char *Suffix(OutputFormat format) {
+  for (const Extension &extension : kExtensions) {
+    if (extension.format == format) {
+      return extension.suffix;
+    }
+  }
+  return "";
+}
+
+// "<name>[_nut|_assembly].<ext>" back to the part and format; false for
+// anything else
+bool ParseOutputName(const std::string &name, const std::string &file,
+                     Part &part, OutputFormat &format) {
+  if (file.compare(0, name.size(), name) != 0) {
+    return false;
+  }
+  std::string rest = file.substr(name.size());
+  part = Part::BOLT;
+  if (rest.compare(0, 4, "_nut") == 0) {
+    part = Part::NUT;
+    rest = rest.substr(4);
+  } else if (rest.compare(0, 9, "_assembly") == 0) {
+    part = Part::ASSEMBLY;
+    rest = rest.substr(9);
+  }
+  for (const Extension &extension : kExtensions) {
+    if (rest == extension.suffix) {
+      format = extension.format;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::mutex stepWriterMutex;
+
+// Solids an output is written from; null where the output has no such part
+struct PartSolids {
+  TopoDS_Shape bolt;
+  TopoDS_Shape nut;
+  TopoDS_Shape washer;
+};
+
+// STEP file of one part, or of the assembly. Takes the solids rather than
+// the session so it can run on a writer thread.
+void WriteStep(const BoltParameters &p, const PatternParameters &pattern,
+               const std::string &name, Part part, const PartSolids &solids,
+               const std::string &path) {
+  // The STEP translator keeps global state (XSControl), so writers take turns
+  std::lock_guard<std::mutex> lock(stepWriterMutex);
+
+  // The cosmetic thread is only described in STEP
+  const bool cosmetic = p.thread.lod == ThreadLod::COSMETIC;
+  if (part != Part::ASSEMBLY) {
+    const TopoDS_Shape &solid = (part == Part::NUT) ? solids.nut : solids.bolt;
+    if (cosmetic) {
+      ExportSTEP(solid, p, part == Part::NUT, path.c_str());
+    } else {
+      ExportSTEP(solid, path.c_str());
+    }
+    return;
+  }
+
+  std::vector<std::string> description;
+  if (cosmetic) {
+    description = CosmeticThreadDescription(p, false);
+    if (!solids.nut.IsNull()) {
+      std::vector<std::string> internal = CosmeticThreadDescription(p, true);
+      description.insert(description.end(), internal.begin(), internal.end());
+    }
+  }
+  ExportAssemblySTEP(
+      PatternAssembly(p, pattern, solids.bolt, solids.nut, solids.washer),
+      name, description, path.c_str());
+}
+
+// Solids of `part` (all of them for the assembly), built if need be. A
+// writer thread gets copies.
+PartSolids SolidsFor(Session &job, const BoltParameters &p,
+                     const PatternParameters &pattern, Part part, bool copy) {
+  auto take = [copy](const TopoDS_Shape &solid) {
+    return copy ? BRepBuilderAPI_Copy(solid).Shape() : solid;
+  };
+  PartSolids solids;
+  if (part != Part::NUT) {
+    solids.bolt = take(job.BoltPart().Solid());
+  }
+  if (part != Part::BOLT && p.nut.generate) {
+    solids.nut = take(job.NutPart().Solid());
+  }
+  // A washer only goes under a nut
+  if (part == Part::ASSEMBLY && p.nut.generate && pattern.washer) {
+    solids.washer = take(job.WasherPart().Solid());
+  }
+  return solids;
+}
+
+// Writers rename their output into place only once it is complete; some
+// report a failure on stderr alone
+void RequireWritten(const std::string &path) {
+  if (access(path.c_str(), F_OK) != 0) {
+    throw std::runtime_error("Session: could not write " + path);
+  }
+}
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Degradations and fallbacks recorded so far. A part built while they grow
+// depends on the budget or took a fallback, and is not cached.
+std::size_t ShortcutCount() {
+  return ManifestListSize("degradations") + ManifestListSize("fallbacks");
+}
+} // namespace
+
+void WriteLine(int fd, const std::string &line) {
+  std::string text = line + "\n";
+  const char *data = text.data();
+  std::size_t left = text.size();
+  while (left > 0) {
+    ssize_t n = write(fd, data, left);
+    if (n <= 0) {
+      throw std::runtime_error("Session: reply pipe closed");
+    }
+    data += n;
+    left -= static_cast<std::size_t>(n);
+  }
+}
+
+Session::Session(const std::string &name, const BoltParameters &p,
+                 bool periodicMesh, const PatternParameters &pattern)
+    : name(name), params(p), periodicMesh(periodicMesh), pattern(pattern) {}
+
+Session::~Session() {
+  // Writers still running when the job unwinds (e.g. cancelled) are only
+  // waited for; their errors no longer matter
+  for (std::unique_ptr<Writer> &writer : writers) {
+    if (writer->thread.joinable()) {
+      writer->thread.join();
+    }
+  }
+}
+
+Bolt &Session::BoltPart() {
+  if (!bolt) {
+    TopoDS_Solid cached;
+    if (ResultCacheLoad(params, "bolt", cached)) {
+      bolt.reset(new Bolt(params, cached));
+    } else {
+      const std::size_t shortcuts = ShortcutCount();
+      bolt.reset(new Bolt(params));
+      if (ShortcutCount() == shortcuts) {
+        ResultCacheStore(params, "bolt", bolt->Solid());
+      }
+    }
+  }
+  return *bolt;
+}
+
+Nut &Session::NutPart() {
+  if (!nut) {
+    TopoDS_Solid cached;
+    if (ResultCacheLoad(params, "nut", cached)) {
+      nut.reset(new Nut(params, cached));
+    } else {
+      const std::size_t shortcuts = ShortcutCount();
+      nut.reset(new Nut(params));
+      if (ShortcutCount() == shortcuts) {
+        ResultCacheStore(params, "nut", nut->Solid());
+      }
+    }
+  }
+  return *nut;
+}
+
+Washer &Session::WasherPart() {
+  if (!washer) {
+    washer.reset(new Washer(params));
+  }
+  return *washer;
+}
+
+std::string Session::Path(Part part, OutputFormat format) const {
+  return std::string("Tests/")
+      .append(name)
+      .append(part == Part::NUT        ? "_nut"
+              : part == Part::ASSEMBLY ? "_assembly"
+                                       : "")
+      .append(Suffix(format));
+}
+
+std::string Session::Materialize(Part part, OutputFormat format) {
+  const std::string path = Path(part, format);
+  for (const std::unique_ptr<Writer> &writer : writers) {
+    if (writer->path == path) {
+      Join();
+    }
+  }
+  if (written.count(path)) {
+    return path;
+  }
+  if (part == Part::NUT && !params.nut.generate) {
+    throw std::runtime_error("Session: job has no nut");
+  }
+  if (part == Part::ASSEMBLY && format != OutputFormat::STEP &&
+      format != OutputFormat::GLB) {
+    throw std::runtime_error("Session: the assembly is only written as STEP "
+                             "or GLB");
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  if (format == OutputFormat::STEP) {
+    WriteStep(params, pattern, name, part, SolidsFor(*this, params, pattern, part, false), path);
+    RequireWritten(path);
+    RecordWrite(path, MsSince(start), false);
+    written.insert(path);
+    return path;
+  }
+  if (part == Part::ASSEMBLY) {
+    PartSolids solids = SolidsFor(*this, params, pattern, part, false);
+    ExportAssemblyGLB(
+        PatternAssembly(params, pattern, solids.bolt, solids.nut, solids.washer),
+        path.c_str());
+    RequireWritten(path);
+    RecordWrite(path, MsSince(start), false);
+    written.insert(path);
+    return path;
+  }
+
+  TopoDS_Solid solid =
+      (part == Part::BOLT) ? BoltPart().Solid() : NutPart().Solid();
+  switch (format) {
+  case OutputFormat::BREP:
+    ExportBRep(solid, path.c_str());
+    break;
+  case OutputFormat::BREP_BINARY:
+    ExportBinBRep(solid, path.c_str());
+    break;
+  case OutputFormat::STL:
+    if (part == Part::BOLT && periodicMesh) {
+      ExportSTL(solid, BoltPart().Periodicity(), path.c_str());
+    } else {
+      ExportSTL(solid, path.c_str());
+    }
+    break;
+  case OutputFormat::STEP:
+    break;
+  case OutputFormat::GLB:
+    ExportGLB(solid, path.c_str());
+    break;
+  }
+  RequireWritten(path);
+  RecordWrite(path, MsSince(start), false);
+  written.insert(path);
+  return path;
+}
+
+void Session::MaterializeStepInBackground(Part part) {
+  const std::string path = Path(part, OutputFormat::STEP);
+  if (written.count(path)) {
+    return;
+  }
+  for (const std::unique_ptr<Writer> &writer : writers) {
+    if (writer->path == path) {
+      return;
+    }
+  }
+  if (part == Part::NUT && !params.nut.generate) {
+    throw std::runtime_error("Session: job has no nut");
+  }
+
+  // The mesh exports attach triangulations to the session's solids while
+  // the writer reads its own copies, so the two threads share no topology
+  const PartSolids solids = SolidsFor(*this, params, pattern, part, true);
+
+  std::cout << "Session: Writing " << path << " in the background"
+            << std::endl;
+  writers.emplace_back(new Writer);
+  Writer *writer = writers.back().get();
+  writer->path = path;
+  writer->thread = std::thread([this, writer, part, solids] {
+    const auto start = std::chrono::steady_clock::now();
+    try {
+      WriteStep(params, pattern, name, part, solids, writer->path);
+      RequireWritten(writer->path);
+    } catch (...) {
+      writer->error = std::current_exception();
+    }
+    writer->ms = MsSince(start);
+  });
+}
+
+void Session::Join() {
+  std::exception_ptr error;
+  for (std::unique_ptr<Writer> &writer : writers) {
+    writer->thread.join();
+    if (writer->error) {
+      if (!error) {
+        error = writer->error;
+      }
+    } else {
+      RecordWrite(writer->path, writer->ms, true);
+      written.insert(writer->path);
+    }
+  }
+  writers.clear();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void Session::RecordWrite(const std::string &path, double ms,
+                          bool background) {
+  std::cout << "Session: Wrote " << path << " in " << ms << " ms"
+            << (background ? " (background)" : "") << std::endl;
+  ManifestAddRecord("exports",
+                    {{"file", ManifestString(path)},
+                     {"ms", ManifestNumber(ms)},
+                     {"background", background ? "true" : "false"}});
+}
+
+void Session::Serve(int replyFd, const std::string &manifestPath) {
+  const double budget = BudgetMs();
+  std::string file;
+  for (;;) {
+    // Idle, a termination signal simply ends the session; during a request
+    // it cancels the request like any job
+    std::signal(SIGTERM, SIG_DFL);
+    if (!std::getline(std::cin, file)) {
+      break;
+    }
+    InstallCancelHandler();
+    if (file.empty()) {
+      continue;
+    }
+
+    SetJobBudget(budget);
+    std::cout << "Session: Materializing " << file << std::endl;
+    Part part;
+    OutputFormat format;
+    try {
+      if (!ParseOutputName(name, file, part, format)) {
+        throw std::runtime_error("not an output of this job");
+      }
+      Materialize(part, format);
+      WriteLine(replyFd, "ok " + file);
+    } catch (const JobCancelled &) {
+      throw;
+    } catch (const std::exception &e) {
+      std::cerr << "Session: " << file << " failed: " << e.what() << std::endl;
+      WriteLine(replyFd, "error " + file + " " + e.what());
+    }
+    WriteManifest(manifestPath);
+  }
+}
@@ -0,0 +1,91 @@
+/*
+    BoltGenerator - Job session
+    Copyright (C) 2025
+*/
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "bolt.h"
+#include "nut.h"
+#include "parameters.h"
+#include "pattern.h"
+#include "washer.h"
+
+#include <exception>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Session replies go to this descriptor (the server opens it as a fourth
+// pipe), which leaves stdout to streamed previews
+constexpr int kSessionReplyFd = 3;
+
+enum class Part { BOLT, NUT, ASSEMBLY };
+enum class OutputFormat { BREP, BREP_BINARY, STL, STEP, GLB };
+
+// The parts of one job, each built the first time an output needs it (or
+// read back from the result cache) and then kept, so a download requested
+// after the preview costs one writer run and no regeneration. Outputs are
+// written to Tests/<name>[_nut].<ext>, each renamed into place once complete,
+// so the server never serves a partial file; the binary B-rep is .bbrep. The
+// assembly, every fastener of the pattern with its nut (and washer), is
+// Tests/<name>_assembly.step or .glb; its parts are built once whatever the
+// number of instances.
+class Session {
+public:
+  Session(const std::string &name, const BoltParameters &p, bool periodicMesh,
+          const PatternParameters &pattern = PatternParameters());
+  ~Session();
+
+  Bolt &BoltPart();
+  Nut &NutPart();
+  Washer &WasherPart();
+
+  std::string Path(Part part, OutputFormat format) const;
+
+  // Writes the file unless this session already has; returns its path.
+  // GLB here is the B-rep preview.
+  std::string Materialize(Part part, OutputFormat format);
+
+  // Same for the STEP file of `part`, translated on a writer thread from
+  // copies of the solids, so the slow STEP translation runs alongside the
+  // mesh exports instead of after them. The parts are built before this
+  // returns. Join() waits for the writers, records their times in the
+  // manifest and rethrows the first error.
+  void MaterializeStepInBackground(Part part);
+  void Join();
+
+  // Serves requests from stdin, one output file name per line (e.g.
+  // "bolt_1_nut.step"), until EOF. Each is answered on `replyFd` with
+  // "ok <file>" or "error <file> <reason>", and the manifest is rewritten.
+  // Every request gets a fresh job budget.
+  void Serve(int replyFd, const std::string &manifestPath);
+
+private:
+  struct Writer {
+    std::string path;
+    std::thread thread;
+    std::exception_ptr error;
+    double ms = 0.0;
+  };
+
+  void RecordWrite(const std::string &path, double ms, bool background);
+
+  std::string name;
+  BoltParameters params;
+  bool periodicMesh;
+  PatternParameters pattern;
+  std::unique_ptr<Bolt> bolt;
+  std::unique_ptr<Nut> nut;
+  std::unique_ptr<Washer> washer;
+  std::set<std::string> written;
+  std::vector<std::unique_ptr<Writer>> writers;
+};
+
+// Writes one line to a descriptor (pipe replies, not logs)
+void WriteLine(int fd, const std::string &line);
+
+#endif // SESSION_H
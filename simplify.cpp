@@ -0,0 +1,157 @@
+#include "simplify.h"
+#include "manifest.h"
+#include "progress.h"
+
+#include <BRepCheck_Analyzer.hxx>
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <ShapeFix_ShapeTolerance.hxx>
+#include <ShapeUpgrade_UnifySameDomain.hxx>
+#include <TopExp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TopoDS.hxx>
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace {
+struct TopologyStats {
+  int faces;
+  int edges;
+  double maxTolerance;
+};
+
+TopologyStats Measure(const TopoDS_Shape &shape) {
+  TopTools_IndexedMapOfShape faces, edges, vertices;
+  TopExp::MapShapes(shape, TopAbs_FACE, faces);
+  TopExp::MapShapes(shape, TopAbs_EDGE, edges);
+  TopExp::MapShapes(shape, TopAbs_VERTEX, vertices);
+  double maxTolerance = 0.0;
+  for (int i = 1; i <= faces.Extent(); ++i) {
+    maxTolerance = std::max(maxTolerance,
+                            BRep_Tool::Tolerance(TopoDS::Face(faces(i))));
+  }
+  for (int i = 1; i <= edges.Extent(); ++i) {
+    maxTolerance = std::max(maxTolerance,
+                            BRep_Tool::Tolerance(TopoDS::Edge(edges(i))));
+  }
+  for (int i = 1; i <= vertices.Extent(); ++i) {
+    maxTolerance = std::max(
+        maxTolerance, BRep_Tool::Tolerance(TopoDS::Vertex(vertices(i))));
+  }
+  return {faces.Extent(), edges.Extent(), maxTolerance};
+}
+
+// Tolerances above the cap, so a cap that breaks the solid can be undone
+// (the sub-shapes are shared with the input)
+struct SavedTolerances {
+  std::vector<std::pair<TopoDS_Face, double>> faces;
+  std::vector<std::pair<TopoDS_Edge, double>> edges;
+  std::vector<std::pair<TopoDS_Vertex, double>> vertices;
+};
+
+SavedTolerances SaveTolerances(const TopoDS_Shape &shape) {
+  SavedTolerances saved;
+  for (TopExp_Explorer ex(shape, TopAbs_FACE); ex.More(); ex.Next()) {
+    const TopoDS_Face &face = TopoDS::Face(ex.Current());
+    if (BRep_Tool::Tolerance(face) > kToleranceCap) {
+      saved.faces.push_back({face, BRep_Tool::Tolerance(face)});
+    }
+  }
+  for (TopExp_Explorer ex(shape, TopAbs_EDGE); ex.More(); ex.Next()) {
+    const TopoDS_Edge &edge = TopoDS::Edge(ex.Current());
+    if (BRep_Tool::Tolerance(edge) > kToleranceCap) {
+      saved.edges.push_back({edge, BRep_Tool::Tolerance(edge)});
+    }
+  }
+  for (TopExp_Explorer ex(shape, TopAbs_VERTEX); ex.More(); ex.Next()) {
+    const TopoDS_Vertex &vertex = TopoDS::Vertex(ex.Current());
+    if (BRep_Tool::Tolerance(vertex) > kToleranceCap) {
+      saved.vertices.push_back({vertex, BRep_Tool::Tolerance(vertex)});
+    }
+  }
+  return saved;
+}
+
+void RestoreTolerances(const SavedTolerances &saved) {
+  BRep_Builder builder;
+  for (const auto &face : saved.faces) {
+    builder.UpdateFace(face.first, face.second);
+  }
+  for (const auto &edge : saved.edges) {
+    builder.UpdateEdge(edge.first, edge.second);
+  }
+  for (const auto &vertex : saved.vertices) {
+    builder.UpdateVertex(vertex.first, vertex.second);
+  }
+}
+} // namespace
+
+TopoDS_Solid Simplify(const char *stage, const TopoDS_Solid &solid) {
+  const TopologyStats before = Measure(solid);
+  TopoDS_Solid result = solid;
+
+  // Merge same-domain faces and edges; BSplines are left as they are
+  std::string failure;
+  try {
+    ShapeUpgrade_UnifySameDomain unify(solid, Standard_True, Standard_True,
+                                       Standard_False);
+    unify.Build();
+    ThrowIfCancelled(stage);
+    TopExp_Explorer solids(unify.Shape(), TopAbs_SOLID);
+    if (solids.More()) {
+      result = TopoDS::Solid(solids.Current());
+    } else {
+      failure = "merge left no solid";
+    }
+  } catch (const JobCancelled &) {
+    throw;
+  } catch (const std::exception &e) {
+    failure = e.what();
+  } catch (...) {
+    failure = "unknown error";
+  }
+
+  // Cap the tolerances, then check the solid once for both steps. If it no
+  // longer checks out, the caps are undone (the sub-shapes are shared with
+  // the input) and the input is kept as it was.
+  const SavedTolerances saved = SaveTolerances(result);
+  const bool capped = !saved.faces.empty() || !saved.edges.empty() ||
+                      !saved.vertices.empty();
+  if (capped) {
+    ShapeFix_ShapeTolerance().LimitTolerance(result, 0.0, kToleranceCap);
+  }
+  if ((failure.empty() || capped) && !BRepCheck_Analyzer(result).IsValid()) {
+    RestoreTolerances(saved);
+    result = solid;
+    if (failure.empty()) {
+      failure = "cleaned solid is not valid";
+    }
+  }
+  // A missed cleanup costs nothing but topology, so it is only a note and
+  // does not count as a fallback
+  if (!failure.empty()) {
+    std::cout << "Cleanup: " << stage << " skipped (" << failure << ")"
+              << std::endl;
+    ManifestAddEntry("notes", stage,
+                     "cleanup skipped (" + failure + "); solid left as built");
+  }
+
+  const TopologyStats after = Measure(result);
+  std::cout << "Cleanup: " << stage << " faces " << before.faces << " -> "
+            << after.faces << ", edges " << before.edges << " -> "
+            << after.edges << ", max tolerance " << before.maxTolerance
+            << " -> " << after.maxTolerance << std::endl;
+  ManifestAddRecord("cleanup",
+                    {{"stage", ManifestString(stage)},
+                     {"facesBefore", ManifestNumber(before.faces)},
+                     {"facesAfter", ManifestNumber(after.faces)},
+                     {"edgesBefore", ManifestNumber(before.edges)},
+                     {"edgesAfter", ManifestNumber(after.edges)},
+                     {"toleranceBefore", ManifestNumber(before.maxTolerance)},
+                     {"toleranceAfter", ManifestNumber(after.maxTolerance)}});
+  return result;
+}
@@ -0,0 +1,25 @@
+/*
+    BoltGenerator - Topology cleanup
+    Copyright (C) 2025
+*/
+
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <TopoDS_Solid.hxx>
+
+// Vertex, edge and face tolerances are capped at this (mm): the loosest
+// fuzzy value the booleans race with (see cut.h)
+constexpr double kToleranceCap = 1.0e-4;
+
+// Cleanup run after chains of booleans. Faces and edges left split on one
+// surface or curve are merged (ShapeUpgrade_UnifySameDomain), then the
+// tolerances that grew along the way are capped (ShapeFix_ShapeTolerance).
+// The result is checked once; if it is not valid the input is returned
+// unchanged and a note goes into the manifest under "notes", which, unlike
+// "fallbacks", does not keep the part out of the result cache. Face and edge
+// counts and the largest tolerance (toleranceBefore/After) before and after
+// go into the manifest under "cleanup", with `stage` as the name.
+TopoDS_Solid Simplify(const char *stage, const TopoDS_Solid &solid);
+
+#endif // SIMPLIFY_H
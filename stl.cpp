@@ -0,0 +1,336 @@
+#include "stl.h"
+#include "progress.h"
+
+#include <BRep_Tool.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopLoc_Location.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Face.hxx>
+#include <gp_Trsf.hxx>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Binary STL is little-endian; records are copied straight from memory
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#error "WriteBinarySTL assumes a little-endian host"
+#endif
+
+namespace {
+constexpr std::size_t kHeaderSize = 84;
+constexpr std::size_t kRecordSize = 50;
+// Triangles handed to a worker at a time
+constexpr std::size_t kChunkSize = 16384;
+// Normals are computed this many triangles at a time in structure-of-arrays
+// form so the compiler can vectorize the cross products and square roots
+constexpr std::size_t kBatch = 16;
+// Added under the square root instead of testing for a zero length, which
+// would be control flow in the loop. Degenerate triangles get a zero normal;
+// it is far below the rounding of any real one.
+constexpr float kMinLengthSquared = 1.0e-30f;
+
+struct FaceSlice {
+  Handle(Poly_Triangulation) triangulation;
+  gp_Trsf transform;
+  bool transformed;
+  bool flipped;      // swap winding (reversed face or mirroring location)
+  std::size_t first; // index of the face's first triangle in the file
+};
+
+struct Batch {
+  float x[3][kBatch], y[3][kBatch], z[3][kBatch];
+  float nx[kBatch], ny[kBatch], nz[kBatch];
+};
+
+void ComputeNormals(Batch &b, std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    float ux = b.x[1][i] - b.x[0][i], uy = b.y[1][i] - b.y[0][i],
+          uz = b.z[1][i] - b.z[0][i];
+    float vx = b.x[2][i] - b.x[0][i], vy = b.y[2][i] - b.y[0][i],
+          vz = b.z[2][i] - b.z[0][i];
+    float cx = uy * vz - uz * vy;
+    float cy = uz * vx - ux * vz;
+    float cz = ux * vy - uy * vx;
+    float inv =
+        1.0f / std::sqrt(cx * cx + cy * cy + cz * cz + kMinLengthSquared);
+    b.nx[i] = cx * inv;
+    b.ny[i] = cy * inv;
+    b.nz[i] = cz * inv;
+  }
+}
+
+void StoreRecords(const Batch &b, std::size_t count, unsigned char *out) {
+  for (std::size_t i = 0; i < count; ++i, out += kRecordSize) {
+    float record[12] = {b.nx[i],   b.ny[i],   b.nz[i],   b.x[0][i],
+                        b.y[0][i], b.z[0][i], b.x[1][i], b.y[1][i],
+                        b.z[1][i], b.x[2][i], b.y[2][i], b.z[2][i]};
+    std::memcpy(out, record, sizeof(record));
+    out[48] = 0; // attribute byte count
+    out[49] = 0;
+  }
+}
+
+// Encodes triangles [begin, end) of one face as consecutive records at `out`
+void FillRange(const FaceSlice &face, std::size_t begin, std::size_t end,
+               unsigned char *out) {
+  Batch batch;
+  for (std::size_t start = begin; start < end; start += kBatch) {
+    std::size_t count = std::min(kBatch, end - start);
+    for (std::size_t i = 0; i < count; ++i) {
+      int n[3];
+      const Poly_Triangle triangle =
+          face.triangulation->Triangle(static_cast<int>(start + i) + 1);
+      triangle.Get(n[0], n[1], n[2]);
+      if (face.flipped) {
+        std::swap(n[1], n[2]);
+      }
+      for (int k = 0; k < 3; ++k) {
+        gp_Pnt p = face.triangulation->Node(n[k]);
+        if (face.transformed) {
+          p.Transform(face.transform);
+        }
+        batch.x[k][i] = static_cast<float>(p.X());
+        batch.y[k][i] = static_cast<float>(p.Y());
+        batch.z[k][i] = static_cast<float>(p.Z());
+      }
+    }
+    ComputeNormals(batch, count);
+    StoreRecords(batch, count, out + (start - begin) * kRecordSize);
+  }
+}
+
+// Encodes file triangles [begin, end), which may span several faces
+void FillTriangles(const std::vector<FaceSlice> &faces, std::size_t begin,
+                   std::size_t end, unsigned char *out) {
+  // Last face starting at or before `begin`
+  auto it = std::upper_bound(
+      faces.begin(), faces.end(), begin,
+      [](std::size_t index, const FaceSlice &f) { return index < f.first; });
+  for (--it; begin < end; ++it) {
+    std::size_t faceEnd =
+        it->first + static_cast<std::size_t>(it->triangulation->NbTriangles());
+    std::size_t stop = std::min(end, faceEnd);
+    FillRange(*it, begin - it->first, stop - it->first, out);
+    out += (stop - begin) * kRecordSize;
+    begin = stop;
+  }
+}
+
+std::vector<FaceSlice> CollectFaces(const TopoDS_Shape &shape,
+                                    std::size_t &total) {
+  std::vector<FaceSlice> faces;
+  total = 0;
+  for (TopExp_Explorer ex(shape, TopAbs_FACE); ex.More(); ex.Next()) {
+    const TopoDS_Face &face = TopoDS::Face(ex.Current());
+    TopLoc_Location location;
+    Handle(Poly_Triangulation) triangulation =
+        BRep_Tool::Triangulation(face, location);
+    if (triangulation.IsNull() || triangulation->NbTriangles() == 0) {
+      continue;
+    }
+    const gp_Trsf &transform = location.Transformation();
+    bool reversed = (face.Orientation() == TopAbs_REVERSED);
+    faces.push_back({triangulation, transform, !location.IsIdentity(),
+                     reversed != transform.IsNegative(), total});
+    total += triangulation->NbTriangles();
+  }
+  return faces;
+}
+
+void FillHeader(unsigned char *out, std::size_t total) {
+  char header[80] = "Binary STL written by BoltGenerator";
+  std::memcpy(out, header, sizeof(header));
+  std::uint32_t count = static_cast<std::uint32_t>(total);
+  std::memcpy(out + 80, &count, sizeof(count));
+}
+
+} // namespace
+
+bool WriteFully(int fd, const void *buffer, std::size_t size) {
+  const unsigned char *data = static_cast<const unsigned char *>(buffer);
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EPIPE) {
+        // The reader went away: the request was abandoned
+        throw JobCancelled("STL stream");
+      }
+      return false;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+bool WriteBinarySTL(const TopoDS_Shape &shape, const char *filename) {
+  std::size_t total = 0;
+  std::vector<FaceSlice> faces = CollectFaces(shape, total);
+  if (total > UINT32_MAX) {
+    std::cerr << "STL: " << total << " triangles exceed the format limit"
+              << std::endl;
+    return false;
+  }
+
+  const std::size_t size = kHeaderSize + kRecordSize * total;
+  int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cerr << "STL: Cannot open " << filename << std::endl;
+    return false;
+  }
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    std::cerr << "STL: Cannot allocate " << size << " bytes" << std::endl;
+    close(fd);
+    return false;
+  }
+  void *mapped = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    std::cerr << "STL: Cannot map " << filename << std::endl;
+    close(fd);
+    return false;
+  }
+  unsigned char *data = static_cast<unsigned char *>(mapped);
+
+  FillHeader(data, total);
+  unsigned char *records = data + kHeaderSize;
+
+  // Workers claim fixed-size triangle chunks from a shared counter; a chunk
+  // may straddle faces, so a few huge thread faces split across workers
+  // just like the many small ones
+  std::atomic<std::size_t> nextChunk(0);
+  std::size_t chunks = (total + kChunkSize - 1) / kChunkSize;
+  auto worker = [&]() {
+    for (std::size_t chunk = nextChunk++; chunk < chunks;
+         chunk = nextChunk++) {
+      if (CancelRequested()) {
+        return;
+      }
+      std::size_t begin = chunk * kChunkSize;
+      std::size_t end = std::min(total, begin + kChunkSize);
+      FillTriangles(faces, begin, end, records + begin * kRecordSize);
+    }
+  };
+
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = static_cast<unsigned>(
+      std::min<std::size_t>(threads, std::max<std::size_t>(1, chunks)));
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &t : pool) {
+    t.join();
+  }
+
+  bool ok = (munmap(mapped, size) == 0);
+  ok = (close(fd) == 0) && ok;
+  if (CancelRequested()) {
+    std::remove(filename);
+    throw JobCancelled("STL export");
+  }
+  return ok;
+}
+
+bool StreamBinarySTL(const TopoDS_Shape &shape, int fd) {
+  std::size_t total = 0;
+  std::vector<FaceSlice> faces = CollectFaces(shape, total);
+  if (total > UINT32_MAX) {
+    std::cerr << "STL: " << total << " triangles exceed the format limit"
+              << std::endl;
+    return false;
+  }
+
+  // The header goes out first so the reader can size its buffer; records
+  // follow chunk by chunk as they are encoded
+  std::vector<unsigned char> buffer(
+      std::max(kHeaderSize, kChunkSize * kRecordSize));
+  FillHeader(buffer.data(), total);
+  if (!WriteFully(fd, buffer.data(), kHeaderSize)) {
+    return false;
+  }
+  for (std::size_t begin = 0; begin < total; begin += kChunkSize) {
+    ThrowIfCancelled("STL stream");
+    std::size_t end = std::min(total, begin + kChunkSize);
+    FillTriangles(faces, begin, end, buffer.data());
+    if (!WriteFully(fd, buffer.data(), (end - begin) * kRecordSize)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool StreamBinarySTL(const TriMesh &mesh, int fd) {
+  const std::size_t total = mesh.TriangleCount();
+  if (total > UINT32_MAX) {
+    std::cerr << "STL: " << total << " triangles exceed the format limit"
+              << std::endl;
+    return false;
+  }
+
+  std::vector<unsigned char> buffer(
+      std::max(kHeaderSize, kChunkSize * kRecordSize));
+  FillHeader(buffer.data(), total);
+  if (!WriteFully(fd, buffer.data(), kHeaderSize)) {
+    return false;
+  }
+  Batch batch;
+  for (std::size_t begin = 0; begin < total; begin += kChunkSize) {
+    ThrowIfCancelled("STL stream");
+    std::size_t end = std::min(total, begin + kChunkSize);
+    for (std::size_t start = begin; start < end; start += kBatch) {
+      std::size_t count = std::min(kBatch, end - start);
+      for (std::size_t i = 0; i < count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+          const float *p = &mesh.positions[3 * mesh.indices[3 * (start + i) + k]];
+          batch.x[k][i] = p[0];
+          batch.y[k][i] = p[1];
+          batch.z[k][i] = p[2];
+        }
+      }
+      ComputeNormals(batch, count);
+      StoreRecords(batch, count,
+                   buffer.data() + (start - begin) * kRecordSize);
+    }
+    if (!WriteFully(fd, buffer.data(), (end - begin) * kRecordSize)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WriteBinarySTL(const TriMesh &mesh, const char *filename) {
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cerr << "STL: Cannot open " << filename << std::endl;
+    return false;
+  }
+  // A cancelled write leaves no truncated file behind, as in the mapped
+  // writer
+  bool written;
+  try {
+    written = StreamBinarySTL(mesh, fd);
+  } catch (...) {
+    close(fd);
+    std::remove(filename);
+    throw;
+  }
+  return (close(fd) == 0) && written;
+}
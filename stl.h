@@ -0,0 +1,36 @@
+/*
+    BoltGenerator - Binary STL writer
+    Copyright (C) 2025
+*/
+
+#ifndef STL_H
+#define STL_H
+
+#include "trimesh.h"
+
+#include <TopoDS_Shape.hxx>
+
+#include <cstddef>
+
+// Writes the existing triangulation of `shape` as binary STL. The file size
+// is known up front (84 + 50 * triangles), so the file is preallocated and
+// memory-mapped, and worker threads fill disjoint triangle ranges straight
+// from each face's Poly_Triangulation. Faces without a triangulation are
+// skipped; mesh the shape first (see MeshedShape()).
+bool WriteBinarySTL(const TopoDS_Shape &shape, const char *filename);
+
+// Same records, written sequentially to a pipe or socket so the reader gets
+// the first bytes while later chunks are still being encoded.
+bool StreamBinarySTL(const TopoDS_Shape &shape, int fd);
+
+// Streams an indexed mesh (e.g. one from tessellate.h) in the same format.
+bool StreamBinarySTL(const TriMesh &mesh, int fd);
+
+// Writes an indexed mesh to a file, through StreamBinarySTL().
+bool WriteBinarySTL(const TriMesh &mesh, const char *filename);
+
+// Writes all of `buffer` to `fd`, retrying short writes. A closed reader
+// (EPIPE) throws JobCancelled, since nobody is waiting for the output.
+bool WriteFully(int fd, const void *buffer, std::size_t size);
+
+#endif // STL_H
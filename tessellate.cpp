@@ -0,0 +1,751 @@
+#include "tessellate.h"
+#include "csg.h"
+#include "preflight.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace {
+// Thread profile as Thread() cuts it, in pitches: a root flat of P/4, 60
+// degree flanks out to the 0.614P depth, plus a 0.05P radial clearance on
+// both sides
+constexpr double kRootHalfWidth = 0.125;
+constexpr double kThreadDepth = 0.614;
+constexpr double kThreadClearance = 0.05;
+
+// Rows along the thread are never further apart than this (in pitches), so
+// the tip chamfer crossing the grid is followed closely
+constexpr double kMaxRowSpacing = 0.125;
+
+// Columns per turn. The floor matches the 0.25 rad angular deflection of the
+// B-rep meshes.
+constexpr int kMinColumns = 26;
+constexpr int kMaxColumns = 1024;
+
+// Nut bore cutter placement (see Nut::Nut): the thread starts half a pitch
+// below the shaft, which starts this far below the nut
+constexpr double kNutShaftOverlap = 2.0;
+
+constexpr double kTwoPi = 2.0 * M_PI;
+
+// Revolved grooves are shifted this far (in pitches) along the axis. Their
+// level rows would otherwise sit in the planes of the hex caps and the head
+// underside for round pitches, which the mesh booleans cannot take.
+constexpr double kLevelRowShift = 1e-3;
+
+// Collects vertices and per-face triangles; faces become the face mapping
+class Builder {
+public:
+  std::uint32_t Vertex(double x, double y, double z) {
+    mesh.positions.push_back(static_cast<float>(x));
+    mesh.positions.push_back(static_cast<float>(y));
+    mesh.positions.push_back(static_cast<float>(z));
+    return static_cast<std::uint32_t>(mesh.VertexCount() - 1);
+  }
+
+  int Face() {
+    faces.emplace_back();
+    return static_cast<int>(faces.size()) - 1;
+  }
+
+  // Triangles whose corners were clamped onto the same vertex are dropped
+  void Triangle(int face, std::uint32_t a, std::uint32_t b, std::uint32_t c) {
+    if (a == b || b == c || a == c) {
+      return;
+    }
+    faces[face].insert(faces[face].end(), {a, b, c});
+  }
+
+  void Quad(int face, std::uint32_t a, std::uint32_t b, std::uint32_t c,
+            std::uint32_t d) {
+    Triangle(face, a, b, c);
+    Triangle(face, a, c, d);
+  }
+
+  TriMesh Finish() {
+    mesh.faceTriangles.push_back(0);
+    for (const std::vector<std::uint32_t> &face : faces) {
+      if (face.empty()) {
+        continue;
+      }
+      mesh.indices.insert(mesh.indices.end(), face.begin(), face.end());
+      mesh.faceTriangles.push_back(
+          static_cast<std::uint32_t>(mesh.TriangleCount()));
+    }
+    faces.clear();
+    return std::move(mesh);
+  }
+
+private:
+  TriMesh mesh;
+  std::vector<std::vector<std::uint32_t>> faces;
+};
+
+// Angles shared by every ring and helix row. This is the tessellator's only
+// trigonometry; vertices are scaled from the table in flat loops.
+struct Columns {
+  std::vector<double> angle, cosine, sine;
+  int Count() const { return static_cast<int>(angle.size()); }
+};
+
+Columns MakeColumns(int count, double phase = 0.0) {
+  Columns columns;
+  columns.angle.resize(count);
+  columns.cosine.resize(count);
+  columns.sine.resize(count);
+  const double step = kTwoPi / count;
+  for (int i = 0; i < count; ++i) {
+    columns.angle[i] = phase + step * i;
+    columns.cosine[i] = std::cos(columns.angle[i]);
+    columns.sine[i] = std::sin(columns.angle[i]);
+  }
+  return columns;
+}
+
+// Enough columns for `deflection` on the largest radius of the part
+int ColumnCount(double radius, double deflection) {
+  if (!(deflection > 0.0) || deflection >= radius) {
+    return kMinColumns;
+  }
+  const double step = 2.0 * std::acos(1.0 - deflection / radius);
+  const int count = static_cast<int>(std::ceil(kTwoPi / step));
+  return std::max(kMinColumns, std::min(kMaxColumns, count));
+}
+
+// Closed counter-clockwise vertex loop (seen from +z) at ascending angles
+struct Loop {
+  std::vector<std::uint32_t> ids;
+  std::vector<double> angles;
+  std::size_t Size() const { return ids.size(); }
+};
+
+Loop Circle(Builder &mesh, const Columns &columns, double radius, double z) {
+  Loop loop;
+  for (int i = 0; i < columns.Count(); ++i) {
+    loop.ids.push_back(mesh.Vertex(radius * columns.cosine[i],
+                                   radius * columns.sine[i], z));
+    loop.angles.push_back(columns.angle[i]);
+  }
+  return loop;
+}
+
+// Corners placed as Hexagon() places them
+Loop Hex(Builder &mesh, double acrossFlats, double z) {
+  const double circumradius = acrossFlats / std::sqrt(3.0);
+  Loop loop;
+  for (int j = 0; j < 6; ++j) {
+    const double angle = M_PI / 6.0 + j * (M_PI / 3.0);
+    loop.ids.push_back(mesh.Vertex(circumradius * std::cos(angle),
+                                   circumradius * std::sin(angle), z));
+    loop.angles.push_back(angle);
+  }
+  return loop;
+}
+
+// Planar fan over a convex loop, facing +z or -z
+void Cap(Builder &mesh, int face, const Loop &loop, bool up) {
+  for (std::size_t j = 1; j + 1 < loop.Size(); ++j) {
+    if (up) {
+      mesh.Triangle(face, loop.ids[0], loop.ids[j], loop.ids[j + 1]);
+    } else {
+      mesh.Triangle(face, loop.ids[0], loop.ids[j + 1], loop.ids[j]);
+    }
+  }
+}
+
+// Fan around a vertex on the axis, for loops that are only star-shaped
+void Hub(Builder &mesh, int face, const Loop &loop, double z, bool up) {
+  const std::uint32_t centre = mesh.Vertex(0.0, 0.0, z);
+  for (std::size_t j = 0; j < loop.Size(); ++j) {
+    const std::uint32_t a = loop.ids[j], b = loop.ids[(j + 1) % loop.Size()];
+    if (up) {
+      mesh.Triangle(face, centre, a, b);
+    } else {
+      mesh.Triangle(face, centre, b, a);
+    }
+  }
+}
+
+// Side wall between two loops of the same size, facing away from the axis
+// (or towards it). Polygon loops get one face per side.
+void Walls(Builder &mesh, const Loop &bottom, const Loop &top, bool outward,
+           bool facePerSide) {
+  const std::size_t n = bottom.Size();
+  int face = mesh.Face();
+  for (std::size_t j = 0; j < n; ++j) {
+    if (facePerSide && j > 0) {
+      face = mesh.Face();
+    }
+    const std::size_t next = (j + 1) % n;
+    if (outward) {
+      mesh.Quad(face, bottom.ids[j], bottom.ids[next], top.ids[next],
+                top.ids[j]);
+    } else {
+      mesh.Quad(face, top.ids[j], top.ids[next], bottom.ids[next],
+                bottom.ids[j]);
+    }
+  }
+}
+
+// Planar annulus between two loops at the same height, facing +z or -z. The
+// loops are merged by angle, so their vertex counts and start angles need not
+// match.
+void Annulus(Builder &mesh, int face, const Loop &inner, const Loop &outer,
+             bool up) {
+  const std::size_t ni = inner.Size(), no = outer.Size();
+  // Start the outer loop at the vertex nearest the inner loop's first one
+  std::size_t start = 0;
+  double nearest = std::numeric_limits<double>::max();
+  for (std::size_t j = 0; j < no; ++j) {
+    const double gap = std::remainder(outer.angles[j] - inner.angles[0], kTwoPi);
+    if (std::fabs(gap) < nearest) {
+      nearest = std::fabs(gap);
+      start = j;
+    }
+  }
+  const double shift = outer.angles[start] -
+                       (inner.angles[0] + std::remainder(outer.angles[start] -
+                                                             inner.angles[0],
+                                                         kTwoPi));
+  // Angles unwrapped past a full turn, so both walks ascend monotonically
+  auto innerAngle = [&](std::size_t i) {
+    return inner.angles[i % ni] + kTwoPi * static_cast<double>(i / ni);
+  };
+  auto outerAngle = [&](std::size_t t) {
+    const std::size_t j = start + t;
+    return outer.angles[j % no] + kTwoPi * static_cast<double>(j / no) - shift;
+  };
+  auto innerId = [&](std::size_t i) { return inner.ids[i % ni]; };
+  auto outerId = [&](std::size_t t) { return outer.ids[(start + t) % no]; };
+
+  std::size_t i = 0, t = 0;
+  while (i < ni || t < no) {
+    const bool advanceInner =
+        (t == no) || (i < ni && innerAngle(i + 1) < outerAngle(t + 1));
+    if (advanceInner) {
+      if (up) {
+        mesh.Triangle(face, innerId(i), outerId(t), innerId(i + 1));
+      } else {
+        mesh.Triangle(face, innerId(i), innerId(i + 1), outerId(t));
+      }
+      ++i;
+    } else {
+      if (up) {
+        mesh.Triangle(face, innerId(i), outerId(t), outerId(t + 1));
+      } else {
+        mesh.Triangle(face, innerId(i), outerId(t + 1), outerId(t));
+      }
+      ++t;
+    }
+  }
+}
+
+// Radius of a threaded surface as a function of angle and height: the groove
+// profile swept along a right-handed helix (or revolved, for the simplified
+// thread), capped by the blank radius and, for the bolt, by the 45 degree tip
+// chamfer.
+struct ThreadField {
+  double pitch;
+  double phase; // groove centres sit at z = phase + pitch * angle / 2pi (mod pitch)
+  bool helical; // false: revolved grooves at z = phase (mod pitch)
+  double rootRadius;
+  double outerRadius; // groove radius at the flank ends, half a pitch out
+  double capRadius;
+  double tipRadius; // radius of the chamfer cone at z = 0
+
+  // Radius of the groove at offset w from its centre, |w| <= pitch / 2
+  double Groove(double w) const {
+    const double flank = std::fabs(w) - kRootHalfWidth * pitch;
+    if (flank <= 0.0) {
+      return rootRadius;
+    }
+    return rootRadius + (outerRadius - rootRadius) * flank /
+                            ((0.5 - kRootHalfWidth) * pitch);
+  }
+
+  // Offset from the nearest groove centre along the axis
+  double Offset(double angle, double z) const {
+    const double lead = helical ? pitch * angle / kTwoPi : 0.0;
+    return std::remainder(z - phase - lead, pitch);
+  }
+
+  double Radius(double angle, double z) const {
+    return std::min({capRadius, Groove(Offset(angle, z)), tipRadius + z});
+  }
+};
+
+ThreadField MakeThreadField(const BoltParameters &p, double phase,
+                            double capRadius, double tipRadius) {
+  const double pitch = p.thread.pitch;
+  const double minorRadius = 0.5 * MinorDiameter(p);
+  ThreadField field;
+  field.pitch = pitch;
+  field.helical = (p.thread.lod != ThreadLod::SIMPLIFIED);
+  field.phase = field.helical ? phase : phase + kLevelRowShift * pitch;
+  field.rootRadius = minorRadius - kThreadClearance * pitch;
+  field.outerRadius = minorRadius + (kThreadDepth + kThreadClearance) * pitch;
+  field.capRadius = capRadius;
+  field.tipRadius = tipRadius;
+  return field;
+}
+
+Loop Ring(Builder &mesh, const Columns &columns, const ThreadField &field,
+          double z) {
+  Loop loop;
+  for (int i = 0; i < columns.Count(); ++i) {
+    const double r = field.Radius(columns.angle[i], z);
+    loop.ids.push_back(
+        mesh.Vertex(r * columns.cosine[i], r * columns.sine[i], z));
+    loop.angles.push_back(columns.angle[i]);
+  }
+  return loop;
+}
+
+// Groove offsets of the rows within one pitch, ascending from -pitch / 2:
+// every kink of the capped profile, subdivided to kMaxRowSpacing
+std::vector<double> RowOffsets(const ThreadField &field) {
+  const double pitch = field.pitch;
+  std::vector<double> breaks = {-0.5 * pitch};
+  if (field.capRadius > field.rootRadius) {
+    breaks.push_back(-kRootHalfWidth * pitch);
+    breaks.push_back(kRootHalfWidth * pitch);
+    if (field.capRadius < field.outerRadius) {
+      const double crest =
+          kRootHalfWidth * pitch + (0.5 - kRootHalfWidth) * pitch *
+                                       (field.capRadius - field.rootRadius) /
+                                       (field.outerRadius - field.rootRadius);
+      breaks.push_back(-crest);
+      breaks.push_back(crest);
+    }
+  }
+  std::sort(breaks.begin(), breaks.end());
+  breaks.push_back(0.5 * pitch);
+
+  std::vector<double> offsets;
+  for (std::size_t b = 0; b + 1 < breaks.size(); ++b) {
+    const double span = breaks[b + 1] - breaks[b];
+    if (span <= 0.0) {
+      continue;
+    }
+    const int parts =
+        std::max(1, static_cast<int>(std::ceil(span / (kMaxRowSpacing * pitch) -
+                                               1e-9)));
+    for (int s = 0; s < parts; ++s) {
+      offsets.push_back(breaks[b] + span * s / parts);
+    }
+  }
+  return offsets;
+}
+
+// Threaded surface between the rings `lower` (at zLo) and `upper` (at zHi),
+// which must sample field.Radius() on the columns. Row k of the grid follows
+// the helix: column i sits pitch * i / n higher than column 0, so column n of
+// row k is column 0 of the row one pitch up. Revolved grooves have level rows
+// that close on themselves. Grid vertices beyond zLo or zHi
+// are clamped onto the ring vertex of their column; the triangles this
+// collapses are dropped and the rest close the gap to the rings exactly.
+void ThreadSurface(Builder &mesh, const Columns &columns,
+                   const ThreadField &field, double zLo, double zHi,
+                   const Loop &lower, const Loop &upper, bool outward) {
+  const int n = columns.Count();
+  const double pitch = field.pitch;
+  const double epsilon = 1e-6 * pitch;
+  const std::vector<double> offsets = RowOffsets(field);
+  const long perPitch = static_cast<long>(offsets.size());
+
+  // One face per stretch of the profile: root, crest and the two flanks
+  const int rootFace = mesh.Face(), crestFace = mesh.Face();
+  const int lowerFlankFace = mesh.Face(), upperFlankFace = mesh.Face();
+  std::vector<int> rowFace(perPitch);
+  for (long j = 0; j < perPitch; ++j) {
+    const double next = (j + 1 < perPitch) ? offsets[j + 1] : 0.5 * pitch;
+    const double middle = 0.5 * (offsets[j] + next);
+    if (std::fabs(middle) < kRootHalfWidth * pitch) {
+      rowFace[j] = rootFace;
+    } else if (field.Groove(middle) >= field.capRadius) {
+      rowFace[j] = crestFace;
+    } else {
+      rowFace[j] = (middle < 0.0) ? lowerFlankFace : upperFlankFace;
+    }
+  }
+
+  // Rows start a pitch below zLo, so row 0 is clamped in every column, and
+  // run two pitches past zHi, so every wrapped corner exists
+  const double firstTurn = std::floor((zLo - field.phase) / pitch) - 2.0;
+  auto rowBase = [&](long k) {
+    return field.phase + (firstTurn + static_cast<double>(k / perPitch)) * pitch +
+           offsets[k % perPitch];
+  };
+  long rows = 0;
+  while (rowBase(rows) < zHi + 2.0 * pitch) {
+    ++rows;
+  }
+  ++rows;
+
+  // Rows are evaluated column-wise in flat loops over the shared table
+  std::vector<std::uint32_t> ids(static_cast<std::size_t>(rows) * n);
+  std::vector<double> z(n), r(n);
+  const double rise = field.helical ? pitch / n : 0.0;
+  for (long k = 0; k < rows; ++k) {
+    const double base = rowBase(k);
+    // Every vertex of a row has the same groove offset
+    const double groove =
+        std::min(field.capRadius, field.Groove(offsets[k % perPitch]));
+    for (int i = 0; i < n; ++i) {
+      z[i] = base + rise * i;
+      r[i] = std::min(groove, field.tipRadius + z[i]);
+    }
+    std::uint32_t *row = &ids[static_cast<std::size_t>(k) * n];
+    for (int i = 0; i < n; ++i) {
+      if (z[i] <= zLo + epsilon) {
+        row[i] = lower.ids[i];
+      } else if (z[i] >= zHi - epsilon) {
+        row[i] = upper.ids[i];
+      } else {
+        row[i] = mesh.Vertex(r[i] * columns.cosine[i], r[i] * columns.sine[i],
+                             z[i]);
+      }
+    }
+  }
+
+  auto id = [&](long k, int i) {
+    if (i == n) {
+      k += field.helical ? perPitch : 0;
+      i = 0;
+    }
+    return ids[static_cast<std::size_t>(k) * n + i];
+  };
+  for (long k = 0; k + 1 + perPitch < rows && rowBase(k) < zHi; ++k) {
+    const int face = rowFace[k % perPitch];
+    for (int i = 0; i < n; ++i) {
+      const std::uint32_t a = id(k, i), b = id(k, i + 1), c = id(k + 1, i + 1),
+                          d = id(k + 1, i);
+      if (outward) {
+        mesh.Quad(face, a, b, c, d);
+      } else {
+        mesh.Quad(face, d, c, b, a);
+      }
+    }
+  }
+}
+
+// Shank whose thread is not modelled, as Bolt::Shank() makes it: a cylinder
+// at the blank (none) or pitch (cosmetic) radius up to zThread, cut back to
+// the cone r = tipRadius + z, then the grip up to the returned ring at zTop
+Loop PlainShank(Builder &mesh, const Columns &columns, const BoltParameters &p,
+                double tipRadius, double zThread, double zTop) {
+  const double capRadius = 0.5 * (p.thread.majorDiameter - p.shank.bodyTolerance);
+  const double radius = (p.thread.lod == ThreadLod::COSMETIC)
+                            ? 0.5 * PitchDiameter(p)
+                            : capRadius;
+  if (radius >= capRadius) {
+    zThread = zTop;
+  }
+
+  Loop lower = Circle(mesh, columns, std::min(radius, tipRadius), 0.0);
+  Cap(mesh, mesh.Face(), lower, false);
+  const double zCone = std::min(radius - tipRadius, zThread);
+  if (zCone > 0.0) {
+    const Loop cone = Circle(mesh, columns, tipRadius + zCone, zCone);
+    Walls(mesh, lower, cone, true, false);
+    lower = cone;
+  }
+  if (zCone < zThread) {
+    const Loop top = Circle(mesh, columns, radius, zThread);
+    Walls(mesh, lower, top, true, false);
+    lower = top;
+  }
+  if (zThread < zTop) {
+    const Loop gripBottom = Circle(mesh, columns, capRadius, zThread);
+    Annulus(mesh, mesh.Face(), lower, gripBottom, false);
+    lower = Circle(mesh, columns, capRadius, zTop);
+    Walls(mesh, gripBottom, lower, true, false);
+  }
+  return lower;
+}
+
+// Radius of the nut bore where its thread is not modelled (as Nut::Nut()
+// cuts it), or 0 for a threaded bore
+double PlainBoreRadius(const BoltParameters &p) {
+  const double clearance = p.nut.tolerance + p.nut.threadClearance;
+  switch (p.thread.lod) {
+  case ThreadLod::NONE:
+    return 0.5 * p.thread.majorDiameter + clearance;
+  case ThreadLod::COSMETIC:
+    return 0.5 * PitchDiameter(p) + clearance;
+  default:
+    return 0.0;
+  }
+}
+
+// The shank from its tip at z = 0 up to the ring at zTop, which it returns:
+// the thread, cut back to the cone r = tipRadius + z (infinity leaves it
+// square), then the grip. The tip is closed.
+Loop Shank(Builder &mesh, const Columns &columns, const BoltParameters &p,
+           double tipRadius, double zTop) {
+  const double pitch = p.thread.pitch;
+  const double L = p.shank.totalLength;
+  const double capRadius = 0.5 * (p.thread.majorDiameter - p.shank.bodyTolerance);
+  const double ls = ClampedGripLength(p);
+  const bool threaded = (L - ls >= pitch);
+  const bool hasGrip = (ls > 0.1);
+
+  if (!threaded) {
+    // Too short to thread: a plain cylinder, as Bolt::Shank() makes it
+    const Loop tip = Circle(mesh, columns, capRadius, 0.0);
+    Cap(mesh, mesh.Face(), tip, false);
+    const Loop top = Circle(mesh, columns, capRadius, zTop);
+    Walls(mesh, tip, top, true, false);
+    return top;
+  }
+
+  // The thread section ends where the grip begins; without a grip it runs
+  // up into the head
+  const double threadEnd = hasGrip ? L - ls : L;
+  const double zThread = std::min(threadEnd, zTop);
+  if (p.thread.lod == ThreadLod::NONE || p.thread.lod == ThreadLod::COSMETIC) {
+    return PlainShank(mesh, columns, p, tipRadius, zThread, zTop);
+  }
+  const ThreadField field = MakeThreadField(p, threadEnd, capRadius, tipRadius);
+
+  const Loop tip = Ring(mesh, columns, field, 0.0);
+  Hub(mesh, mesh.Face(), tip, 0.0, false);
+
+  Loop threadTop, gripBottom;
+  const bool gripVisible = hasGrip && zThread < zTop;
+  if (gripVisible) {
+    // Where the thread reaches the blank radius it joins the grip on the
+    // grip's own vertices; elsewhere the step between them is an annulus
+    gripBottom = Circle(mesh, columns, capRadius, zThread);
+    for (int i = 0; i < columns.Count(); ++i) {
+      const double r = field.Radius(columns.angle[i], zThread);
+      threadTop.ids.push_back(
+          (r >= capRadius)
+              ? gripBottom.ids[i]
+              : mesh.Vertex(r * columns.cosine[i], r * columns.sine[i],
+                            zThread));
+      threadTop.angles.push_back(columns.angle[i]);
+    }
+  } else {
+    threadTop = Ring(mesh, columns, field, zThread);
+  }
+  ThreadSurface(mesh, columns, field, 0.0, zThread, tip, threadTop, true);
+  if (!gripVisible) {
+    return threadTop;
+  }
+  Annulus(mesh, mesh.Face(), threadTop, gripBottom, false);
+  const Loop top = Circle(mesh, columns, capRadius, zTop);
+  Walls(mesh, gripBottom, top, true, false);
+  return top;
+}
+
+// Head from zBottom up, socket included. Its underside is an annulus around
+// `shankTop` if given, else a plain cap; the socket floor stays `clearance`
+// above zBottom.
+void Head(Builder &mesh, const Columns &columns, const BoltParameters &p,
+          double zBottom, double clearance, const Loop *shankTop) {
+  const double s = p.head.widthAcrossFlats;
+  const double k = p.head.height;
+  const double zTop = zBottom + k;
+  const bool cylinderHead = (p.head.type == HeadType::SOCKET_CAP ||
+                             p.head.type == HeadType::FLAT ||
+                             p.head.type == HeadType::COUNTERSUNK);
+  const Loop base = cylinderHead ? Circle(mesh, columns, 0.5 * s, zBottom)
+                                 : Hex(mesh, s, zBottom);
+  const Loop top = cylinderHead ? Circle(mesh, columns, 0.5 * s, zTop)
+                                : Hex(mesh, s, zTop);
+  if (shankTop) {
+    Annulus(mesh, mesh.Face(), *shankTop, base, false);
+  } else {
+    Cap(mesh, mesh.Face(), base, false);
+  }
+  Walls(mesh, base, top, true, !cylinderHead);
+
+  if (p.head.type == HeadType::SOCKET_CAP && p.head.socketSize > 0.0 &&
+      p.head.socketDepth > 0.0) {
+    const double depth = std::min(p.head.socketDepth, k - clearance);
+    const Loop mouth = Hex(mesh, p.head.socketSize, zTop);
+    const Loop floor = Hex(mesh, p.head.socketSize, zTop - depth);
+    Annulus(mesh, mesh.Face(), mouth, top, true);
+    Walls(mesh, floor, mouth, false, true);
+    Cap(mesh, mesh.Face(), floor, true);
+  } else {
+    Cap(mesh, mesh.Face(), top, true);
+  }
+}
+
+// Ring the tip chamfer takes off: everything outside the 45 degree cone
+// r = tipRadius + z, out to `outerRadius`, from `margin` below the tip
+TriMesh ChamferCutter(const Columns &columns, double tipRadius,
+                      double outerRadius, double margin) {
+  Builder mesh;
+  const Loop coneBottom =
+      Circle(mesh, columns, tipRadius - margin, -margin);
+  const Loop outerBottom = Circle(mesh, columns, outerRadius, -margin);
+  const Loop rim = Circle(mesh, columns, outerRadius, outerRadius - tipRadius);
+  Annulus(mesh, mesh.Face(), coneBottom, outerBottom, false);
+  Walls(mesh, outerBottom, rim, true, false);
+  Walls(mesh, coneBottom, rim, false, false);
+  return mesh.Finish();
+}
+
+// Column count for the mesh-CSG primitives. An odd count keeps every column
+// plane off the hex corners, where a column edge would run through a cap
+// edge of the other primitive.
+int CsgColumnCount(double radius, double deflection) {
+  return ColumnCount(radius, deflection) | 1;
+}
+} // namespace
+
+TriMesh TessellateBolt(const BoltParameters &p, double deflection) {
+  const double d = p.thread.majorDiameter;
+  const double pitch = p.thread.pitch;
+  const double L = p.shank.totalLength;
+  const double s = p.head.widthAcrossFlats;
+
+  // Placement as in Bolt::Bolt(): tip at z = 0, head overlapping the shank
+  const double overlap = (L > 0.2) ? 0.1 : 0.5 * L;
+  const double zHead = L - overlap;
+
+  const bool cylinderHead = (p.head.type == HeadType::SOCKET_CAP ||
+                             p.head.type == HeadType::FLAT ||
+                             p.head.type == HeadType::COUNTERSUNK);
+  const double headRadius = cylinderHead ? 0.5 * s : s / std::sqrt(3.0);
+  const Columns columns = MakeColumns(ColumnCount(headRadius, deflection));
+  Builder mesh;
+
+  // Head, its underside closing the shank
+  const Loop shankTop = Shank(mesh, columns, p, 0.5 * d - pitch, zHead);
+  Head(mesh, columns, p, zHead, overlap, &shankTop);
+  return mesh.Finish();
+}
+
+TriMesh TessellateNut(const BoltParameters &p, double deflection) {
+  const double pitch = p.thread.pitch;
+  const double h = p.nut.height;
+  const double s = p.nut.widthAcrossFlats;
+  const double shaftRadius =
+      0.5 * p.thread.majorDiameter + p.nut.tolerance + p.nut.threadClearance;
+
+  const Columns columns =
+      MakeColumns(ColumnCount(s / std::sqrt(3.0), deflection));
+  Builder mesh;
+
+  // The bore is the threaded shaft Nut::Nut() subtracts, seen from inside
+  const double plainRadius = PlainBoreRadius(p);
+  Loop boreBottom, boreTop;
+  if (plainRadius > 0.0) {
+    boreBottom = Circle(mesh, columns, plainRadius, 0.0);
+    boreTop = Circle(mesh, columns, plainRadius, h);
+    Walls(mesh, boreBottom, boreTop, false, false);
+  } else {
+    const ThreadField field =
+        MakeThreadField(p, -0.5 * pitch - kNutShaftOverlap, shaftRadius,
+                        std::numeric_limits<double>::infinity());
+    boreBottom = Ring(mesh, columns, field, 0.0);
+    boreTop = Ring(mesh, columns, field, h);
+    ThreadSurface(mesh, columns, field, 0.0, h, boreBottom, boreTop, false);
+  }
+
+  const Loop bottom = Hex(mesh, s, 0.0);
+  const Loop top = Hex(mesh, s, h);
+  Walls(mesh, bottom, top, true, true);
+  Annulus(mesh, mesh.Face(), boreBottom, bottom, false);
+  Annulus(mesh, mesh.Face(), boreTop, top, true);
+  return mesh.Finish();
+}
+
+TriMesh MeshCsgBolt(const BoltParameters &p, double deflection) {
+  const double d = p.thread.majorDiameter;
+  const double pitch = p.thread.pitch;
+  const double L = p.shank.totalLength;
+  const double s = p.head.widthAcrossFlats;
+  const double capRadius = 0.5 * (d - p.shank.bodyTolerance);
+  const double overlap = (L > 0.2) ? 0.1 : 0.5 * L;
+  const double zHead = L - overlap;
+  const bool cylinderHead = (p.head.type == HeadType::SOCKET_CAP ||
+                             p.head.type == HeadType::FLAT ||
+                             p.head.type == HeadType::COUNTERSUNK);
+  const double headRadius = cylinderHead ? 0.5 * s : s / std::sqrt(3.0);
+  const int count = CsgColumnCount(headRadius, deflection);
+  const Columns columns = MakeColumns(count);
+
+  // Primitives overlap rather than touch: the shank ends inside the head
+  // and the cutter starts below the tip
+  Builder shank;
+  const Loop shankTop = Shank(shank, columns, p,
+                              std::numeric_limits<double>::infinity(),
+                              zHead + 0.5 * overlap);
+  Hub(shank, shank.Face(), shankTop, zHead + 0.5 * overlap, true);
+  Builder head;
+  Head(head, columns, p, zHead, overlap, nullptr);
+
+  TriMesh body = shank.Finish();
+  const double tipRadius = 0.5 * d - pitch;
+  if (L - ClampedGripLength(p) >= pitch && tipRadius > 0.0) {
+    // Cutter columns sit halfway between the shank's
+    const double margin = std::min(0.25 * pitch, 0.5 * tipRadius);
+    TriMesh chamfered;
+    if (!MeshBoolean(body,
+                     ChamferCutter(MakeColumns(count, M_PI / count), tipRadius,
+                                   capRadius + margin, margin),
+                     MeshBooleanOp::DIFFERENCE, chamfered)) {
+      return TriMesh();
+    }
+    body = std::move(chamfered);
+  }
+  TriMesh bolt;
+  if (!MeshBoolean(body, head.Finish(), MeshBooleanOp::UNION, bolt)) {
+    return TriMesh();
+  }
+  return bolt;
+}
+
+TriMesh MeshCsgNut(const BoltParameters &p, double deflection) {
+  const double pitch = p.thread.pitch;
+  const double h = p.nut.height;
+  const double s = p.nut.widthAcrossFlats;
+  const double shaftRadius =
+      0.5 * p.thread.majorDiameter + p.nut.tolerance + p.nut.threadClearance;
+  const Columns columns =
+      MakeColumns(CsgColumnCount(s / std::sqrt(3.0), deflection));
+
+  Builder body;
+  const Loop bottom = Hex(body, s, 0.0);
+  const Loop top = Hex(body, s, h);
+  Cap(body, body.Face(), bottom, false);
+  Walls(body, bottom, top, true, true);
+  Cap(body, body.Face(), top, true);
+
+  // The threaded shaft Nut::Nut() subtracts, past both faces
+  Builder shaft;
+  const double margin = 0.25 * pitch;
+  const double plainRadius = PlainBoreRadius(p);
+  if (plainRadius > 0.0) {
+    const Loop shaftBottom = Circle(shaft, columns, plainRadius, -margin);
+    const Loop shaftTop = Circle(shaft, columns, plainRadius, h + margin);
+    Cap(shaft, shaft.Face(), shaftBottom, false);
+    Walls(shaft, shaftBottom, shaftTop, true, false);
+    Cap(shaft, shaft.Face(), shaftTop, true);
+  } else {
+    const ThreadField field =
+        MakeThreadField(p, -0.5 * pitch - kNutShaftOverlap, shaftRadius,
+                        std::numeric_limits<double>::infinity());
+    const Loop shaftBottom = Ring(shaft, columns, field, -margin);
+    const Loop shaftTop = Ring(shaft, columns, field, h + margin);
+    Hub(shaft, shaft.Face(), shaftBottom, -margin, false);
+    ThreadSurface(shaft, columns, field, -margin, h + margin, shaftBottom,
+                  shaftTop, true);
+    Hub(shaft, shaft.Face(), shaftTop, h + margin, true);
+  }
+
+  TriMesh nut;
+  if (!MeshBoolean(body.Finish(), shaft.Finish(), MeshBooleanOp::DIFFERENCE,
+                   nut)) {
+    return TriMesh();
+  }
+  return nut;
+}
@@ -0,0 +1,35 @@
+/*
+    BoltGenerator - Analytic tessellation
+    Copyright (C) 2025
+*/
+
+#ifndef TESSELLATE_H
+#define TESSELLATE_H
+
+#include "parameters.h"
+#include "trimesh.h"
+
+// Meshes the bolt and nut straight from their parameters, in the same frame
+// as Bolt and Nut, without building or meshing a B-rep. The thread is a
+// sheared grid that follows the helix (rows along the thread at the profile
+// breaks, columns at fixed angles), clipped at its ends onto shared rings, so
+// the result is closed and consistently oriented by construction. Lower
+// thread levels of detail (ThreadLod) give level rows (revolved grooves) or
+// a plain cylinder.
+//
+// Meant for previews: fillets and washer faces are left out, and the tip
+// chamfer is only followed to the row spacing. `deflection` is the chordal
+// error (mm) of the circular sections. The meshes are welded, carry a face
+// mapping (one face per thread flank, wall, cap...) and no normals; see
+// SplitFaces().
+TriMesh TessellateBolt(const BoltParameters &p, double deflection);
+TriMesh TessellateNut(const BoltParameters &p, double deflection);
+
+// The same parts built the way Bolt and Nut build them, from closed meshed
+// primitives combined by mesh booleans (see csg.h): the shank (thread and
+// grip) minus the tip chamfer ring, plus the head; the hex body minus the
+// threaded shaft. Returns an empty mesh if a boolean fails.
+TriMesh MeshCsgBolt(const BoltParameters &p, double deflection);
+TriMesh MeshCsgNut(const BoltParameters &p, double deflection);
+
+#endif // TESSELLATE_H
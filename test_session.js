@@ -0,0 +1,110 @@
+// Session downloads end to end: the server runs against a stand-in engine
+// that speaks the session protocol (ready, then one reply per requested
+// file on the fourth pipe) and writes nothing until asked, so every output
+// below is produced through materialize(), by the job's live session or by
+// one restarted after the first has gone idle.
+const { spawn } = require('child_process');
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const fakeEngine = path.join(os.tmpdir(), `fake_engine_${process.pid}.js`);
+fs.writeFileSync(fakeEngine, `#!/usr/bin/env node
+const fs = require('fs');
+const path = require('path');
+fs.writeSync(3, 'ready\\n');
+let buffer = '';
+process.stdin.setEncoding('utf8');
+process.stdin.on('data', chunk => {
+    buffer += chunk;
+    let end;
+    while ((end = buffer.indexOf('\\n')) >= 0) {
+        const file = buffer.slice(0, end);
+        buffer = buffer.slice(end + 1);
+        fs.writeFileSync(path.join('Tests', file), file);
+        fs.writeSync(3, 'ok ' + file + '\\n');
+    }
+});
+`);
+fs.chmodSync(fakeEngine, 0o755);
+
+const port = 20000 + Math.floor(Math.random() * 20000);
+const sessionIdleMs = 1000;
+const server = spawn(process.execPath, ['server.js'], {
+    cwd: __dirname,
+    env: {
+        ...process.env,
+        PORT: port,
+        ENGINE: fakeEngine,
+        RESULT_CACHE_DIR: '',
+        SESSION_IDLE_MS: sessionIdleMs
+    },
+    stdio: ['ignore', 'ignore', 'inherit']
+});
+const base = `http://localhost:${port}`;
+const created = [];
+
+async function listening() {
+    for (let i = 0; i < 100; ++i) {
+        try {
+            await fetch(base);
+            return;
+        } catch (e) {
+            await new Promise(resolve => setTimeout(resolve, 50));
+        }
+    }
+    throw new Error('server did not start');
+}
+
+async function fetchOutput(url) {
+    const res = await fetch(base + url);
+    assert.strictEqual(res.status, 200, `${url} answered ${res.status}`);
+    const file = path.basename(url);
+    created.push(path.join(__dirname, 'Tests', file));
+    assert.strictEqual(await res.text(), file);
+}
+
+async function generate(params) {
+    const res = await fetch(`${base}/generate`, {
+        method: 'POST',
+        headers: { 'Content-Type': 'application/json' },
+        body: JSON.stringify(params)
+    });
+    const job = await res.json();
+    assert.ok(job.success, 'generate failed');
+    return job;
+}
+
+async function main() {
+    await listening();
+    const job = await generate({ generateNut: true });
+    await fetchOutput(job.boltStep);
+    await fetchOutput(job.nutStep);
+    await fetchOutput(job.assemblyStep);
+
+    // The session has ended by now; the download restarts it
+    const idle = await generate({ generateNut: true });
+    await new Promise(resolve => setTimeout(resolve, 2 * sessionIdleMs));
+    await fetchOutput(idle.assemblyStep);
+
+    // Pattern jobs also preview the assembly as GLB
+    const pattern = await generate({
+        generateNut: true,
+        pattern: { type: 'circle', count: 4, radius: 20 }
+    });
+    assert.ok(pattern.assemblyGlb, 'pattern job has no assembly preview');
+    await fetchOutput(pattern.assemblyGlb);
+    console.log('Session downloads OK');
+}
+
+main().then(() => {
+    process.exitCode = 0;
+}, error => {
+    console.error(error.message);
+    process.exitCode = 1;
+}).finally(() => {
+    server.kill();
+    created.forEach(file => fs.rmSync(file, { force: true }));
+    fs.rmSync(fakeEngine, { force: true });
+});
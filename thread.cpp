@@ -17,31 +17,226 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#define _USE_MATH_DEFINES
 #include "thread.h"
 
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <BRepBuilderAPI_MakePolygon.hxx>
+#include <BRepPrimAPI_MakeRevol.hxx>
+#include <GC_MakeArcOfCircle.hxx>
+#include <Geom_TrimmedCurve.hxx>
+#include <Precision.hxx>
+#include <TopoDS.hxx>
+#include <gp_Pnt2d.hxx>
+#include <gp_Vec2d.hxx>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+namespace {
+// Residual angle at which the crest arc leaves the blank. Ending the arc
+// tangent to the blank cylinder would leave the boolean a tangent contact.
+const double kCrestExitAngle = 20.0 * M_PI / 180.0;
+
+// Straight or circular edge of the profile, in the XZ plane
+struct Segment {
+  gp_Pnt2d from, mid, to; // (x, z); mid only for arcs
+  bool arc;
+};
+
+gp_Pnt OnProfile(const gp_Pnt2d &p) { return gp_Pnt(p.X(), 0.0, p.Y()); }
+
+TopoDS_Edge MakeEdge(const Segment &s) {
+  if (!s.arc) {
+    return BRepBuilderAPI_MakeEdge(OnProfile(s.from), OnProfile(s.to)).Edge();
+  }
+  Handle(Geom_TrimmedCurve) arc =
+      GC_MakeArcOfCircle(OnProfile(s.from), OnProfile(s.mid), OnProfile(s.to))
+          .Value();
+  return BRepBuilderAPI_MakeEdge(arc).Edge();
+}
+
+// Point at angle `t` on the circle of `radius` about `centre`, where `t`
+// is measured from the +z axis towards -x (root) or from -z towards +x
+// (crest)
+gp_Pnt2d RootArcPoint(const gp_Pnt2d &centre, double radius, double t) {
+  return gp_Pnt2d(centre.X() - radius * std::sin(t),
+                  centre.Y() + radius * std::cos(t));
+}
+
+gp_Pnt2d CrestArcPoint(const gp_Pnt2d &centre, double radius, double t) {
+  return gp_Pnt2d(centre.X() + radius * std::sin(t),
+                  centre.Y() - radius * std::cos(t));
+}
+} // namespace
+
 TopoDS_Solid Thread(double diameter, // Minor Diameter
-                    double pitch, double length) {
+                    double pitch, double length,
+                    const ThreadRounding &rounding) {
   // ISO-style 60 degree thread profile
   // We make it slightly deeper to ensure it always cuts the shank
   const double depth = 0.614 * pitch; // Standard ISO depth is 0.614p
   const double h_clearance =
       0.05 * pitch; // Add small radial clearance for robustness
 
-  std::vector<gp_Pnt> vertex;
-  // (x, y, z)
-  // x is radial distance from center
-  // We start slightly inside the major diameter and go out
-  vertex = {gp_Pnt(0.5 * diameter - h_clearance, 0.0, -0.125 * pitch),
-            gp_Pnt(0.5 * diameter - h_clearance, 0.0, 0.125 * pitch),
-            gp_Pnt(0.5 * diameter + depth + h_clearance, 0.0, 0.5 * pitch),
-            gp_Pnt(0.5 * diameter + depth + h_clearance, 0.0, -0.5 * pitch)};
+  // (x, z): x is radial distance from center. The root flat runs from
+  // -P/8 to P/8 slightly inside the minor diameter, the flanks go out to
+  // the outer edge past the major diameter. The upper half is built and
+  // mirrored about z = 0.
+  const double rootX = 0.5 * diameter - h_clearance;
+  const double outerX = 0.5 * diameter + depth + h_clearance;
+  const gp_Pnt2d flankStart(rootX, 0.125 * pitch);
+  const gp_Pnt2d flankEnd(outerX, 0.5 * pitch);
+  const double flankAngle = std::atan2(flankEnd.Y() - flankStart.Y(),
+                                       flankEnd.X() - flankStart.X());
+  const gp_Vec2d flank(std::cos(flankAngle), std::sin(flankAngle));
+  const gp_Vec2d flankNormal(-std::sin(flankAngle), std::cos(flankAngle));
+  // A fillet between the axial direction and a flank touches both this
+  // many radii from the corner
+  const double tangentRatio = std::tan(0.25 * M_PI - 0.5 * flankAngle);
 
+  // Root arc, kept short of the middle of the root flat
+  double rootRadius = std::max(0.0, rounding.root);
+  const double maxRootRadius = 0.9 * 0.125 * pitch / tangentRatio;
+  if (rootRadius > maxRootRadius) {
+    std::cout << "Thread: Root radius " << rootRadius << " reduced to "
+              << maxRootRadius << " to fit the pitch" << std::endl;
+    rootRadius = maxRootRadius;
+  }
+  const double rootTangent = rootRadius * tangentRatio;
+
+  // Crest arc at the corner K the flank makes with the blank. It leaves
+  // the blank at kCrestExitAngle and runs on straight to a bit past it,
+  // then radially to the outer edge, staying clear of the next turn.
+  double crestRadius = 0.0;
+  gp_Pnt2d corner;
+  double exitX = 0.0;
+  const double blankX = 0.5 * rounding.blankDiameter;
+  if (rounding.crest > 0.0 && blankX > rootX && blankX < outerX) {
+    corner = flankStart.Translated(flank * ((blankX - rootX) /
+                                            std::cos(flankAngle)));
+    const double topZ = 0.48 * pitch;
+    const double room = topZ - corner.Y();
+    if (room > 0.0) {
+      const double cotExit = 1.0 / std::tan(kCrestExitAngle);
+      exitX = blankX + std::min(0.25 * (outerX - blankX),
+                                0.5 * room / cotExit);
+      // Crest end height grows linearly with the radius
+      const gp_Vec2d arcEnd = flank * -tangentRatio + flankNormal +
+                              gp_Vec2d(std::cos(kCrestExitAngle),
+                                       -std::sin(kCrestExitAngle));
+      const double slope = arcEnd.Y() - arcEnd.X() * cotExit;
+      double maxCrestRadius =
+          (0.9 * corner.Distance(flankStart) - rootTangent) / tangentRatio;
+      if (slope > 0.0) {
+        maxCrestRadius = std::min(
+            maxCrestRadius,
+            (room - (exitX - blankX) * cotExit) / slope);
+      }
+      crestRadius = std::min(rounding.crest, std::max(0.0, maxCrestRadius));
+      if (crestRadius < rounding.crest) {
+        std::cout << "Thread: Crest radius " << rounding.crest
+                  << " reduced to " << crestRadius << " to fit the pitch"
+                  << std::endl;
+      }
+    }
+  }
+
+  std::vector<Segment> upper;
+  gp_Pnt2d last(rootX, 0.125 * pitch);
+  if (rootRadius > Precision::Confusion()) {
+    const gp_Pnt2d centre(rootX + rootRadius, 0.125 * pitch - rootTangent);
+    last = RootArcPoint(centre, rootRadius, 0.5 * M_PI);
+    const gp_Pnt2d end = RootArcPoint(centre, rootRadius, flankAngle);
+    upper.push_back(
+        {last,
+         RootArcPoint(centre, rootRadius, 0.5 * (0.5 * M_PI + flankAngle)),
+         end, true});
+    last = end;
+  }
+  if (crestRadius > Precision::Confusion()) {
+    const gp_Pnt2d start =
+        corner.Translated(flank * -(crestRadius * tangentRatio));
+    upper.push_back({last, gp_Pnt2d(), start, false});
+    const gp_Pnt2d centre = start.Translated(flankNormal * crestRadius);
+    const double endAngle = 0.5 * M_PI - kCrestExitAngle;
+    const gp_Pnt2d end = CrestArcPoint(centre, crestRadius, endAngle);
+    const gp_Pnt2d mid =
+        CrestArcPoint(centre, crestRadius, 0.5 * (flankAngle + endAngle));
+    upper.push_back({start, mid, end, true});
+    const gp_Pnt2d exit(exitX, end.Y() + (exitX - end.X()) /
+                                             std::tan(kCrestExitAngle));
+    upper.push_back({end, gp_Pnt2d(), exit, false});
+    last = exit;
+    const gp_Pnt2d outer(outerX, exit.Y());
+    upper.push_back({last, gp_Pnt2d(), outer, false});
+    last = outer;
+  } else {
+    upper.push_back({last, gp_Pnt2d(), flankEnd, false});
+    last = flankEnd;
+  }
+
+  // Root flat, upper half, outer edge, then the upper half mirrored back
+  auto mirror = [](const gp_Pnt2d &p) { return gp_Pnt2d(p.X(), -p.Y()); };
   BRepBuilderAPI_MakeWire wire;
-  for (int ct = 0; ct < int(vertex.size()); ct++)
-    wire.Add(BRepBuilderAPI_MakeEdge(vertex.at(ct),
-                                     vertex.at((ct + 1) % vertex.size()))
-                 .Edge());
+  wire.Add(MakeEdge({mirror(upper.front().from), gp_Pnt2d(),
+                     upper.front().from, false}));
+  for (const Segment &s : upper) {
+    wire.Add(MakeEdge(s));
+  }
+  wire.Add(MakeEdge({last, gp_Pnt2d(), mirror(last), false}));
+  for (auto s = upper.rbegin(); s != upper.rend(); ++s) {
+    wire.Add(
+        MakeEdge({mirror(s->to), mirror(s->mid), mirror(s->from), s->arc}));
+  }
 
   // Make the helix slightly longer than requested to prevent cap-face issues
   return Helix(wire.Wire(), diameter, pitch, length);
 }
+
+TopoDS_Solid SimplifiedThread(double minorDiameter, double majorDiameter,
+                              double pitch, double length) {
+  const double rMinor = 0.5 * minorDiameter;
+  const double rMajor = 0.5 * majorDiameter;
+
+  // Radius as a function of z over one pitch: P/4 root flat (as in Thread()),
+  // straight flanks and a P/8 crest flat.
+  std::vector<std::pair<double, double>> breaks; // (z, r)
+  const int turns = static_cast<int>(std::ceil(length / pitch)) + 1;
+  for (int k = -1; k <= turns; ++k) {
+    const double z0 = k * pitch;
+    breaks.push_back({z0 - 0.125 * pitch, rMinor});
+    breaks.push_back({z0 + 0.125 * pitch, rMinor});
+    breaks.push_back({z0 + 0.4375 * pitch, rMajor});
+    breaks.push_back({z0 + 0.5625 * pitch, rMajor});
+  }
+
+  auto radiusAt = [&](double z) {
+    for (std::size_t i = 1; i < breaks.size(); ++i) {
+      if (z <= breaks[i].first) {
+        const double t = (z - breaks[i - 1].first) /
+                         (breaks[i].first - breaks[i - 1].first);
+        return breaks[i - 1].second + t * (breaks[i].second - breaks[i - 1].second);
+      }
+    }
+    return breaks.back().second;
+  };
+
+  // Half cross-section in the XZ plane, closed along the axis
+  BRepBuilderAPI_MakePolygon profile;
+  profile.Add(gp_Pnt(0.0, 0.0, 0.0));
+  profile.Add(gp_Pnt(radiusAt(0.0), 0.0, 0.0));
+  const double minStep = 1.0e-3 * pitch;
+  for (const auto &b : breaks) {
+    if (b.first > minStep && b.first < length - minStep) {
+      profile.Add(gp_Pnt(b.second, 0.0, b.first));
+    }
+  }
+  profile.Add(gp_Pnt(radiusAt(length), 0.0, length));
+  profile.Add(gp_Pnt(0.0, 0.0, length));
+  profile.Close();
+
+  TopoDS_Face section = BRepBuilderAPI_MakeFace(profile.Wire()).Face();
+  return TopoDS::Solid(BRepPrimAPI_MakeRevol(section, gp::OZ()).Shape());
+}
@@ -28,8 +28,28 @@
 
 #include "helix.h"
 
+// ISO 68-1 rounding of the thread cutter. The root arc rounds the cutter's
+// inner corners, i.e. the thread roots. The crest arc rounds the corners
+// the flanks make with the blank cylinder of diameter blankDiameter; with no
+// blank the crests stay sharp. Radii too large for the pitch are reduced.
+struct ThreadRounding {
+  double root = 0.0;
+  double crest = 0.0;
+  double blankDiameter = 0.0;
+};
+
+// Helical groove cutter for a thread of the given minor diameter. The radii
+// are arcs of the swept profile, so the sweep rounds the thread by itself.
 TopoDS_Solid Thread(double diameter,
                     double pitch,
-                    double length);
+                    double length,
+                    const ThreadRounding &rounding = ThreadRounding());
+
+// Threaded rod approximated by stacked revolved V-grooves (no helix). It is a
+// single revolved solid, so it needs neither a sweep nor a boolean cut.
+TopoDS_Solid SimplifiedThread(double minorDiameter,
+                              double majorDiameter,
+                              double pitch,
+                              double length);
 
 #endif // THREAD_H
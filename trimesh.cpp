@@ -0,0 +1,109 @@
+#include "trimesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+void ComputeVertexNormals(TriMesh &mesh) {
+  const std::vector<float> &p = mesh.positions;
+  std::vector<float> &n = mesh.normals;
+  n.assign(p.size(), 0.0f);
+
+  for (std::size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+    std::uint32_t a = mesh.indices[t], b = mesh.indices[t + 1],
+                  c = mesh.indices[t + 2];
+    float ux = p[3 * b] - p[3 * a], uy = p[3 * b + 1] - p[3 * a + 1],
+          uz = p[3 * b + 2] - p[3 * a + 2];
+    float vx = p[3 * c] - p[3 * a], vy = p[3 * c + 1] - p[3 * a + 1],
+          vz = p[3 * c + 2] - p[3 * a + 2];
+    // Unnormalized cross product: its length is twice the triangle area
+    float cx = uy * vz - uz * vy;
+    float cy = uz * vx - ux * vz;
+    float cz = ux * vy - uy * vx;
+    for (std::uint32_t v : {a, b, c}) {
+      n[3 * v] += cx;
+      n[3 * v + 1] += cy;
+      n[3 * v + 2] += cz;
+    }
+  }
+
+  for (std::size_t v = 0; v + 2 < n.size(); v += 3) {
+    float len = std::sqrt(n[v] * n[v] + n[v + 1] * n[v + 1] + n[v + 2] * n[v + 2]);
+    if (len > 0.0f) {
+      n[v] /= len;
+      n[v + 1] /= len;
+      n[v + 2] /= len;
+    }
+  }
+}
+
+TriMesh SplitFaces(const TriMesh &mesh) {
+  TriMesh split;
+  if (mesh.faceTriangles.empty()) {
+    split = mesh;
+    ComputeVertexNormals(split);
+    return split;
+  }
+
+  split.faceTriangles = mesh.faceTriangles;
+  split.indices.reserve(mesh.indices.size());
+  // Per-vertex copy made for the current face, tagged with that face
+  std::vector<std::uint32_t> copyOf(mesh.VertexCount());
+  std::vector<std::size_t> copyFace(mesh.VertexCount(), SIZE_MAX);
+  for (std::size_t f = 0; f + 1 < mesh.faceTriangles.size(); ++f) {
+    for (std::size_t i = 3 * std::size_t(mesh.faceTriangles[f]);
+         i < 3 * std::size_t(mesh.faceTriangles[f + 1]); ++i) {
+      std::uint32_t v = mesh.indices[i];
+      if (copyFace[v] != f) {
+        copyFace[v] = f;
+        copyOf[v] = static_cast<std::uint32_t>(split.VertexCount());
+        split.positions.insert(split.positions.end(),
+                               mesh.positions.begin() + 3 * v,
+                               mesh.positions.begin() + 3 * v + 3);
+      }
+      split.indices.push_back(copyOf[v]);
+    }
+  }
+  ComputeVertexNormals(split);
+  return split;
+}
+
+std::size_t OpenEdgeCount(const TriMesh &mesh) {
+  // Directed half-edges packed as (from << 32 | to), sorted for lookup
+  std::vector<std::uint64_t> halfEdges;
+  halfEdges.reserve(mesh.indices.size());
+  for (std::size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+    for (int k = 0; k < 3; ++k) {
+      std::uint64_t from = mesh.indices[t + k];
+      std::uint64_t to = mesh.indices[t + (k + 1) % 3];
+      halfEdges.push_back(from << 32 | to);
+    }
+  }
+  std::sort(halfEdges.begin(), halfEdges.end());
+
+  std::size_t open = 0;
+  for (std::uint64_t edge : halfEdges) {
+    std::uint64_t twin = edge << 32 | edge >> 32;
+    if (!std::binary_search(halfEdges.begin(), halfEdges.end(), twin)) {
+      ++open;
+    }
+  }
+  return open;
+}
+
+double SignedVolume(const TriMesh &mesh) {
+  const std::vector<float> &p = mesh.positions;
+  double volume = 0.0;
+  for (std::size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+    const float *a = &p[3 * mesh.indices[t]];
+    const float *b = &p[3 * mesh.indices[t + 1]];
+    const float *c = &p[3 * mesh.indices[t + 2]];
+    // a . (b x c) is six times the signed volume of the tetrahedron spanned
+    // with the origin; accumulate in double to keep large meshes exact
+    double cx = double(b[1]) * c[2] - double(b[2]) * c[1];
+    double cy = double(b[2]) * c[0] - double(b[0]) * c[2];
+    double cz = double(b[0]) * c[1] - double(b[1]) * c[0];
+    volume += a[0] * cx + a[1] * cy + a[2] * cz;
+  }
+  return volume / 6.0;
+}
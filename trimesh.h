@@ -0,0 +1,51 @@
+/*
+    BoltGenerator - Indexed triangle mesh
+    Copyright (C) 2025
+*/
+
+#ifndef TRIMESH_H
+#define TRIMESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Plain indexed triangle mesh shared by the compact mesh writers. It holds
+// no OCCT types, so the writers and mesh-processing stages can be built and
+// tested without the kernel.
+struct TriMesh {
+  std::vector<float> positions;      // x, y, z per vertex
+  std::vector<float> normals;        // x, y, z per vertex (or empty)
+  std::vector<std::uint32_t> indices; // three per triangle, counter-clockwise
+  // First triangle of each source B-rep face, plus a final end entry, so
+  // face f owns triangles [faceTriangles[f], faceTriangles[f + 1]). Empty
+  // when the mesh carries no face mapping.
+  std::vector<std::uint32_t> faceTriangles;
+
+  std::size_t VertexCount() const { return positions.size() / 3; }
+  std::size_t TriangleCount() const { return indices.size() / 3; }
+  std::size_t FaceCount() const {
+    return faceTriangles.empty() ? 0 : faceTriangles.size() - 1;
+  }
+};
+
+// Area-weighted vertex normals. Vertices are only smoothed across the
+// triangles that reference them, so creases between B-rep faces (which do
+// not share vertices) stay sharp.
+void ComputeVertexNormals(TriMesh &mesh);
+
+// Gives every face of a welded mesh its own copy of the vertices on its
+// boundary (the layout ExtractTriMesh() produces) and recomputes the normals,
+// so shading stays sharp across the B-rep edges. Meshes without a face
+// mapping are returned with normals only.
+TriMesh SplitFaces(const TriMesh &mesh);
+
+// Mesh-level QA for welded meshes. An edge is open when no triangle uses it
+// in the opposite direction; a closed, consistently oriented mesh has none.
+std::size_t OpenEdgeCount(const TriMesh &mesh);
+
+// Enclosed volume by the divergence theorem; positive for outward-facing
+// triangles. Only meaningful when OpenEdgeCount() is zero.
+double SignedVolume(const TriMesh &mesh);
+
+#endif // TRIMESH_H
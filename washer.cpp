@@ -0,0 +1,42 @@
+#include "washer.h"
+#include <BRepBuilderAPI_MakeFace.hxx>
+#include <BRepBuilderAPI_MakePolygon.hxx>
+#include <BRepPrimAPI_MakeRevol.hxx>
+#include <TopoDS.hxx>
+#include <gp_Ax1.hxx>
+#include <gp_Dir.hxx>
+#include <gp_Pnt.hxx>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+Washer::Washer(const BoltParameters &p) : params(p) {
+  const double d = params.thread.majorDiameter;
+  if (d <= 0) {
+    throw std::runtime_error("Washer: Diameter must be positive");
+  }
+  const double inner = 0.5 * (d + std::max(0.2, 0.05 * d));
+  const double outer = d;
+  const double h = Thickness(params);
+  std::cout << "Washer: Creating with bore=" << 2.0 * inner
+            << " outside=" << 2.0 * outer << " thickness=" << h << std::endl;
+
+  // Rectangular section in the xz plane, revolved about the z axis
+  BRepBuilderAPI_MakePolygon section(gp_Pnt(inner, 0.0, 0.0),
+                                     gp_Pnt(outer, 0.0, 0.0),
+                                     gp_Pnt(outer, 0.0, h),
+                                     gp_Pnt(inner, 0.0, h), Standard_True);
+  TopoDS_Face face = BRepBuilderAPI_MakeFace(section.Wire()).Face();
+  BRepPrimAPI_MakeRevol revol(
+      face, gp_Ax1(gp_Pnt(0.0, 0.0, 0.0), gp_Dir(0.0, 0.0, 1.0)));
+  if (!revol.IsDone()) {
+    throw std::runtime_error("Washer: Revolution failed");
+  }
+  body = TopoDS::Solid(revol.Shape());
+}
+
+TopoDS_Solid Washer::Solid() { return body; }
+
+double Washer::Thickness(const BoltParameters &p) {
+  return 0.2 * p.thread.majorDiameter;
+}
@@ -0,0 +1,28 @@
+/*
+    BoltGenerator - Washer component
+    Copyright (C) 2025
+*/
+
+#ifndef WASHER_H
+#define WASHER_H
+
+#include <TopoDS_Solid.hxx>
+
+#include "parameters.h"
+
+// Plain washer in ISO 7089 proportions for the thread's nominal diameter d:
+// bore d + 5% (at least 0.2 mm), outside diameter 2d, thickness 0.2d. It
+// lies on z = 0, centred on the z axis.
+class Washer {
+public:
+  Washer(const BoltParameters &);
+  TopoDS_Solid Solid();
+
+  static double Thickness(const BoltParameters &);
+
+private:
+  BoltParameters params;
+  TopoDS_Solid body;
+};
+
+#endif // WASHER_H
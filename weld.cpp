@@ -0,0 +1,222 @@
+#include "weld.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+// Runs fn(f) for every face on all cores, faces claimed from a shared counter
+template <typename Fn> void ForEachFace(std::size_t faceCount, Fn fn) {
+  std::atomic<std::size_t> nextFace(0);
+  auto worker = [&]() {
+    for (std::size_t f = nextFace++; f < faceCount; f = nextFace++) {
+      fn(f);
+    }
+  };
+
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = static_cast<unsigned>(
+      std::min<std::size_t>(threads, std::max<std::size_t>(1, faceCount)));
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &t : pool) {
+    t.join();
+  }
+}
+
+// Truncation plus a correction for negative values: unlike std::floor this
+// vectorizes on baseline x86-64
+inline std::int32_t FloorToInt(float v) {
+  std::int32_t i = static_cast<std::int32_t>(v);
+  return i - (v < static_cast<float>(i));
+}
+
+// 21 bits per axis. Far-apart cells may alias, which only costs an extra
+// distance test.
+std::uint64_t CellKey(std::int32_t x, std::int32_t y, std::int32_t z) {
+  constexpr std::uint64_t kMask = (std::uint64_t(1) << 21) - 1;
+  return (static_cast<std::uint64_t>(x) & kMask) << 42 |
+         (static_cast<std::uint64_t>(y) & kMask) << 21 |
+         (static_cast<std::uint64_t>(z) & kMask);
+}
+
+// Vertices on an edge that only one triangle of the face uses, i.e. on the
+// face's outer/inner wires or its seams
+std::vector<std::uint32_t> FaceBoundary(const std::vector<std::uint32_t> &indices,
+                                        std::size_t firstTriangle,
+                                        std::size_t endTriangle) {
+  std::vector<std::uint64_t> edges;
+  edges.reserve(3 * (endTriangle - firstTriangle));
+  for (std::size_t t = firstTriangle; t < endTriangle; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      std::uint32_t a = indices[3 * t + k];
+      std::uint32_t b = indices[3 * t + (k + 1) % 3];
+      if (a > b) {
+        std::swap(a, b);
+      }
+      edges.push_back(static_cast<std::uint64_t>(a) << 32 | b);
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+
+  std::vector<std::uint32_t> boundary;
+  for (std::size_t i = 0; i < edges.size();) {
+    std::size_t j = i + 1;
+    while (j < edges.size() && edges[j] == edges[i]) {
+      ++j;
+    }
+    if (j - i == 1) {
+      boundary.push_back(static_cast<std::uint32_t>(edges[i] >> 32));
+      boundary.push_back(static_cast<std::uint32_t>(edges[i]));
+    }
+    i = j;
+  }
+  std::sort(boundary.begin(), boundary.end());
+  boundary.erase(std::unique(boundary.begin(), boundary.end()), boundary.end());
+  return boundary;
+}
+} // namespace
+
+WeldStats WeldVertices(TriMesh &mesh, float tolerance) {
+  WeldStats stats{0, 0};
+  const std::size_t vertexCount = mesh.VertexCount();
+  if (vertexCount == 0) {
+    return stats;
+  }
+  if (mesh.faceTriangles.empty()) {
+    mesh.faceTriangles = {0, static_cast<std::uint32_t>(mesh.TriangleCount())};
+  }
+  const std::size_t faceCount = mesh.FaceCount();
+  std::vector<float> &positions = mesh.positions;
+  std::vector<std::uint32_t> &indices = mesh.indices;
+  std::vector<std::uint32_t> &faceTriangles = mesh.faceTriangles;
+
+  // Cells are twice the tolerance, so a vertex's neighbours within tolerance
+  // all lie in its own cell or the adjacent cell on the nearer side along
+  // each axis: 8 cells to probe rather than 27
+  tolerance = std::max(tolerance, 1e-6f);
+  const float inverseCell = 0.5f / tolerance;
+  const float tolerance2 = tolerance * tolerance;
+
+  // Cell coordinates of every vertex in one flat, vectorizable pass
+  std::vector<std::int32_t> cells(positions.size());
+  {
+    const float *p = positions.data();
+    std::int32_t *c = cells.data();
+    const std::size_t n = positions.size();
+    for (std::size_t i = 0; i < n; ++i) {
+      c[i] = FloorToInt(p[i] * inverseCell);
+    }
+  }
+
+  std::vector<std::vector<std::uint32_t>> boundaries(faceCount);
+  ForEachFace(faceCount, [&](std::size_t f) {
+    boundaries[f] = FaceBoundary(indices, faceTriangles[f], faceTriangles[f + 1]);
+  });
+
+  // Grid insertion is sequential so the first vertex seen in face order is
+  // always the one kept, whatever the thread count
+  std::vector<std::uint32_t> representative(vertexCount);
+  for (std::size_t v = 0; v < vertexCount; ++v) {
+    representative[v] = static_cast<std::uint32_t>(v);
+  }
+  std::vector<char> visited(vertexCount, 0);
+  std::unordered_map<std::uint64_t, std::uint32_t> cellHead;
+  std::vector<std::uint32_t> cellNext(vertexCount, kNone);
+  for (const std::vector<std::uint32_t> &boundary : boundaries) {
+    for (std::uint32_t v : boundary) {
+      if (visited[v]) {
+        continue;
+      }
+      visited[v] = 1;
+      const float *pv = &positions[3 * v];
+      const std::int32_t *cv = &cells[3 * v];
+      std::int32_t step[3];
+      for (int axis = 0; axis < 3; ++axis) {
+        step[axis] = (pv[axis] * inverseCell - cv[axis] < 0.5f) ? -1 : 1;
+      }
+
+      std::uint32_t match = kNone;
+      for (int corner = 0; corner < 8 && match == kNone; ++corner) {
+        auto head = cellHead.find(CellKey(cv[0] + ((corner & 1) ? step[0] : 0),
+                                          cv[1] + ((corner & 2) ? step[1] : 0),
+                                          cv[2] + ((corner & 4) ? step[2] : 0)));
+        if (head == cellHead.end()) {
+          continue;
+        }
+        for (std::uint32_t r = head->second; r != kNone; r = cellNext[r]) {
+          const float *pr = &positions[3 * r];
+          float dx = pv[0] - pr[0], dy = pv[1] - pr[1], dz = pv[2] - pr[2];
+          if (dx * dx + dy * dy + dz * dz <= tolerance2) {
+            match = r;
+            break;
+          }
+        }
+      }
+
+      if (match != kNone) {
+        representative[v] = match;
+        ++stats.merged;
+      } else {
+        auto inserted = cellHead.emplace(CellKey(cv[0], cv[1], cv[2]), v);
+        if (!inserted.second) {
+          cellNext[v] = inserted.first->second;
+          inserted.first->second = v;
+        }
+      }
+    }
+  }
+
+  // Compact the surviving vertices in their original order
+  std::vector<std::uint32_t> newIndex(vertexCount);
+  std::uint32_t kept = 0;
+  for (std::size_t v = 0; v < vertexCount; ++v) {
+    if (representative[v] == v) {
+      std::copy_n(&positions[3 * v], 3, &positions[3 * kept]);
+      newIndex[v] = kept++;
+    }
+  }
+  for (std::size_t v = 0; v < vertexCount; ++v) {
+    newIndex[v] = newIndex[representative[v]];
+  }
+  positions.resize(3 * static_cast<std::size_t>(kept));
+  mesh.normals.clear();
+
+  // Faces own disjoint triangle ranges, so they are renumbered in place
+  ForEachFace(faceCount, [&](std::size_t f) {
+    for (std::size_t i = 3 * std::size_t(faceTriangles[f]);
+         i < 3 * std::size_t(faceTriangles[f + 1]); ++i) {
+      indices[i] = newIndex[indices[i]];
+    }
+  });
+
+  // Drop triangles that collapsed, keeping the face ranges in step
+  std::size_t write = 0;
+  for (std::size_t f = 0; f < faceCount; ++f) {
+    const std::size_t begin = faceTriangles[f], end = faceTriangles[f + 1];
+    faceTriangles[f] = static_cast<std::uint32_t>(write / 3);
+    for (std::size_t t = begin; t < end; ++t) {
+      std::uint32_t a = indices[3 * t], b = indices[3 * t + 1],
+                    c = indices[3 * t + 2];
+      if (a == b || b == c || a == c) {
+        ++stats.degenerate;
+        continue;
+      }
+      indices[write++] = a;
+      indices[write++] = b;
+      indices[write++] = c;
+    }
+  }
+  faceTriangles[faceCount] = static_cast<std::uint32_t>(write / 3);
+  indices.resize(write);
+  return stats;
+}
@@ -0,0 +1,29 @@
+/*
+    BoltGenerator - Vertex welding
+    Copyright (C) 2025
+*/
+
+#ifndef WELD_H
+#define WELD_H
+
+#include "trimesh.h"
+
+#include <cstddef>
+
+struct WeldStats {
+  std::size_t merged;     // vertices folded into another vertex
+  std::size_t degenerate; // triangles dropped because two corners merged
+};
+
+// Turns a per-face mesh (as extracted from the B-rep triangulations, where
+// every face has its own nodes) into one shared-vertex mesh: vertices closer
+// than `tolerance` are merged through a spatial hash grid. Only face boundary
+// vertices can coincide with another face's nodes, so each face finds its
+// boundary in parallel and just those vertices go through the grid.
+//
+// The face mapping is kept (faceTriangles is updated for dropped triangles).
+// Normals are cleared: smoothing across the welded seams would round off the
+// creases, so callers that shade recompute them.
+WeldStats WeldVertices(TriMesh &mesh, float tolerance);
+
+#endif // WELD_H